@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+
+# © 2024-2025 Hiroyuki Sakai
+
+# Sends jobs to a pbrt render server started with
+#   pbrt --server <socket> [<options>]
+# and waits for them to finish. Jobs are either given on the command line
+#   _render-client.py <socket> render <filename.pbrt> [<directives>]
+#   _render-client.py <socket> clear|quit
+# or read from standard input, one per line, e.g.
+#   render ../scenes/staircase/scene-stat.pbrt Film "image" "string filename" "a.exr"
+#   render ../scenes/staircase/scene-stat.pbrt Sampler "random" "integer pixelsamples" 64
+# Scene files are resolved relative to the server's working directory.
+
+import socket
+import sys
+
+if len(sys.argv) < 2:
+    sys.exit("usage: _render-client.py <socket> [render <filename.pbrt> [<directives>] | clear | quit]")
+
+if len(sys.argv) > 2:
+    jobs = [" ".join(sys.argv[2:])]
+else:
+    jobs = [line.strip() for line in sys.stdin if line.strip() and not line.startswith("#")]
+
+client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+client.connect(sys.argv[1])
+responses = client.makefile("r")
+
+failed = False
+for job in jobs:
+    client.sendall((job + "\n").encode())
+    response = responses.readline().strip()
+    if not response:
+        sys.exit("Server closed the connection during job: " + job)
+    print(response + "\t" + job, flush=True)
+    failed |= response.startswith("error")
+
+client.close()
+sys.exit(1 if failed else 0)
@@ -37,14 +37,24 @@
 #include "paramset.h"
 #include "stats.h"
 #include "parallel.h"
+#include "primitive.h"
+#include "shapes/triangle.h"
+#include "statistics/scenecache.h"
 #include <algorithm>
 
+#if (defined(__SSE__) || defined(_M_X64)) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define PBRT_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/BVH tree", treeBytes);
 STAT_RATIO("BVH/Primitives per leaf node", totalPrimitives, totalLeafNodes);
 STAT_COUNTER("BVH/Interior nodes", interiorNodes);
 STAT_COUNTER("BVH/Leaf nodes", leafNodes);
+STAT_COUNTER("BVH/Wide nodes", wideNodes);
+STAT_COUNTER("BVH/Packed triangles", packedTriangles);
 
 // BVHAccel Local Declarations
 struct BVHPrimitiveInfo {
@@ -65,6 +75,7 @@ struct BVHBuildNode {
         nPrimitives = n;
         bounds = b;
         children[0] = children[1] = nullptr;
+        nNodes = 1;
         ++leafNodes;
         ++totalLeafNodes;
         totalPrimitives += n;
@@ -75,11 +86,20 @@ struct BVHBuildNode {
         bounds = Union(c0->bounds, c1->bounds);
         splitAxis = axis;
         nPrimitives = 0;
+        nNodes = 1 + c0->nNodes + c1->nNodes;
         ++interiorNodes;
     }
     Bounds3f bounds;
     BVHBuildNode *children[2];
     int splitAxis, firstPrimOffset, nPrimitives;
+    int nNodes;  // Number of nodes in subtree
+};
+
+// Subtree whose construction (or flattening) is deferred, so that the
+// subtrees below the top levels of the BVH are processed in parallel
+struct BVHBuildTask {
+    BVHBuildNode *node;
+    int start, end;  // Range of _primitiveInfo_ (build) or offset (flatten)
 };
 
 struct MortonPrimitive {
@@ -179,9 +199,552 @@ static void RadixSort(std::vector<MortonPrimitive> *v) {
     if (nPasses & 1) std::swap(*v, tempVector);
 }
 
+// Wide BVH Local Declarations
+#ifdef PBRT_BVH_SSE
+// Four lanes of Floats and lane masks for the SIMD box and triangle tests
+struct BVHFloat4 {
+    BVHFloat4() {}
+    BVHFloat4(__m128 v) : v(v) {}
+    explicit BVHFloat4(Float f) : v(_mm_set1_ps(f)) {}
+    __m128 v;
+};
+typedef BVHFloat4 BVHMask4;
+
+inline BVHFloat4 LoadBVHFloat4(const Float *f) { return _mm_load_ps(f); }
+inline BVHFloat4 operator+(BVHFloat4 a, BVHFloat4 b) { return _mm_add_ps(a.v, b.v); }
+inline BVHFloat4 operator-(BVHFloat4 a, BVHFloat4 b) { return _mm_sub_ps(a.v, b.v); }
+inline BVHFloat4 operator*(BVHFloat4 a, BVHFloat4 b) { return _mm_mul_ps(a.v, b.v); }
+inline BVHMask4 operator<(BVHFloat4 a, BVHFloat4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline BVHMask4 operator>(BVHFloat4 a, BVHFloat4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline BVHMask4 operator&(BVHMask4 a, BVHMask4 b) { return _mm_and_ps(a.v, b.v); }
+inline BVHMask4 operator|(BVHMask4 a, BVHMask4 b) { return _mm_or_ps(a.v, b.v); }
+inline BVHMask4 AndNot(BVHMask4 a, BVHMask4 b) { return _mm_andnot_ps(a.v, b.v); } // ~a & b
+inline BVHFloat4 Abs(BVHFloat4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+// Same semantics as (a > b ? a : b) and (a < b ? a : b), also for NaNs
+inline BVHFloat4 MaxFirst(BVHFloat4 a, BVHFloat4 b) { return _mm_max_ps(a.v, b.v); }
+inline BVHFloat4 MinFirst(BVHFloat4 a, BVHFloat4 b) { return _mm_min_ps(a.v, b.v); }
+inline int MoveMask(BVHMask4 m) { return _mm_movemask_ps(m.v); }
+inline void Store(BVHFloat4 a, Float *f) { _mm_store_ps(f, a.v); }
+#else
+struct BVHFloat4 {
+    BVHFloat4() {}
+    explicit BVHFloat4(Float f) { v[0] = v[1] = v[2] = v[3] = f; }
+    Float v[4];
+};
+struct BVHMask4 {
+    bool v[4];
+};
+
+#define BVH_LANEWISE(Type, expr) \
+    Type r;                      \
+    for (int i = 0; i < 4; ++i) r.v[i] = (expr); \
+    return r;
+inline BVHFloat4 LoadBVHFloat4(const Float *f) { BVH_LANEWISE(BVHFloat4, f[i]) }
+inline BVHFloat4 operator+(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHFloat4, a.v[i] + b.v[i]) }
+inline BVHFloat4 operator-(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHFloat4, a.v[i] - b.v[i]) }
+inline BVHFloat4 operator*(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHFloat4, a.v[i] * b.v[i]) }
+inline BVHMask4 operator<(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHMask4, a.v[i] < b.v[i]) }
+inline BVHMask4 operator>(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHMask4, a.v[i] > b.v[i]) }
+inline BVHMask4 operator&(BVHMask4 a, BVHMask4 b) { BVH_LANEWISE(BVHMask4, a.v[i] && b.v[i]) }
+inline BVHMask4 operator|(BVHMask4 a, BVHMask4 b) { BVH_LANEWISE(BVHMask4, a.v[i] || b.v[i]) }
+inline BVHMask4 AndNot(BVHMask4 a, BVHMask4 b) { BVH_LANEWISE(BVHMask4, !a.v[i] && b.v[i]) }
+inline BVHFloat4 Abs(BVHFloat4 a) { BVH_LANEWISE(BVHFloat4, std::abs(a.v[i])) }
+inline BVHFloat4 MaxFirst(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHFloat4, a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline BVHFloat4 MinFirst(BVHFloat4 a, BVHFloat4 b) { BVH_LANEWISE(BVHFloat4, a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+#undef BVH_LANEWISE
+inline int MoveMask(BVHMask4 m) {
+    return m.v[0] | (m.v[1] << 1) | (m.v[2] << 2) | (m.v[3] << 3);
+}
+inline void Store(BVHFloat4 a, Float *f) {
+    for (int i = 0; i < 4; ++i) f[i] = a.v[i];
+}
+#endif  // PBRT_BVH_SSE
+
+// Node of a wide BVH with up to _N_ children, obtained by collapsing the
+// binary BVH. A child is either an interior node (_nPrimitives_ 0; _child_
+// is the node index) or a leaf (_child_ is the offset into _primitives_ and
+// _packedOffset_ the first _PackedTriangles_ of the leaf, or -1 if the leaf
+// contains other primitives). Empty slots have empty bounds.
+template <int N>
+struct alignas(64) WideBVHNode {
+    Float bounds[2][3][N];  // [pMin/pMax][axis][child]
+    int32_t child[N];
+    int32_t packedOffset[N];
+    uint16_t nPrimitives[N];
+    // Children in the front-to-back order of the binary BVH for each ray
+    // direction octant (bit _i_ set if the direction is negative along
+    // axis _i_), as 4-bit child indices
+    uint32_t order[8];
+    uint8_t nChildren;
+};
+
+// Vertices of _N_ triangles of a leaf in SoA layout. The triangles are
+// tested against the ray conservatively; only the remaining candidates
+// are intersected by _Triangle::Intersect()_ (through their primitives),
+// so that the results are the same as with the binary BVH.
+template <int N>
+struct alignas(64) PackedTriangles {
+    Float p[3][3][N];  // [vertex][axis][triangle]
+};
+
+// Per-ray constants of the wide BVH traversal
+struct WideBVHRay {
+    WideBVHRay(const Ray &ray) {
+        Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+        for (int i = 0; i < 3; ++i) {
+            o[i] = ray.o[i];
+            this->invDir[i] = invDir[i];
+            dirIsNeg[i] = invDir[i] < 0;
+        }
+        octant = dirIsNeg[0] | (dirIsNeg[1] << 1) | (dirIsNeg[2] << 2);
+
+        // Permutation and shear of the watertight ray--triangle test
+        kz = MaxDimension(Abs(ray.d));
+        kx = kz + 1;
+        if (kx == 3) kx = 0;
+        ky = kx + 1;
+        if (ky == 3) ky = 0;
+        Vector3f d = Permute(ray.d, kx, ky, kz);
+        Sx = -d.x / d.z;
+        Sy = -d.y / d.z;
+        Sz = 1.f / d.z;
+    }
+    Float o[3], invDir[3];
+    int dirIsNeg[3], octant;
+    int kx, ky, kz;
+    Float Sx, Sy, Sz;
+};
+
+template <int N>
+class WideBVH {
+  public:
+    WideBVH(const BVHBuildNode *root,
+            const std::vector<std::shared_ptr<Primitive>> &primitives);
+    Bounds3f WorldBound() const { return bounds; }
+    size_t Bytes() const {
+        return nodes.size() * sizeof(nodes[0]) +
+               triangles.size() * sizeof(triangles[0]);
+    }
+    bool Intersect(const Ray &ray, SurfaceInteraction *isect,
+                   const std::vector<std::shared_ptr<Primitive>> &primitives) const;
+    bool IntersectP(const Ray &ray,
+                    const std::vector<std::shared_ptr<Primitive>> &primitives) const;
+
+  private:
+    // WideBVH Private Types
+    struct StackEntry {
+        int32_t node;
+        int32_t slot;  // -1: interior node _node_; leaf in slot of _node_ otherwise
+        Float tMin;    // Entry distance of the bounds (as in the binary BVH)
+    };
+
+    // WideBVH Private Methods
+    int collapse(const BVHBuildNode *node,
+                 const std::vector<std::shared_ptr<Primitive>> &primitives);
+    int pack(const BVHBuildNode *leaf,
+             const std::vector<std::shared_ptr<Primitive>> &primitives);
+    int intersectBounds(const WideBVHNode<N> &node, const WideBVHRay &r,
+                        Float rayTMax, Float tMin[N]) const;
+    int intersectTriangles(const PackedTriangles<N> &tris, const WideBVHRay &r,
+                           Float rayTMax) const;
+
+    // WideBVH Private Data
+    Bounds3f bounds;
+    std::vector<WideBVHNode<N>> nodes;
+    std::vector<PackedTriangles<N>> triangles;
+};
+
+// WideBVH Method Definitions
+template <int N>
+WideBVH<N>::WideBVH(const BVHBuildNode *root,
+                    const std::vector<std::shared_ptr<Primitive>> &primitives)
+    : bounds(root->bounds) {
+    collapse(root, primitives);
+}
+
+// Appends the slots of the collapsed subtree of _node_ in the order in
+// which the binary BVH visits them for rays in _octant_
+static void AppendVisitOrder(const BVHBuildNode *node, int octant,
+                             const std::vector<const BVHBuildNode *> &slots,
+                             uint32_t *order, int *nVisited) {
+    auto slot = std::find(slots.begin(), slots.end(), node);
+    if (slot != slots.end()) {
+        *order |= uint32_t(slot - slots.begin()) << (4 * (*nVisited)++);
+        return;
+    }
+    const int secondFirst = (octant >> node->splitAxis) & 1;
+    AppendVisitOrder(node->children[secondFirst], octant, slots, order,
+                     nVisited);
+    AppendVisitOrder(node->children[1 - secondFirst], octant, slots, order,
+                     nVisited);
+}
+
+template <int N>
+int WideBVH<N>::collapse(
+    const BVHBuildNode *node,
+    const std::vector<std::shared_ptr<Primitive>> &primitives) {
+    const int index = nodes.size();
+    nodes.emplace_back();
+    ++wideNodes;
+
+    // Repeatedly replace the interior child with the largest surface area
+    // by its children
+    std::vector<const BVHBuildNode *> slots;
+    if (node->nPrimitives > 0)
+        slots.push_back(node);
+    else {
+        slots = {node->children[0], node->children[1]};
+        while (slots.size() < N) {
+            int best = -1;
+            for (size_t i = 0; i < slots.size(); ++i)
+                if (slots[i]->nPrimitives == 0 &&
+                    (best < 0 || slots[i]->bounds.SurfaceArea() >
+                                     slots[best]->bounds.SurfaceArea()))
+                    best = i;
+            if (best < 0) break;
+            const BVHBuildNode *opened = slots[best];
+            slots[best] = opened->children[0];
+            slots.insert(slots.begin() + best + 1, opened->children[1]);
+        }
+    }
+
+    // Initialize children of the wide node
+    WideBVHNode<N> wideNode;
+    wideNode.nChildren = slots.size();
+    for (int c = 0; c < N; ++c) {
+        const bool used = c < (int)slots.size();
+        for (int axis = 0; axis < 3; ++axis) {
+            wideNode.bounds[0][axis][c] =
+                used ? slots[c]->bounds.pMin[axis] : Infinity;
+            wideNode.bounds[1][axis][c] =
+                used ? slots[c]->bounds.pMax[axis] : -Infinity;
+        }
+        wideNode.child[c] = -1;
+        wideNode.packedOffset[c] = -1;
+        wideNode.nPrimitives[c] = 0;
+        if (!used) continue;
+        if (slots[c]->nPrimitives > 0) {
+            CHECK_LT(slots[c]->nPrimitives, 65536);
+            wideNode.child[c] = slots[c]->firstPrimOffset;
+            wideNode.nPrimitives[c] = slots[c]->nPrimitives;
+            wideNode.packedOffset[c] = pack(slots[c], primitives);
+        } else
+            wideNode.child[c] = collapse(slots[c], primitives);
+    }
+    for (int octant = 0; octant < 8; ++octant) {
+        wideNode.order[octant] = 0;
+        int nVisited = 0;
+        AppendVisitOrder(node, octant, slots, &wideNode.order[octant],
+                         &nVisited);
+        CHECK_EQ(nVisited, wideNode.nChildren);
+    }
+    nodes[index] = wideNode;
+    return index;
+}
+
+template <int N>
+int WideBVH<N>::pack(
+    const BVHBuildNode *leaf,
+    const std::vector<std::shared_ptr<Primitive>> &primitives) {
+    // Only leaves that consist of triangles are packed
+    std::vector<const Triangle *> leafTriangles;
+    for (int i = 0; i < leaf->nPrimitives; ++i) {
+        const GeometricPrimitive *prim = dynamic_cast<const GeometricPrimitive *>(
+            primitives[leaf->firstPrimOffset + i].get());
+        const Triangle *triangle =
+            prim ? dynamic_cast<const Triangle *>(prim->GetShape()) : nullptr;
+        if (!triangle) return -1;
+        leafTriangles.push_back(triangle);
+    }
+
+    // Unused lanes of the last packet replicate the last triangle, so that
+    // the (masked) lanes never compute with uninitialized values
+    const int offset = triangles.size();
+    const size_t nLanes = (leafTriangles.size() + N - 1) / N * N;
+    for (size_t i = 0; i < nLanes; ++i) {
+        if (i % N == 0) triangles.emplace_back();
+        Point3f p[3];
+        leafTriangles[std::min(i, leafTriangles.size() - 1)]->GetVertices(p);
+        for (int v = 0; v < 3; ++v)
+            for (int axis = 0; axis < 3; ++axis)
+                triangles.back().p[v][axis][i % N] = p[v][axis];
+    }
+    packedTriangles += leafTriangles.size();
+    return offset;
+}
+
+template <int N>
+int WideBVH<N>::intersectBounds(const WideBVHNode<N> &node,
+                                const WideBVHRay &r, Float rayTMax,
+                                Float tMin[N]) const {
+    // Same operations as _Bounds3::IntersectP()_ for each child, so that
+    // the same children are hit as in the binary BVH
+    const BVHFloat4 o[3] = {BVHFloat4(r.o[0]), BVHFloat4(r.o[1]),
+                            BVHFloat4(r.o[2])};
+    const BVHFloat4 invDir[3] = {BVHFloat4(r.invDir[0]),
+                                 BVHFloat4(r.invDir[1]),
+                                 BVHFloat4(r.invDir[2])};
+    const BVHFloat4 scale(1 + 2 * gamma(3)), zero(0.f), tMax4(rayTMax);
+    int hits = 0;
+    for (int c = 0; c < N; c += 4) {
+        BVHFloat4 t0 = (LoadBVHFloat4(&node.bounds[r.dirIsNeg[0]][0][c]) - o[0]) * invDir[0];
+        BVHFloat4 t1 = (LoadBVHFloat4(&node.bounds[1 - r.dirIsNeg[0]][0][c]) - o[0]) * invDir[0];
+        BVHFloat4 ty0 = (LoadBVHFloat4(&node.bounds[r.dirIsNeg[1]][1][c]) - o[1]) * invDir[1];
+        BVHFloat4 ty1 = (LoadBVHFloat4(&node.bounds[1 - r.dirIsNeg[1]][1][c]) - o[1]) * invDir[1];
+        t1 = t1 * scale;
+        ty1 = ty1 * scale;
+        BVHMask4 miss = (t0 > ty1) | (ty0 > t1);
+        t0 = MaxFirst(ty0, t0);
+        t1 = MinFirst(ty1, t1);
+
+        BVHFloat4 tz0 = (LoadBVHFloat4(&node.bounds[r.dirIsNeg[2]][2][c]) - o[2]) * invDir[2];
+        BVHFloat4 tz1 = (LoadBVHFloat4(&node.bounds[1 - r.dirIsNeg[2]][2][c]) - o[2]) * invDir[2];
+        tz1 = tz1 * scale;
+        miss = miss | (t0 > tz1) | (tz0 > t1);
+        t0 = MaxFirst(tz0, t0);
+        t1 = MinFirst(tz1, t1);
+
+        hits |= MoveMask(AndNot(miss, (t0 < tMax4) & (t1 > zero))) << c;
+        Store(t0, &tMin[c]);
+    }
+    return hits & ((1 << node.nChildren) - 1);
+}
+
+template <int N>
+int WideBVH<N>::intersectTriangles(const PackedTriangles<N> &tris,
+                                   const WideBVHRay &r, Float rayTMax) const {
+    // Conservative version of the watertight test of _Triangle::Intersect()_:
+    // a triangle is only rejected if the edge function or distance tests
+    // fail by more than a bound on the rounding error of both evaluations
+    // (which may differ, e.g., due to FMA contraction).
+    const BVHFloat4 eps(1e-5f), zero(0.f), tMax4(rayTMax);
+    const BVHFloat4 ox(r.o[r.kx]), oy(r.o[r.ky]), oz(r.o[r.kz]);
+    const BVHFloat4 Sx(r.Sx), Sy(r.Sy), Sz(r.Sz);
+    int candidates = 0;
+    for (int c = 0; c < N; c += 4) {
+        // Transform vertices to ray coordinate space
+        BVHFloat4 x[3], y[3], z[3], xMag[3], yMag[3];
+        for (int v = 0; v < 3; ++v) {
+            BVHFloat4 pz = LoadBVHFloat4(&tris.p[v][r.kz][c]) - oz;
+            BVHFloat4 px = LoadBVHFloat4(&tris.p[v][r.kx][c]) - ox;
+            BVHFloat4 py = LoadBVHFloat4(&tris.p[v][r.ky][c]) - oy;
+            BVHFloat4 sx = Sx * pz, sy = Sy * pz;
+            x[v] = px + sx;
+            y[v] = py + sy;
+            z[v] = pz * Sz;
+            xMag[v] = Abs(px) + Abs(sx);
+            yMag[v] = Abs(py) + Abs(sy);
+        }
+
+        // Compute edge functions and their error bounds
+        BVHFloat4 e[3], eErr[3];
+        for (int i = 0; i < 3; ++i) {
+            const int j = (i + 1) % 3, k = (i + 2) % 3;
+            e[i] = x[j] * y[k] - y[j] * x[k];
+            eErr[i] = eps * (xMag[j] * yMag[k] + yMag[j] * xMag[k]);
+        }
+        BVHMask4 reject =
+            ((e[0] < zero - eErr[0]) | (e[1] < zero - eErr[1]) | (e[2] < zero - eErr[2])) &
+            ((e[0] > eErr[0]) | (e[1] > eErr[1]) | (e[2] > eErr[2]));
+
+        // Test scaled hit distance against ray $t$ range
+        const BVHFloat4 det = e[0] + e[1] + e[2];
+        const BVHFloat4 detErr = eErr[0] + eErr[1] + eErr[2] +
+                                 eps * (Abs(e[0]) + Abs(e[1]) + Abs(e[2]));
+        const BVHFloat4 tScaled = e[0] * z[0] + e[1] * z[1] + e[2] * z[2];
+        const BVHFloat4 tScaledErr =
+            eps * (Abs(e[0] * z[0]) + Abs(e[1] * z[1]) + Abs(e[2] * z[2])) +
+            eErr[0] * Abs(z[0]) + eErr[1] * Abs(z[1]) + eErr[2] * Abs(z[2]);
+        reject = reject |
+                 ((det > detErr) &
+                  ((tScaled + tScaledErr < zero) |
+                   (tScaled - tScaledErr > tMax4 * (det + detErr))));
+        reject = reject |
+                 ((det < zero - detErr) &
+                  ((tScaled - tScaledErr > zero) |
+                   (tScaled + tScaledErr < tMax4 * (det - detErr))));
+
+        candidates |= (~MoveMask(reject) & 0xF) << c;
+    }
+    return candidates;
+}
+
+template <int N>
+bool WideBVH<N>::Intersect(
+    const Ray &ray, SurfaceInteraction *isect,
+    const std::vector<std::shared_ptr<Primitive>> &primitives) const {
+    ProfilePhase p(Prof::AccelIntersect);
+    const WideBVHRay r(ray);
+    const Vector3f invDir(r.invDir[0], r.invDir[1], r.invDir[2]);
+    if (!bounds.IntersectP(ray, invDir, r.dirIsNeg)) return false;
+    bool hit = false;
+    // Follow ray through the wide BVH; the leaves are visited in the same
+    // order as in the binary BVH
+    StackEntry nodesToVisit[64 * (N - 1) + 1];
+    int toVisitOffset = 0;
+    StackEntry current = {0, -1, -Infinity};
+    while (true) {
+        if (current.tMin < ray.tMax) {
+            const WideBVHNode<N> &node = nodes[current.node];
+            if (current.slot >= 0) {
+                // Intersect ray with primitives in leaf
+                const int offset = node.child[current.slot];
+                const int nPrimitives = node.nPrimitives[current.slot];
+                const int packedOffset = node.packedOffset[current.slot];
+                if (packedOffset < 0) {
+                    for (int i = 0; i < nPrimitives; ++i)
+                        if (primitives[offset + i]->Intersect(ray, isect))
+                            hit = true;
+                } else {
+                    for (int g = 0; g * N < nPrimitives; ++g) {
+                        int candidates = intersectTriangles(
+                            triangles[packedOffset + g], r, ray.tMax);
+                        candidates &= (1 << std::min(N, nPrimitives - g * N)) - 1;
+                        for (int i = 0; i < N; ++i)
+                            if ((candidates & (1 << i)) &&
+                                primitives[offset + g * N + i]->Intersect(ray, isect))
+                                hit = true;
+                    }
+                }
+            } else {
+                // Put children that are hit on the stack in reverse order
+                alignas(16) Float tMin[N];
+                const int hits = intersectBounds(node, r, ray.tMax, tMin);
+                const uint32_t order = node.order[r.octant];
+                for (int k = node.nChildren - 1; k >= 0; --k) {
+                    const int c = (order >> (4 * k)) & 15;
+                    if (!(hits & (1 << c))) continue;
+                    if (node.nPrimitives[c] > 0)
+                        nodesToVisit[toVisitOffset++] = {current.node, c, tMin[c]};
+                    else
+                        nodesToVisit[toVisitOffset++] = {node.child[c], -1, tMin[c]};
+                }
+            }
+        }
+        if (toVisitOffset == 0) break;
+        current = nodesToVisit[--toVisitOffset];
+    }
+    return hit;
+}
+
+template <int N>
+bool WideBVH<N>::IntersectP(
+    const Ray &ray,
+    const std::vector<std::shared_ptr<Primitive>> &primitives) const {
+    ProfilePhase p(Prof::AccelIntersectP);
+    const WideBVHRay r(ray);
+    const Vector3f invDir(r.invDir[0], r.invDir[1], r.invDir[2]);
+    if (!bounds.IntersectP(ray, invDir, r.dirIsNeg)) return false;
+    StackEntry nodesToVisit[64 * (N - 1) + 1];
+    int toVisitOffset = 0;
+    StackEntry current = {0, -1, -Infinity};
+    while (true) {
+        if (current.tMin < ray.tMax) {
+            const WideBVHNode<N> &node = nodes[current.node];
+            if (current.slot >= 0) {
+                const int offset = node.child[current.slot];
+                const int nPrimitives = node.nPrimitives[current.slot];
+                const int packedOffset = node.packedOffset[current.slot];
+                if (packedOffset < 0) {
+                    for (int i = 0; i < nPrimitives; ++i)
+                        if (primitives[offset + i]->IntersectP(ray))
+                            return true;
+                } else {
+                    for (int g = 0; g * N < nPrimitives; ++g) {
+                        int candidates = intersectTriangles(
+                            triangles[packedOffset + g], r, ray.tMax);
+                        candidates &= (1 << std::min(N, nPrimitives - g * N)) - 1;
+                        for (int i = 0; i < N; ++i)
+                            if ((candidates & (1 << i)) &&
+                                primitives[offset + g * N + i]->IntersectP(ray))
+                                return true;
+                    }
+                }
+            } else {
+                alignas(16) Float tMin[N];
+                const int hits = intersectBounds(node, r, ray.tMax, tMin);
+                const uint32_t order = node.order[r.octant];
+                for (int k = node.nChildren - 1; k >= 0; --k) {
+                    const int c = (order >> (4 * k)) & 15;
+                    if (!(hits & (1 << c))) continue;
+                    if (node.nPrimitives[c] > 0)
+                        nodesToVisit[toVisitOffset++] = {current.node, c, tMin[c]};
+                    else
+                        nodesToVisit[toVisitOffset++] = {node.child[c], -1, tMin[c]};
+                }
+            }
+        }
+        if (toVisitOffset == 0) break;
+        current = nodesToVisit[--toVisitOffset];
+    }
+    return false;
+}
+
+// Subtrees with at most this many primitives (nodes) are built (flattened)
+// by a single task
+PBRT_CONSTEXPR int parallelBuildThreshold = 16 * 1024;
+PBRT_CONSTEXPR int parallelFlattenThreshold = 16 * 1024;
+
+// Splits _[start, end)_ into _nChunks_ chunks and runs _func(chunk,
+// chunkStart, chunkEnd)_ for each of them, in parallel if there are several
+template <typename Func>
+static void ForEachBuildChunk(int start, int end, int nChunks, Func func) {
+    if (nChunks == 1) {
+        func(0, start, end);
+        return;
+    }
+    const int chunkSize = (end - start + nChunks - 1) / nChunks;
+    ParallelFor([&](int64_t chunk) {
+        int chunkStart = start + chunk * chunkSize;
+        func(chunk, chunkStart, std::min(end, chunkStart + chunkSize));
+    }, nChunks);
+}
+
+// Computes the subtree sizes of the nodes built before their subtrees,
+// which are marked by _nNodes_ -1
+static int UpdateNodeCounts(BVHBuildNode *node) {
+    if (node->nNodes < 0)
+        node->nNodes = 1 + UpdateNodeCounts(node->children[0]) +
+                       UpdateNodeCounts(node->children[1]);
+    return node->nNodes;
+}
+
+// Recreates the build tree of a flattened BVH (e.g., from the scene cache)
+static BVHBuildNode *UnflattenBVHTree(MemoryArena &arena,
+                                      const LinearBVHNode *nodes, int offset) {
+    const LinearBVHNode &linearNode = nodes[offset];
+    BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
+    if (linearNode.nPrimitives > 0)
+        node->InitLeaf(linearNode.primitivesOffset, linearNode.nPrimitives,
+                       linearNode.bounds);
+    else
+        node->InitInterior(
+            linearNode.axis, UnflattenBVHTree(arena, nodes, offset + 1),
+            UnflattenBVHTree(arena, nodes, linearNode.secondChildOffset));
+    return node;
+}
+
+// Checks that the primitive order and nodes of a cached BVH are consistent
+static bool ValidCachedBVH(const int32_t *primOrder, size_t nPrimitives,
+                           const LinearBVHNode *nodes, size_t nNodes) {
+    for (size_t i = 0; i < nPrimitives; ++i)
+        if (primOrder[i] < 0 || (size_t)primOrder[i] >= nPrimitives)
+            return false;
+    for (size_t i = 0; i < nNodes; ++i) {
+        const LinearBVHNode &node = nodes[i];
+        if (node.nPrimitives > 0 ?
+                (node.primitivesOffset < 0 ||
+                 (size_t)node.primitivesOffset + node.nPrimitives > nPrimitives) :
+                ((size_t)node.secondChildOffset <= i + 1 ||
+                 (size_t)node.secondChildOffset >= nNodes || node.axis > 2))
+            return false;
+    }
+    return nNodes > 0;
+}
+
 // BVHAccel Method Definitions
 BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
-                   int maxPrimsInNode, SplitMethod splitMethod)
+                   int maxPrimsInNode, SplitMethod splitMethod, int width)
     : maxPrimsInNode(std::min(255, maxPrimsInNode)),
       splitMethod(splitMethod),
       primitives(std::move(p)) {
@@ -191,40 +754,140 @@ BVHAccel::BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
 
     // Initialize _primitiveInfo_ array for primitives
     std::vector<BVHPrimitiveInfo> primitiveInfo(primitives.size());
-    for (size_t i = 0; i < primitives.size(); ++i)
-        primitiveInfo[i] = {i, primitives[i]->WorldBound()};
+    ParallelFor([&](int64_t i) {
+        primitiveInfo[i] = {(size_t)i, primitives[i]->WorldBound()};
+    }, primitives.size(), 1024);
+
+    // Look up BVH in scene cache; the tree only depends on the primitive
+    // bounds and the build parameters. HLBVHs are not cached since their
+    // construction is nondeterministic and fast anyway.
+    SceneCacheKey cacheKey("bvh");
+    std::unique_ptr<SceneCacheEntry> cached;
+    const bool useCache =
+        SceneCacheEnabled() && splitMethod != SplitMethod::HLBVH;
+    if (useCache) {
+        cacheKey.Add(this->maxPrimsInNode);
+        cacheKey.Add(splitMethod);
+        cacheKey.Add(primitives.size());
+        for (const BVHPrimitiveInfo &info : primitiveInfo)
+            cacheKey.Add(info.bounds);
+        cached = SceneCacheEntry::Read("bvh", cacheKey.Get());
+    }
+    size_t nCachedPrims = 0, nCachedNodes = 0;
+    const int32_t *cachedPrimOrder =
+        cached ? cached->Section<int32_t>(0, &nCachedPrims) : nullptr;
+    const LinearBVHNode *cachedNodes =
+        cachedPrimOrder ? cached->Section<LinearBVHNode>(1, &nCachedNodes)
+                        : nullptr;
+    if (cachedNodes && (nCachedPrims != primitives.size() ||
+                        !ValidCachedBVH(cachedPrimOrder, nCachedPrims,
+                                        cachedNodes, nCachedNodes))) {
+        Warning("Ignoring inconsistent BVH in scene cache.");
+        cachedNodes = nullptr;
+    }
 
     // Build BVH tree for primitives using _primitiveInfo_
+    const bool wide = width == 4 || width == 8;
     MemoryArena arena(1024 * 1024);
     int totalNodes = 0;
     std::vector<std::shared_ptr<Primitive>> orderedPrims;
-    orderedPrims.reserve(primitives.size());
+    std::vector<int32_t> primOrder;
     BVHBuildNode *root;
-    if (splitMethod == SplitMethod::HLBVH)
+    // Per-thread arenas for the nodes of the subtrees built in parallel
+    std::vector<MemoryArena> threadArenas(MaxThreadIndex());
+    if (cachedNodes) {
+        // Use the cached nodes directly; only the wide BVH is collapsed from
+        // a build tree
+        totalNodes = nCachedNodes;
+        nodes = AllocAligned<LinearBVHNode>(totalNodes);
+        memcpy(nodes, cachedNodes, totalNodes * sizeof(LinearBVHNode));
+        root = wide ? UnflattenBVHTree(arena, nodes, 0) : nullptr;
+        orderedPrims.resize(primitives.size());
+        ParallelFor([&](int64_t i) {
+            orderedPrims[i] = primitives[cachedPrimOrder[i]];
+        }, primitives.size(), 1024);
+    } else if (splitMethod == SplitMethod::HLBVH)
         root = HLBVHBuild(arena, primitiveInfo, &totalNodes, orderedPrims);
-    else
+    else {
+        // Build top levels of BVH, then the subtrees below them in parallel
+        std::vector<BVHBuildTask> tasks;
         root = recursiveBuild(arena, primitiveInfo, 0, primitives.size(),
-                              &totalNodes, orderedPrims);
+                              &tasks);
+        std::sort(tasks.begin(), tasks.end(),
+                  [](const BVHBuildTask &a, const BVHBuildTask &b) {
+                      return a.end - a.start > b.end - b.start;
+                  });
+        ParallelFor([&](int64_t i) {
+            const BVHBuildTask &task = tasks[i];
+            *task.node = *recursiveBuild(threadArenas[ThreadIndex],
+                                         primitiveInfo, task.start, task.end,
+                                         nullptr);
+        }, tasks.size());
+        totalNodes = UpdateNodeCounts(root);
+
+        // The leaves refer to the primitives in the order of _primitiveInfo_
+        orderedPrims.resize(primitives.size());
+        ParallelFor([&](int64_t i) {
+            orderedPrims[i] = primitives[primitiveInfo[i].primitiveNumber];
+        }, primitives.size(), 1024);
+        if (useCache) {
+            primOrder.resize(primitives.size());
+            for (size_t i = 0; i < primitives.size(); ++i)
+                primOrder[i] = primitiveInfo[i].primitiveNumber;
+        }
+    }
+    cached.reset();
     primitives.swap(orderedPrims);
     primitiveInfo.resize(0);
+    size_t arenaBytes = arena.TotalAllocated();
+    for (const MemoryArena &threadArena : threadArenas)
+        arenaBytes += threadArena.TotalAllocated();
     LOG(INFO) << StringPrintf("BVH created with %d nodes for %d "
                               "primitives (%.2f MB), arena allocated %.2f MB",
                               totalNodes, (int)primitives.size(),
                               float(totalNodes * sizeof(LinearBVHNode)) /
                               (1024.f * 1024.f),
-                              float(arena.TotalAllocated()) /
-                              (1024.f * 1024.f));
+                              float(arenaBytes) / (1024.f * 1024.f));
 
-    // Compute representation of depth-first traversal of BVH tree
+    // Compute representation of depth-first traversal of BVH tree (unless
+    // it was cached); this is also needed for writing the scene cache if a
+    // wide BVH is requested
+    const bool writeCache = !primOrder.empty();
+    if (!nodes && (!wide || writeCache)) {
+        nodes = AllocAligned<LinearBVHNode>(totalNodes);
+        CHECK_EQ(totalNodes, root->nNodes);
+        std::vector<BVHBuildTask> tasks;
+        flattenBVHTree(root, 0, &tasks);
+        ParallelFor([&](int64_t i) {
+            flattenBVHTree(tasks[i].node, tasks[i].start, nullptr);
+        }, tasks.size());
+    }
+    if (writeCache) {
+        SceneCacheWriter writer;
+        writer.AddSection(primOrder.data(), primOrder.size());
+        writer.AddSection(nodes, totalNodes);
+        writer.Write("bvh", cacheKey.Get());
+    }
+
+    // Collapse BVH tree into wide BVH, if requested
+    if (wide) {
+        FreeAligned(nodes);
+        nodes = nullptr;
+        if (width == 4)
+            wideBVH4.reset(new WideBVH<4>(root, primitives));
+        else
+            wideBVH8.reset(new WideBVH<8>(root, primitives));
+        treeBytes += (wideBVH4 ? wideBVH4->Bytes() : wideBVH8->Bytes()) +
+                     sizeof(*this) + primitives.size() * sizeof(primitives[0]);
+        return;
+    }
     treeBytes += totalNodes * sizeof(LinearBVHNode) + sizeof(*this) +
                  primitives.size() * sizeof(primitives[0]);
-    nodes = AllocAligned<LinearBVHNode>(totalNodes);
-    int offset = 0;
-    flattenBVHTree(root, &offset);
-    CHECK_EQ(totalNodes, offset);
 }
 
 Bounds3f BVHAccel::WorldBound() const {
+    if (wideBVH4) return wideBVH4->WorldBound();
+    if (wideBVH8) return wideBVH8->WorldBound();
     return nodes ? nodes[0].bounds : Bounds3f();
 }
 
@@ -235,42 +898,56 @@ struct BucketInfo {
 
 BVHBuildNode *BVHAccel::recursiveBuild(
     MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo, int start,
-    int end, int *totalNodes,
-    std::vector<std::shared_ptr<Primitive>> &orderedPrims) {
+    int end, std::vector<BVHBuildTask> *tasks) {
     CHECK_NE(start, end);
     BVHBuildNode *node = arena.Alloc<BVHBuildNode>();
-    (*totalNodes)++;
-    // Compute bounds of all primitives in BVH node
-    Bounds3f bounds;
-    for (int i = start; i < end; ++i)
-        bounds = Union(bounds, primitiveInfo[i].bounds);
     int nPrimitives = end - start;
+    // Defer construction of small subtrees to parallel tasks
+    if (tasks && nPrimitives <= parallelBuildThreshold) {
+        for (int i = start; i < end; ++i)
+            node->bounds = Union(node->bounds, primitiveInfo[i].bounds);
+        tasks->push_back({node, start, end});
+        return node;
+    }
+    // The primitives of the top level nodes are processed in parallel chunks
+    const int nChunks = tasks ? (nPrimitives + 4095) / 4096 : 1;
+
+    // Compute bounds of all primitives and their centroids in BVH node
+    auto computeBounds = [&](int from, int to, Bounds3f *bounds,
+                             Bounds3f *centroidBounds) {
+        for (int i = from; i < to; ++i) {
+            *bounds = Union(*bounds, primitiveInfo[i].bounds);
+            *centroidBounds = Union(*centroidBounds, primitiveInfo[i].centroid);
+        }
+    };
+    Bounds3f bounds, centroidBounds;
+    if (nChunks == 1)
+        computeBounds(start, end, &bounds, &centroidBounds);
+    else {
+        std::vector<Bounds3f> chunkBounds(nChunks), chunkCentroidBounds(nChunks);
+        ForEachBuildChunk(start, end, nChunks,
+                          [&](int chunk, int chunkStart, int chunkEnd) {
+            computeBounds(chunkStart, chunkEnd, &chunkBounds[chunk],
+                          &chunkCentroidBounds[chunk]);
+        });
+        for (int chunk = 0; chunk < nChunks; ++chunk) {
+            bounds = Union(bounds, chunkBounds[chunk]);
+            centroidBounds = Union(centroidBounds, chunkCentroidBounds[chunk]);
+        }
+    }
     if (nPrimitives == 1) {
         // Create leaf _BVHBuildNode_
-        int firstPrimOffset = orderedPrims.size();
-        for (int i = start; i < end; ++i) {
-            int primNum = primitiveInfo[i].primitiveNumber;
-            orderedPrims.push_back(primitives[primNum]);
-        }
-        node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
+        node->InitLeaf(start, nPrimitives, bounds);
         return node;
     } else {
-        // Compute bound of primitive centroids, choose split dimension _dim_
-        Bounds3f centroidBounds;
-        for (int i = start; i < end; ++i)
-            centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+        // Choose split dimension _dim_
         int dim = centroidBounds.MaximumExtent();
 
         // Partition primitives into two sets and build children
         int mid = (start + end) / 2;
         if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
             // Create leaf _BVHBuildNode_
-            int firstPrimOffset = orderedPrims.size();
-            for (int i = start; i < end; ++i) {
-                int primNum = primitiveInfo[i].primitiveNumber;
-                orderedPrims.push_back(primitives[primNum]);
-            }
-            node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
+            node->InitLeaf(start, nPrimitives, bounds);
             return node;
         } else {
             // Partition primitives based on _splitMethod_
@@ -321,16 +998,39 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                     BucketInfo buckets[nBuckets];
 
                     // Initialize _BucketInfo_ for SAH partition buckets
-                    for (int i = start; i < end; ++i) {
-                        int b = nBuckets *
-                                centroidBounds.Offset(
-                                    primitiveInfo[i].centroid)[dim];
-                        if (b == nBuckets) b = nBuckets - 1;
-                        CHECK_GE(b, 0);
-                        CHECK_LT(b, nBuckets);
-                        buckets[b].count++;
-                        buckets[b].bounds =
-                            Union(buckets[b].bounds, primitiveInfo[i].bounds);
+                    auto fillBuckets = [&](int from, int to,
+                                           BucketInfo *buckets) {
+                        for (int i = from; i < to; ++i) {
+                            int b = nBuckets *
+                                    centroidBounds.Offset(
+                                        primitiveInfo[i].centroid)[dim];
+                            if (b == nBuckets) b = nBuckets - 1;
+                            CHECK_GE(b, 0);
+                            CHECK_LT(b, nBuckets);
+                            buckets[b].count++;
+                            buckets[b].bounds = Union(buckets[b].bounds,
+                                                      primitiveInfo[i].bounds);
+                        }
+                    };
+                    if (nChunks == 1)
+                        fillBuckets(start, end, buckets);
+                    else {
+                        std::vector<BucketInfo> chunkBuckets(nChunks *
+                                                             nBuckets);
+                        ForEachBuildChunk(start, end, nChunks,
+                                          [&](int chunk, int chunkStart,
+                                              int chunkEnd) {
+                            fillBuckets(chunkStart, chunkEnd,
+                                        &chunkBuckets[chunk * nBuckets]);
+                        });
+                        for (int chunk = 0; chunk < nChunks; ++chunk)
+                            for (int b = 0; b < nBuckets; ++b) {
+                                const BucketInfo &chunkBucket =
+                                    chunkBuckets[chunk * nBuckets + b];
+                                buckets[b].count += chunkBucket.count;
+                                buckets[b].bounds = Union(buckets[b].bounds,
+                                                          chunkBucket.bounds);
+                            }
                     }
 
                     // Compute costs for splitting after each bucket
@@ -379,12 +1079,7 @@ BVHBuildNode *BVHAccel::recursiveBuild(
                         mid = pmid - &primitiveInfo[0];
                     } else {
                         // Create leaf _BVHBuildNode_
-                        int firstPrimOffset = orderedPrims.size();
-                        for (int i = start; i < end; ++i) {
-                            int primNum = primitiveInfo[i].primitiveNumber;
-                            orderedPrims.push_back(primitives[primNum]);
-                        }
-                        node->InitLeaf(firstPrimOffset, nPrimitives, bounds);
+                        node->InitLeaf(start, nPrimitives, bounds);
                         return node;
                     }
                 }
@@ -393,9 +1088,11 @@ BVHBuildNode *BVHAccel::recursiveBuild(
             }
             node->InitInterior(dim,
                                recursiveBuild(arena, primitiveInfo, start, mid,
-                                              totalNodes, orderedPrims),
+                                              tasks),
                                recursiveBuild(arena, primitiveInfo, mid, end,
-                                              totalNodes, orderedPrims));
+                                              tasks));
+            // Node counts of subtrees built by tasks are not known yet
+            if (tasks) node->nNodes = -1;
         }
     }
     return node;
@@ -637,10 +1334,15 @@ BVHBuildNode *BVHAccel::buildUpperSAH(MemoryArena &arena,
     return node;
 }
 
-int BVHAccel::flattenBVHTree(BVHBuildNode *node, int *offset) {
-    LinearBVHNode *linearNode = &nodes[*offset];
+void BVHAccel::flattenBVHTree(BVHBuildNode *node, int offset,
+                              std::vector<BVHBuildTask> *tasks) {
+    // Defer flattening of small subtrees to parallel tasks
+    if (tasks && node->nNodes <= parallelFlattenThreshold) {
+        tasks->push_back({node, offset, offset + node->nNodes});
+        return;
+    }
+    LinearBVHNode *linearNode = &nodes[offset];
     linearNode->bounds = node->bounds;
-    int myOffset = (*offset)++;
     if (node->nPrimitives > 0) {
         CHECK(!node->children[0] && !node->children[1]);
         CHECK_LT(node->nPrimitives, 65536);
@@ -650,16 +1352,18 @@ int BVHAccel::flattenBVHTree(BVHBuildNode *node, int *offset) {
         // Create interior flattened BVH node
         linearNode->axis = node->splitAxis;
         linearNode->nPrimitives = 0;
-        flattenBVHTree(node->children[0], offset);
-        linearNode->secondChildOffset =
-            flattenBVHTree(node->children[1], offset);
+        linearNode->secondChildOffset = offset + 1 + node->children[0]->nNodes;
+        flattenBVHTree(node->children[0], offset + 1, tasks);
+        flattenBVHTree(node->children[1], linearNode->secondChildOffset,
+                       tasks);
     }
-    return myOffset;
 }
 
 BVHAccel::~BVHAccel() { FreeAligned(nodes); }
 
 bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
+    if (wideBVH4) return wideBVH4->Intersect(ray, isect, primitives);
+    if (wideBVH8) return wideBVH8->Intersect(ray, isect, primitives);
     if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersect);
     bool hit = false;
@@ -700,6 +1404,8 @@ bool BVHAccel::Intersect(const Ray &ray, SurfaceInteraction *isect) const {
 }
 
 bool BVHAccel::IntersectP(const Ray &ray) const {
+    if (wideBVH4) return wideBVH4->IntersectP(ray, primitives);
+    if (wideBVH8) return wideBVH8->IntersectP(ray, primitives);
     if (!nodes) return false;
     ProfilePhase p(Prof::AccelIntersectP);
     Vector3f invDir(1.f / ray.d.x, 1.f / ray.d.y, 1.f / ray.d.z);
@@ -756,7 +1462,13 @@ std::shared_ptr<BVHAccel> CreateBVHAccelerator(
     }
 
     int maxPrimsInNode = ps.FindOneInt("maxnodeprims", 4);
-    return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode, splitMethod);
+    int width = ps.FindOneInt("width", 2);
+    if (width != 2 && width != 4 && width != 8) {
+        Warning("BVH width %d unsupported.  Using 2.", width);
+        width = 2;
+    }
+    return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode,
+                                      splitMethod, width);
 }
 
 }  // namespace pbrt
@@ -50,6 +50,9 @@ struct BVHBuildNode;
 struct BVHPrimitiveInfo;
 struct MortonPrimitive;
 struct LinearBVHNode;
+struct BVHBuildTask;
+template <int N>
+class WideBVH;
 
 // BVHAccel Declarations
 class BVHAccel : public Aggregate {
@@ -60,7 +63,8 @@ class BVHAccel : public Aggregate {
     // BVHAccel Public Methods
     BVHAccel(std::vector<std::shared_ptr<Primitive>> p,
              int maxPrimsInNode = 1,
-             SplitMethod splitMethod = SplitMethod::SAH);
+             SplitMethod splitMethod = SplitMethod::SAH,
+             int width = 2);
     Bounds3f WorldBound() const;
     ~BVHAccel();
     bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
@@ -70,8 +74,7 @@ class BVHAccel : public Aggregate {
     // BVHAccel Private Methods
     BVHBuildNode *recursiveBuild(
         MemoryArena &arena, std::vector<BVHPrimitiveInfo> &primitiveInfo,
-        int start, int end, int *totalNodes,
-        std::vector<std::shared_ptr<Primitive>> &orderedPrims);
+        int start, int end, std::vector<BVHBuildTask> *tasks);
     BVHBuildNode *HLBVHBuild(
         MemoryArena &arena, const std::vector<BVHPrimitiveInfo> &primitiveInfo,
         int *totalNodes,
@@ -85,13 +88,18 @@ class BVHAccel : public Aggregate {
     BVHBuildNode *buildUpperSAH(MemoryArena &arena,
                                 std::vector<BVHBuildNode *> &treeletRoots,
                                 int start, int end, int *totalNodes) const;
-    int flattenBVHTree(BVHBuildNode *node, int *offset);
+    void flattenBVHTree(BVHBuildNode *node, int offset,
+                        std::vector<BVHBuildTask> *tasks);
 
     // BVHAccel Private Data
     const int maxPrimsInNode;
     const SplitMethod splitMethod;
     std::vector<std::shared_ptr<Primitive>> primitives;
     LinearBVHNode *nodes = nullptr;
+    // Wide BVH (width 4 or 8) collapsed from the binary BVH; if present,
+    // it is used instead of _nodes_
+    std::unique_ptr<WideBVH<4>> wideBVH4;
+    std::unique_ptr<WideBVH<8>> wideBVH8;
 };
 
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(
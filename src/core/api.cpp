@@ -124,9 +124,12 @@
 #include "textures/wrinkled.h"
 #include "media/grid.h"
 #include "media/homogeneous.h"
+#include "statistics/scenecache.h"
 #include "statistics/statpath.h"
 
+#include <list>
 #include <map>
+#include <set>
 #include <stdio.h>
 
 namespace pbrt {
@@ -166,9 +169,25 @@ struct TransformSet {
     Transform t[MaxTransforms];
 };
 
+// Shapes whose creation (i.e., loading of a PLY file) has been started
+// asynchronously by pbrtShape(). Their primitives and area lights are created
+// once the scene is made and inserted where pbrtShape() would have inserted
+// them, so the order of primitives and lights doesn't change.
+struct PendingShapes {
+    std::shared_future<std::vector<std::shared_ptr<Shape>>> shapes;
+    std::shared_ptr<ParamSet> params;
+    std::shared_ptr<Material> material;
+    MediumInterface mediumInterface;
+    Transform lightToWorld;
+    std::string areaLight;
+    ParamSet areaLightParams;
+    size_t primitivesOffset, lightsOffset;
+};
+
 struct RenderOptions {
     // RenderOptions Public Methods
     Integrator *MakeIntegrator() const;
+    void CreatePendingShapes();
     Scene *MakeScene();
     Camera *MakeCamera() const;
 
@@ -191,6 +210,7 @@ struct RenderOptions {
     std::map<std::string, std::shared_ptr<Medium>> namedMedia;
     std::vector<std::shared_ptr<Light>> lights;
     std::vector<std::shared_ptr<Primitive>> primitives;
+    std::vector<PendingShapes> pendingShapes;
     std::map<std::string, std::vector<std::shared_ptr<Primitive>>> instances;
     std::vector<std::shared_ptr<Primitive>> *currentInstance = nullptr;
     bool haveScatteringMedia = false;
@@ -380,7 +400,24 @@ static GraphicsState graphicsState;
 static std::vector<GraphicsState> pushedGraphicsStates;
 static std::vector<TransformSet> pushedTransforms;
 static std::vector<uint32_t> pushedActiveTransformBits;
-static TransformCache transformCache;
+static std::unique_ptr<TransformCache> transformCache(new TransformCache);
+
+// Render-server jobs (see pbrtRenderJob()): the scenes of previous jobs are
+// kept resident in LRU order (most recently used first) and the world block
+// of a job is skipped if its scene is resident. Besides the scene, all
+// objects that primitives and lights point to without owning them (i.e.,
+// their transforms and media) are kept.
+struct ResidentScene {
+    uint64_t key;
+    std::shared_ptr<Scene> scene;
+    std::unique_ptr<TransformCache> transformCache;
+    std::map<std::string, std::shared_ptr<Medium>> namedMedia;
+};
+static std::list<ResidentScene> residentScenes;
+static bool inRenderJob = false, parsingJobOverrides = false, jobRendered;
+static uint64_t jobKey;
+static std::shared_ptr<Scene> jobScene;  // Resident scene reused by the job
+static std::set<std::string> overriddenDirectives;
 int catIndentCount = 0;
 
 // API Forward Declarations
@@ -420,6 +457,12 @@ std::vector<std::shared_ptr<Shape>> MakeShapes(const std::string &name,
             func);                                           \
         return;                                              \
     } else /* swallow trailing semicolon */
+#define SKIP_IF_OVERRIDDEN(func)        \
+    if (IsOverridden(func)) return; \
+    else /* swallow trailing semicolon */
+#define SKIP_IF_RESIDENT()  \
+    if (jobScene) return; \
+    else /* swallow trailing semicolon */
 #define FOR_ACTIVE_TRANSFORMS(expr)           \
     for (int i = 0; i < MaxTransforms; ++i)   \
         if (activeTransformBits & (1 << i)) { \
@@ -544,6 +587,27 @@ std::vector<std::shared_ptr<Shape>> MakeShapes(const std::string &name,
     return shapes;
 }
 
+// Creates the primitives of _shapes_ in one block instead of allocating each
+// of them (and its shared_ptr control block) separately; _areaLights_ is
+// either empty or holds the (possibly null) area light of each shape
+static std::vector<std::shared_ptr<Primitive>> MakeGeometricPrimitives(
+    const std::vector<std::shared_ptr<Shape>> &shapes,
+    const std::shared_ptr<Material> &material,
+    const std::vector<std::shared_ptr<AreaLight>> &areaLights,
+    const MediumInterface &mediumInterface) {
+    auto block = std::make_shared<std::vector<GeometricPrimitive>>();
+    block->reserve(shapes.size());
+    std::vector<std::shared_ptr<Primitive>> prims;
+    prims.reserve(shapes.size());
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        block->emplace_back(shapes[i], material,
+                            areaLights.empty() ? nullptr : areaLights[i],
+                            mediumInterface);
+        prims.push_back(std::shared_ptr<Primitive>(block, &block->back()));
+    }
+    return prims;
+}
+
 STAT_COUNTER("Scene/Materials created", nMaterialsCreated);
 
 std::shared_ptr<Material> MakeMaterial(const std::string &name,
@@ -802,8 +866,8 @@ Camera *MakeCamera(const std::string &name, const ParamSet &paramSet,
     static_assert(MaxTransforms == 2,
                   "TransformCache assumes only two transforms");
     Transform *cam2world[2] = {
-        transformCache.Lookup(cam2worldSet[0]),
-        transformCache.Lookup(cam2worldSet[1])
+        transformCache->Lookup(cam2worldSet[0]),
+        transformCache->Lookup(cam2worldSet[1])
     };
     AnimatedTransform animatedCam2World(cam2world[0], transformStart,
                                         cam2world[1], transformEnd);
@@ -879,6 +943,17 @@ Film *MakeFilm(const std::string &name, const ParamSet &paramSet,
     return film;
 }
 
+// API Static Functions
+// Directives of the overrides of a render-server job take precedence over
+// those of the scene file
+static bool IsOverridden(const char *func) {
+    if (parsingJobOverrides) {
+        overriddenDirectives.insert(func);
+        return false;
+    }
+    return overriddenDirectives.count(func) > 0;
+}
+
 // API Function Definitions
 void pbrtInit(const Options &opt) {
     PbrtOptions = opt;
@@ -895,6 +970,7 @@ void pbrtInit(const Options &opt) {
     ParallelInit();  // Threads must be launched before the profiler is
                      // initialized.
     InitProfiler();
+    InitTracing();
 }
 
 void pbrtCleanup() {
@@ -906,6 +982,7 @@ void pbrtCleanup() {
     currentApiState = APIState::Uninitialized;
     ParallelCleanup();
     CleanupProfiler();
+    if (TracingEnabled) WriteTrace(PbrtOptions.traceFile);
 }
 
 void pbrtIdentity() {
@@ -1032,6 +1109,7 @@ void pbrtTransformTimes(Float start, Float end) {
 
 void pbrtPixelFilter(const std::string &name, const ParamSet &params) {
     VERIFY_OPTIONS("PixelFilter");
+    SKIP_IF_OVERRIDDEN("PixelFilter");
     renderOptions->FilterName = name;
     renderOptions->FilterParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1043,6 +1121,7 @@ void pbrtPixelFilter(const std::string &name, const ParamSet &params) {
 
 void pbrtFilm(const std::string &type, const ParamSet &params) {
     VERIFY_OPTIONS("Film");
+    SKIP_IF_OVERRIDDEN("Film");
     renderOptions->FilmParams = params;
     renderOptions->FilmName = type;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1054,6 +1133,7 @@ void pbrtFilm(const std::string &type, const ParamSet &params) {
 
 void pbrtSampler(const std::string &name, const ParamSet &params) {
     VERIFY_OPTIONS("Sampler");
+    SKIP_IF_OVERRIDDEN("Sampler");
     renderOptions->SamplerName = name;
     renderOptions->SamplerParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1065,6 +1145,11 @@ void pbrtSampler(const std::string &name, const ParamSet &params) {
 
 void pbrtAccelerator(const std::string &name, const ParamSet &params) {
     VERIFY_OPTIONS("Accelerator");
+    if (parsingJobOverrides) {
+        Warning("Accelerator cannot be overridden by render-server jobs. "
+                "Ignoring.");
+        return;
+    }
     renderOptions->AcceleratorName = name;
     renderOptions->AcceleratorParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1076,6 +1161,7 @@ void pbrtAccelerator(const std::string &name, const ParamSet &params) {
 
 void pbrtIntegrator(const std::string &name, const ParamSet &params) {
     VERIFY_OPTIONS("Integrator");
+    SKIP_IF_OVERRIDDEN("Integrator");
     renderOptions->IntegratorName = name;
     renderOptions->IntegratorParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1087,6 +1173,7 @@ void pbrtIntegrator(const std::string &name, const ParamSet &params) {
 
 void pbrtCamera(const std::string &name, const ParamSet &params) {
     VERIFY_OPTIONS("Camera");
+    SKIP_IF_OVERRIDDEN("Camera");
     renderOptions->CameraName = name;
     renderOptions->CameraParams = params;
     renderOptions->CameraToWorld = Inverse(curTransform);
@@ -1129,12 +1216,29 @@ void pbrtMediumInterface(const std::string &insideName,
 
 void pbrtWorldBegin() {
     VERIFY_OPTIONS("WorldBegin");
+    if (parsingJobOverrides) {
+        Error("WorldBegin not allowed in render-server job overrides. "
+              "Ignoring.");
+        return;
+    }
     currentApiState = APIState::WorldBlock;
     for (int i = 0; i < MaxTransforms; ++i) curTransform[i] = Transform();
     activeTransformBits = AllTransformsBits;
     namedCoordinateSystems["world"] = curTransform;
+    Material::DeferLUTReductions();
     if (PbrtOptions.cat || PbrtOptions.toPly)
         printf("\n\nWorldBegin\n\n");
+
+    // Reuse the resident scene of a render-server job
+    if (inRenderJob)
+        for (auto iter = residentScenes.begin(); iter != residentScenes.end(); ++iter)
+            if (iter->key == jobKey) {
+                residentScenes.splice(residentScenes.begin(), residentScenes, iter);
+                jobScene = iter->scene;
+                if (!PbrtOptions.quiet)
+                    printf("Reusing resident scene; skipping world block\n");
+                break;
+            }
 }
 
 void pbrtAttributeBegin() {
@@ -1201,6 +1305,7 @@ void pbrtTransformEnd() {
 void pbrtTexture(const std::string &name, const std::string &type,
                  const std::string &texname, const ParamSet &params) {
     VERIFY_WORLD("Texture");
+    SKIP_IF_RESIDENT();
     if (PbrtOptions.cat || PbrtOptions.toPly) {
         printf("%*sTexture \"%s\" \"%s\" \"%s\" ", catIndentCount, "",
                name.c_str(), type.c_str(), texname.c_str());
@@ -1251,6 +1356,7 @@ void pbrtTexture(const std::string &name, const std::string &type,
 
 void pbrtMaterial(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("Material");
+    SKIP_IF_RESIDENT();
     ParamSet emptyParams;
     TextureParams mp(params, emptyParams, *graphicsState.floatTextures,
                      *graphicsState.spectrumTextures);
@@ -1267,6 +1373,7 @@ void pbrtMaterial(const std::string &name, const ParamSet &params) {
 
 void pbrtMakeNamedMaterial(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("MakeNamedMaterial");
+    SKIP_IF_RESIDENT();
     // error checking, warning if replace, what to use for transform?
     ParamSet emptyParams;
     TextureParams mp(params, emptyParams, *graphicsState.floatTextures,
@@ -1298,6 +1405,7 @@ void pbrtMakeNamedMaterial(const std::string &name, const ParamSet &params) {
 
 void pbrtNamedMaterial(const std::string &name) {
     VERIFY_WORLD("NamedMaterial");
+    SKIP_IF_RESIDENT();
     if (PbrtOptions.cat || PbrtOptions.toPly) {
         printf("%*sNamedMaterial \"%s\"\n", catIndentCount, "", name.c_str());
         return;
@@ -1313,6 +1421,7 @@ void pbrtNamedMaterial(const std::string &name) {
 
 void pbrtLightSource(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("LightSource");
+    SKIP_IF_RESIDENT();
     WARN_IF_ANIMATED_TRANSFORM("LightSource");
     MediumInterface mi = graphicsState.CreateMediumInterface();
     std::shared_ptr<Light> lt = MakeLight(name, params, curTransform[0], mi);
@@ -1329,6 +1438,7 @@ void pbrtLightSource(const std::string &name, const ParamSet &params) {
 
 void pbrtAreaLightSource(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("AreaLightSource");
+    SKIP_IF_RESIDENT();
     graphicsState.areaLight = name;
     graphicsState.areaLightParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
@@ -1340,6 +1450,7 @@ void pbrtAreaLightSource(const std::string &name, const ParamSet &params) {
 
 void pbrtShape(const std::string &name, const ParamSet &params) {
     VERIFY_WORLD("Shape");
+    SKIP_IF_RESIDENT();
     std::vector<std::shared_ptr<Primitive>> prims;
     std::vector<std::shared_ptr<AreaLight>> areaLights;
     if (PbrtOptions.cat || (PbrtOptions.toPly && name != "trianglemesh")) {
@@ -1348,12 +1459,47 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         printf("\n");
     }
 
+    if (name == "plymesh" && !curTransform.IsAnimated() &&
+        !renderOptions->currentInstance && !PbrtOptions.cat &&
+        !PbrtOptions.toPly) {
+        // Load PLY mesh asynchronously; the primitives are created by
+        // _RenderOptions::CreatePendingShapes()_
+        Transform *ObjToWorld = transformCache->Lookup(curTransform[0]);
+        Transform *WorldToObj = transformCache->Lookup(Inverse(curTransform[0]));
+        PendingShapes pending;
+        pending.params = std::make_shared<ParamSet>(params);
+        pending.material = graphicsState.GetMaterialForShape(params);
+        pending.mediumInterface = graphicsState.CreateMediumInterface();
+        pending.lightToWorld = curTransform[0];
+        pending.areaLight = graphicsState.areaLight;
+        pending.areaLightParams = graphicsState.areaLightParams;
+        pending.primitivesOffset = renderOptions->primitives.size();
+        pending.lightsOffset = renderOptions->lights.size();
+        // Resolve the alpha textures here; the task gets its own map, since
+        // later texture definitions may modify _graphicsState.floatTextures_
+        auto floatTextures = std::make_shared<GraphicsState::FloatTextureMap>();
+        for (const char *alphaParam : {"alpha", "shadowalpha"}) {
+            std::string texName = params.FindTexture(alphaParam);
+            auto iter = graphicsState.floatTextures->find(texName);
+            if (iter != graphicsState.floatTextures->end())
+                (*floatTextures)[texName] = iter->second;
+        }
+        std::shared_ptr<ParamSet> shapeParams = pending.params;
+        bool reverseOrientation = graphicsState.reverseOrientation;
+        pending.shapes = ParallelAsync([=]() {
+            return CreatePLYMesh(ObjToWorld, WorldToObj, reverseOrientation,
+                                 *shapeParams, &*floatTextures);
+        });
+        renderOptions->pendingShapes.push_back(std::move(pending));
+        return;
+    }
+
     if (!curTransform.IsAnimated()) {
         // Initialize _prims_ and _areaLights_ for static shape
 
         // Create shapes for shape _name_
-        Transform *ObjToWorld = transformCache.Lookup(curTransform[0]);
-        Transform *WorldToObj = transformCache.Lookup(Inverse(curTransform[0]));
+        Transform *ObjToWorld = transformCache->Lookup(curTransform[0]);
+        Transform *WorldToObj = transformCache->Lookup(Inverse(curTransform[0]));
         std::vector<std::shared_ptr<Shape>> shapes =
             MakeShapes(name, ObjToWorld, WorldToObj,
                        graphicsState.reverseOrientation, params);
@@ -1361,18 +1507,19 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         std::shared_ptr<Material> mtl = graphicsState.GetMaterialForShape(params);
         params.ReportUnused();
         MediumInterface mi = graphicsState.CreateMediumInterface();
-        prims.reserve(shapes.size());
-        for (auto s : shapes) {
-            // Possibly create area light for shape
-            std::shared_ptr<AreaLight> area;
-            if (graphicsState.areaLight != "") {
-                area = MakeAreaLight(graphicsState.areaLight, curTransform[0],
-                                     mi, graphicsState.areaLightParams, s);
+        std::vector<std::shared_ptr<AreaLight>> shapeAreaLights;
+        if (graphicsState.areaLight != "") {
+            // Possibly create area light for each shape
+            shapeAreaLights.reserve(shapes.size());
+            for (auto s : shapes) {
+                std::shared_ptr<AreaLight> area =
+                    MakeAreaLight(graphicsState.areaLight, curTransform[0], mi,
+                                  graphicsState.areaLightParams, s);
                 if (area) areaLights.push_back(area);
+                shapeAreaLights.push_back(area);
             }
-            prims.push_back(
-                std::make_shared<GeometricPrimitive>(s, mtl, area, mi));
         }
+        prims = MakeGeometricPrimitives(shapes, mtl, shapeAreaLights, mi);
     } else {
         // Initialize _prims_ and _areaLights_ for animated shape
 
@@ -1381,7 +1528,7 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
             Warning(
                 "Ignoring currently set area light when creating "
                 "animated shape");
-        Transform *identity = transformCache.Lookup(Transform());
+        Transform *identity = transformCache->Lookup(Transform());
         std::vector<std::shared_ptr<Shape>> shapes = MakeShapes(
             name, identity, identity, graphicsState.reverseOrientation, params);
         if (shapes.empty()) return;
@@ -1390,10 +1537,7 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         std::shared_ptr<Material> mtl = graphicsState.GetMaterialForShape(params);
         params.ReportUnused();
         MediumInterface mi = graphicsState.CreateMediumInterface();
-        prims.reserve(shapes.size());
-        for (auto s : shapes)
-            prims.push_back(
-                std::make_shared<GeometricPrimitive>(s, mtl, nullptr, mi));
+        prims = MakeGeometricPrimitives(shapes, mtl, {}, mi);
 
         // Create single _TransformedPrimitive_ for _prims_
 
@@ -1401,8 +1545,8 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
         static_assert(MaxTransforms == 2,
                       "TransformCache assumes only two transforms");
         Transform *ObjToWorld[2] = {
-            transformCache.Lookup(curTransform[0]),
-            transformCache.Lookup(curTransform[1])
+            transformCache->Lookup(curTransform[0]),
+            transformCache->Lookup(curTransform[1])
         };
         AnimatedTransform animatedObjectToWorld(
             ObjToWorld[0], renderOptions->transformStartTime, ObjToWorld[1],
@@ -1432,6 +1576,7 @@ void pbrtShape(const std::string &name, const ParamSet &params) {
 
 void pbrtExtraParams(const std::string &type, const ParamSet &params) {
     VERIFY_OPTIONS("ExtraParams");
+    SKIP_IF_OVERRIDDEN("ExtraParams");
     renderOptions->ExtraParams = params;
     if (PbrtOptions.cat || PbrtOptions.toPly) {
         printf("%*sExtraParams \"%s\" ", catIndentCount, "", type.c_str());
@@ -1541,6 +1686,7 @@ void pbrtReverseOrientation() {
 
 void pbrtObjectBegin(const std::string &name) {
     VERIFY_WORLD("ObjectBegin");
+    SKIP_IF_RESIDENT();
     pbrtAttributeBegin();
     if (renderOptions->currentInstance)
         Error("ObjectBegin called inside of instance definition");
@@ -1554,6 +1700,7 @@ STAT_COUNTER("Scene/Object instances created", nObjectInstancesCreated);
 
 void pbrtObjectEnd() {
     VERIFY_WORLD("ObjectEnd");
+    SKIP_IF_RESIDENT();
     if (!renderOptions->currentInstance)
         Error("ObjectEnd called outside of instance definition");
     if (PbrtOptions.cat || PbrtOptions.toPly)
@@ -1567,6 +1714,7 @@ STAT_COUNTER("Scene/Object instances used", nObjectInstancesUsed);
 
 void pbrtObjectInstance(const std::string &name) {
     VERIFY_WORLD("ObjectInstance");
+    SKIP_IF_RESIDENT();
     if (PbrtOptions.cat || PbrtOptions.toPly) {
         printf("%*sObjectInstance \"%s\"\n", catIndentCount, "", name.c_str());
         return;
@@ -1598,8 +1746,8 @@ void pbrtObjectInstance(const std::string &name) {
                   "TransformCache assumes only two transforms");
     // Create _animatedInstanceToWorld_ transform for instance
     Transform *InstanceToWorld[2] = {
-        transformCache.Lookup(curTransform[0]),
-        transformCache.Lookup(curTransform[1])
+        transformCache->Lookup(curTransform[0]),
+        transformCache->Lookup(curTransform[1])
     };
     AnimatedTransform animatedInstanceToWorld(
         InstanceToWorld[0], renderOptions->transformStartTime,
@@ -1622,12 +1770,28 @@ void pbrtWorldEnd() {
         pushedTransforms.pop_back();
     }
 
+    // Wait for asynchronously loaded meshes and textures
+    {
+        TraceScope t("Wait for asset loading");
+        ImageTexture<Float, Float>::ResolvePending();
+        ImageTexture<RGBSpectrum, Spectrum>::ResolvePending();
+        renderOptions->CreatePendingShapes();
+    }
+
+    // Compute the reduced LUTs of all materials in parallel
+    {
+        TraceScope t("Reduce albedo LUTs");
+        Material::ReduceDeferredLUTs();
+    }
+
     // Create scene and render
     if (PbrtOptions.cat || PbrtOptions.toPly) {
         printf("%*sWorldEnd\n", catIndentCount, "");
     } else {
         std::unique_ptr<Integrator> integrator(renderOptions->MakeIntegrator());
-        std::unique_ptr<Scene> scene(renderOptions->MakeScene());
+        std::shared_ptr<Scene> scene =
+            jobScene ? jobScene
+                     : std::shared_ptr<Scene>(renderOptions->MakeScene());
 
         // This is kind of ugly; we directly override the current profiler
         // state to switch from parsing/scene construction related stuff to
@@ -1643,16 +1807,28 @@ void pbrtWorldEnd() {
                 integrator->Denoise(*scene);
             else
                 integrator->Render(*scene);
+            jobRendered = true;
         }
 
         CHECK_EQ(CurrentProfilerState(), ProfToBits(Prof::IntegratorRender));
         ProfilerState = ProfToBits(Prof::SceneConstruction);
+
+        // Keep new scene of a render-server job resident (evicting the least
+        // recently used scenes)
+        if (inRenderJob && scene && !jobScene &&
+            PbrtOptions.residentScenes > 0) {
+            residentScenes.push_front({jobKey, scene, std::move(transformCache),
+                                       renderOptions->namedMedia});
+            transformCache.reset(new TransformCache);
+            while (residentScenes.size() > (size_t)PbrtOptions.residentScenes)
+                residentScenes.pop_back();
+        }
     }
 
     // Clean up after rendering. Do this before reporting stats so that
     // destructors can run and update stats as needed.
     graphicsState = GraphicsState();
-    transformCache.Clear();
+    transformCache->Clear();
     currentApiState = APIState::OptionsBlock;
     ImageTexture<Float, Float>::ClearCache();
     ImageTexture<RGBSpectrum, Spectrum>::ClearCache();
@@ -1675,7 +1851,111 @@ void pbrtWorldEnd() {
                                  namedCoordinateSystems.end());
 }
 
+bool pbrtRenderJob(const std::string &filename, const std::string &overrides) {
+    if (currentApiState == APIState::Uninitialized) {
+        Error("pbrtInit() must be before calling \"pbrtRenderJob()\".");
+        return false;
+    } else if (currentApiState == APIState::WorldBlock) {
+        Error("pbrtRenderJob() called inside world block.");
+        return false;
+    }
+
+    // Resident scenes are identified by the absolute path and modification
+    // time of the scene file
+    SceneCacheKey key("scene");
+    if (!key.AddFile(filename)) {
+        Error("%s: unable to read scene file", filename.c_str());
+        return false;
+    }
+    inRenderJob = true;
+    jobKey      = key.Get();
+    jobRendered = false;
+
+    // Parse overrides and reset the transforms they may have set so that
+    // they don't affect the scene file
+    parsingJobOverrides = true;
+    pbrtParseString(overrides);
+    parsingJobOverrides = false;
+    for (int i = 0; i < MaxTransforms; ++i) curTransform[i] = Transform();
+    activeTransformBits = AllTransformsBits;
+
+    pbrtParseFile(filename);
+    if (currentApiState == APIState::WorldBlock) {
+        Error("%s: missing WorldEnd", filename.c_str());
+
+        // Discard the world block so that the following jobs start from a
+        // clean state; pending meshes still refer to the transform cache
+        for (const PendingShapes &pending : renderOptions->pendingShapes)
+            pending.shapes.wait();
+        ImageTexture<Float, Float>::ResolvePending();
+        ImageTexture<RGBSpectrum, Spectrum>::ResolvePending();
+        pushedGraphicsStates.clear();
+        pushedTransforms.clear();
+        pushedActiveTransformBits.clear();
+        graphicsState = GraphicsState();
+        transformCache->Clear();
+        currentApiState = APIState::OptionsBlock;
+        ImageTexture<Float, Float>::ClearCache();
+        ImageTexture<RGBSpectrum, Spectrum>::ClearCache();
+        renderOptions.reset(new RenderOptions);
+        for (int i = 0; i < MaxTransforms; ++i) curTransform[i] = Transform();
+        activeTransformBits = AllTransformsBits;
+        namedCoordinateSystems.clear();
+    }
+
+    inRenderJob = false;
+    jobScene.reset();
+    overriddenDirectives.clear();
+    return jobRendered;
+}
+
+void pbrtClearResidentScenes() { residentScenes.clear(); }
+
+void RenderOptions::CreatePendingShapes() {
+    if (pendingShapes.empty()) return;
+    std::vector<std::shared_ptr<Primitive>> allPrimitives;
+    std::vector<std::shared_ptr<Light>> allLights;
+    size_t primitivesOffset = 0, lightsOffset = 0;
+    for (const PendingShapes &pending : pendingShapes) {
+        // Add the primitives and lights created before _pending_
+        allPrimitives.insert(allPrimitives.end(),
+                             primitives.begin() + primitivesOffset,
+                             primitives.begin() + pending.primitivesOffset);
+        allLights.insert(allLights.end(), lights.begin() + lightsOffset,
+                         lights.begin() + pending.lightsOffset);
+        primitivesOffset = pending.primitivesOffset;
+        lightsOffset = pending.lightsOffset;
+
+        // Create primitives and area lights for the loaded shapes
+        const std::vector<std::shared_ptr<Shape>> &shapes =
+            ParallelWait(pending.shapes);
+        std::vector<std::shared_ptr<AreaLight>> shapeAreaLights;
+        if (pending.areaLight != "") {
+            shapeAreaLights.reserve(shapes.size());
+            for (const std::shared_ptr<Shape> &s : shapes) {
+                std::shared_ptr<AreaLight> area = MakeAreaLight(
+                    pending.areaLight, pending.lightToWorld,
+                    pending.mediumInterface, pending.areaLightParams, s);
+                if (area) allLights.push_back(area);
+                shapeAreaLights.push_back(area);
+            }
+        }
+        std::vector<std::shared_ptr<Primitive>> prims = MakeGeometricPrimitives(
+            shapes, pending.material, shapeAreaLights, pending.mediumInterface);
+        allPrimitives.insert(allPrimitives.end(), prims.begin(), prims.end());
+        pending.params->ReportUnused();
+    }
+    allPrimitives.insert(allPrimitives.end(),
+                         primitives.begin() + primitivesOffset, primitives.end());
+    allLights.insert(allLights.end(), lights.begin() + lightsOffset,
+                     lights.end());
+    primitives.swap(allPrimitives);
+    lights.swap(allLights);
+    pendingShapes.clear();
+}
+
 Scene *RenderOptions::MakeScene() {
+    TraceScope t("Scene construction");
     std::shared_ptr<Primitive> accelerator =
         MakeAccelerator(AcceleratorName, std::move(primitives), AcceleratorParams);
     if (!accelerator) accelerator = std::make_shared<BVHAccel>(primitives);
@@ -1687,6 +1967,7 @@ Scene *RenderOptions::MakeScene() {
 }
 
 Integrator *RenderOptions::MakeIntegrator() const {
+    TraceScope t("Integrator construction");
     std::shared_ptr<const Camera> camera(MakeCamera());
     if (!camera) {
         Error("Unable to create camera");
@@ -1761,7 +2042,7 @@ Integrator *RenderOptions::MakeIntegrator() const {
 
     IntegratorParams.ReportUnused();
     // Warn if no light sources are defined
-    if (lights.empty())
+    if (lights.empty() && !jobScene)
         Warning(
             "No light sources defined in scene; "
             "rendering a black image.");
@@ -102,6 +102,15 @@ void pbrtWorldEnd();
 void pbrtParseFile(std::string filename);
 void pbrtParseString(std::string str);
 
+// Render-Server Function Declarations
+// Renders the scene in _filename_ with the options-block directives of
+// _overrides_ (e.g., Integrator, Sampler, Film) taking precedence over those
+// of the file. Scenes of previous jobs are kept resident (up to
+// PbrtOptions.residentScenes) and reused if the file has not been modified.
+// Returns false if nothing was rendered.
+bool pbrtRenderJob(const std::string &filename, const std::string &overrides);
+void pbrtClearResidentScenes();
+
 }  // namespace pbrt
 
 #endif  // PBRT_CORE_API_H
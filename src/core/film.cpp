@@ -50,6 +50,8 @@
 namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Film pixels", filmPixelMemory);
+STAT_PERCENT("Film/Contended film merge locks", nContendedMergeLocks, nMergeLocks);
+STAT_PERCENT("NUMA/Socket-local film tile rows", nLocalFilmTileRows, nFilmTileRows);
 
 // Film Method Definitions
 Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
@@ -77,6 +79,10 @@ Film::Film(const Point2i &resolution, const Bounds2f &cropWindow,
 
     filmPixelMemory += area * sizeof(Pixel);
 
+    nMergeLockCells = Point2i((width  + mergeLockCellSize - 1) / mergeLockCellSize,
+                              (height + mergeLockCellSize - 1) / mergeLockCellSize);
+    mergeMutexes.reset(new std::mutex[std::max(nMergeLockCells.x * nMergeLockCells.y, 1)]);
+
     // Precompute filter weight table
     int offset = 0;
     for (int y = 0; y < filterTableWidth; ++y) {
@@ -133,19 +139,70 @@ void Film::Clear() {
     }
 }
 
+// Places the pixels on the NUMA nodes of the threads that merge the
+// corresponding rows (see --firsttouch); all-zero pixels are cleared pixels
+void Film::FirstTouch(bool hugePages) {
+    ParallelFirstTouch(buffer.pixels.get(), width * sizeof(Pixel), height,
+                       hugePages);
+}
+
 void Film::MergeFilmTile(std::shared_ptr<FilmTile> tile) {
     ProfilePhase p(Prof::MergeFilmTile);
+    TraceScope t("MergeFilmTile");
     VLOG(1) << "Merging film tile " << tile->pixelBounds;
-    std::lock_guard<std::mutex> lock(mutex);
-    for (Point2i pixel : tile->GetPixelBounds()) {
-        // Merge _pixel_ into _Film::pixels_
-        const FilmTilePixel &tilePixel = tile->GetPixel(pixel);
-        Pixel &mergePixel = GetPixel(pixel);
-        Float xyz[3];
-        tilePixel.contribSum.ToXYZ(xyz);
-        for (int i = 0; i < 3; ++i) mergePixel.xyz[i] += xyz[i];
-        mergePixel.filterWeightSum += tilePixel.filterWeightSum;
+    const Bounds2i tileBounds = tile->GetPixelBounds();
+    if (tileBounds.pMin.x >= tileBounds.pMax.x ||
+        tileBounds.pMin.y >= tileBounds.pMax.y)
+        return;
+
+    // Report how many of the tile's rows reside on the NUMA node of the
+    // merging thread
+    if (PbrtOptions.firstTouch) {
+        const int nRows = tileBounds.pMax.y - tileBounds.pMin.y;
+        const void **rows = ALLOCA(const void *, nRows);
+        int *nodes = ALLOCA(int, nRows);
+        for (int y = 0; y < nRows; ++y)
+            rows[y] = &GetPixel(Point2i(tileBounds.pMin.x, tileBounds.pMin.y + y));
+        const int node = CurrentNumaNode();
+        if (node >= 0 && GetNumaNodes(rows, nRows, nodes)) {
+            nFilmTileRows += nRows;
+            for (int y = 0; y < nRows; ++y)
+                if (nodes[y] == node) ++nLocalFilmTileRows;
+        }
     }
+
+    // Merge cell by cell, holding only the lock of the current cell; as film
+    // tiles only overlap by the filter radius, contention is limited to the
+    // cells at the tile borders
+    const Point2i c0((tileBounds.pMin.x - croppedPixelBounds.pMin.x) / mergeLockCellSize,
+                     (tileBounds.pMin.y - croppedPixelBounds.pMin.y) / mergeLockCellSize);
+    const Point2i c1((tileBounds.pMax.x - 1 - croppedPixelBounds.pMin.x) / mergeLockCellSize + 1,
+                     (tileBounds.pMax.y - 1 - croppedPixelBounds.pMin.y) / mergeLockCellSize + 1);
+    for (int cy = c0.y; cy < c1.y; ++cy)
+        for (int cx = c0.x; cx < c1.x; ++cx) {
+            const Point2i cellMin = croppedPixelBounds.pMin +
+                                    Vector2i(cx, cy) * mergeLockCellSize;
+            const Bounds2i cellBounds = Intersect(
+                tileBounds,
+                Bounds2i(cellMin, cellMin + Vector2i(mergeLockCellSize, mergeLockCellSize)));
+
+            std::mutex &mutex = mergeMutexes[cy * nMergeLockCells.x + cx];
+            ++nMergeLocks;
+            std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                ++nContendedMergeLocks;
+                lock.lock();
+            }
+            for (Point2i pixel : cellBounds) {
+                // Merge _pixel_ into _Film::pixels_
+                const FilmTilePixel &tilePixel = tile->GetPixel(pixel);
+                Pixel &mergePixel = GetPixel(pixel);
+                Float xyz[3];
+                tilePixel.contribSum.ToXYZ(xyz);
+                for (int i = 0; i < 3; ++i) mergePixel.xyz[i] += xyz[i];
+                mergePixel.filterWeightSum += tilePixel.filterWeightSum;
+            }
+        }
 }
 
 void Film::SetImage(const Spectrum *img) const {
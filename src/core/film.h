@@ -88,7 +88,11 @@ class Film {
 
         std::unique_ptr<Pixel[]> pixels;
     };
-    std::mutex mutex;
+    // One lock per cell of mergeLockCellSize^2 pixels, so that only tiles
+    // that merge into the same cells (i.e., their filter-radius borders)
+    // contend
+    Point2i nMergeLockCells;
+    std::unique_ptr<std::mutex[]> mergeMutexes;
     const Float scale;
     const Float maxSampleLuminance;
 
@@ -117,6 +121,7 @@ class Film {
     void UpdateImage(const Float splatScale = 1);
     void WriteImage(const Float splatScale = 1);
     virtual void Clear(); // virtual keyword makes Film polymorphic
+    void FirstTouch(bool hugePages);
 
     // Film Public Data
     const Point2i fullResolution;
@@ -132,6 +137,7 @@ class Film {
   protected:
     // Film Protected Data
     static PBRT_CONSTEXPR int filterTableWidth = 16;
+    static PBRT_CONSTEXPR int mergeLockCellSize = 16;
     Float filterTable[filterTableWidth * filterTableWidth];
 };
 
@@ -190,6 +196,40 @@ class FilmTile {
             }
         }
     }
+    // For filters whose support does not exceed a pixel (e.g., box filters
+    // with radius .5), a sample usually contributes to a single pixel. In
+    // that case, returns the pixel, the filter weight and, in _L_, the
+    // contribution as AddSample() would accumulate it, so that the caller can
+    // accumulate it in its own per-pixel structure (see FilmStatTilePixel)
+    // and later add it to this tile. Returns false otherwise (e.g., for
+    // samples on pixel borders).
+    bool GetSinglePixelSample(const Point2f &pFilm, Spectrum *L,
+                              Float sampleWeight, Point2i *pixel,
+                              Float *filterWeight) const {
+        // Compute sample's raster bounds
+        Point2f pFilmDiscrete = pFilm - Vector2f(0.5f, 0.5f);
+        Point2i p0 = (Point2i)Ceil(pFilmDiscrete - filterRadius);
+        Point2i p1 =
+            (Point2i)Floor(pFilmDiscrete + filterRadius) + Point2i(1, 1);
+        p0 = Max(p0, pixelBounds.pMin);
+        p1 = Min(p1, pixelBounds.pMax);
+        if (p1.x - p0.x != 1 || p1.y - p0.y != 1) return false;
+
+        // Evaluate filter value at the pixel
+        int ifx = std::min((int)std::floor(std::abs(
+                               (p0.x - pFilmDiscrete.x) * invFilterRadius.x *
+                               filterTableSize)),
+                           filterTableSize - 1);
+        int ify = std::min((int)std::floor(std::abs(
+                               (p0.y - pFilmDiscrete.y) * invFilterRadius.y *
+                               filterTableSize)),
+                           filterTableSize - 1);
+        *filterWeight = filterTable[ify * filterTableSize + ifx];
+        *pixel = p0;
+        if (L->y() > maxSampleLuminance) *L *= maxSampleLuminance / L->y();
+        *L *= sampleWeight;
+        return true;
+    }
     FilmTilePixel &GetPixel(const Point2i &p) {
         CHECK(InsideExclusive(p, pixelBounds));
         int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
@@ -58,6 +58,8 @@ inline bool IsDeltaLight(int flags) {
            flags & (int)LightFlags::DeltaDirection;
 }
 
+struct LightBounds;
+
 // Light Declarations
 class Light {
   public:
@@ -77,6 +79,9 @@ class Light {
                                Float *pdfDir) const = 0;
     virtual void Pdf_Le(const Ray &ray, const Normal3f &nLight, Float *pdfPos,
                         Float *pdfDir) const = 0;
+    // Returns the bounds of the emission for the light BVH, or false if
+    // the light is not bounded in space (e.g., infinite lights)
+    virtual bool GetBounds(LightBounds *lightBounds) const { return false; }
 
     // Light Public Data
     const int flags;
@@ -39,6 +39,7 @@
 #include "scene.h"
 #include "stats.h"
 #include "integrator.h"
+#include "interaction.h"
 #include <numeric>
 
 namespace pbrt {
@@ -85,13 +86,8 @@ const Distribution1D *PowerLightDistribution::Lookup(const Point3f &p) const {
 // SpatialLightDistribution
 
 STAT_COUNTER("SpatialLightDistribution/Distributions created", nCreated);
+STAT_COUNTER("SpatialLightDistribution/Distributions precomputed", nPrecomputed);
 STAT_RATIO("SpatialLightDistribution/Lookups per distribution", nLookups, nDistributions);
-STAT_INT_DISTRIBUTION("SpatialLightDistribution/Hash probes per lookup", nProbesPerLookup);
-
-// Voxel coordinates are packed into a uint64_t for hash table lookups;
-// 10 bits are allocated to each coordinate.  invalidPackedPos is an impossible
-// packed coordinate value, which we use to represent
-static const uint64_t invalidPackedPos = 0xffffffffffffffff;
 
 SpatialLightDistribution::SpatialLightDistribution(const Scene &scene,
                                                    int maxVoxels)
@@ -102,19 +98,14 @@ SpatialLightDistribution::SpatialLightDistribution(const Scene &scene,
     Bounds3f b = scene.WorldBound();
     Vector3f diag = b.Diagonal();
     Float bmax = diag[b.MaximumExtent()];
-    for (int i = 0; i < 3; ++i) {
+    for (int i = 0; i < 3; ++i)
         nVoxels[i] = std::max(1, int(std::round(diag[i] / bmax * maxVoxels)));
-        // In the Lookup() method, we require that 20 or fewer bits be
-        // sufficient to represent each coordinate value. It's fairly hard
-        // to imagine that this would ever be a problem.
-        CHECK_LT(nVoxels[i], 1 << 20);
-    }
 
-    hashTableSize = 4 * nVoxels[0] * nVoxels[1] * nVoxels[2];
-    hashTable.reset(new HashEntry[hashTableSize]);
-    for (int i = 0; i < hashTableSize; ++i) {
-        hashTable[i].packedPos.store(invalidPackedPos);
-        hashTable[i].distribution.store(nullptr);
+    const int nTotalVoxels = nVoxels[0] * nVoxels[1] * nVoxels[2];
+    voxels.reset(new Voxel[nTotalVoxels]);
+    for (int i = 0; i < nTotalVoxels; ++i) {
+        voxels[i].distribution.store(nullptr);
+        voxels[i].claimed.store(false);
     }
 
     LOG(INFO) << "SpatialLightDistribution: scene bounds " << b <<
@@ -123,21 +114,11 @@ SpatialLightDistribution::SpatialLightDistribution(const Scene &scene,
 }
 
 SpatialLightDistribution::~SpatialLightDistribution() {
-    // Gather statistics about how well the computed distributions are across
-    // the buckets.
-    for (size_t i = 0; i < hashTableSize; ++i) {
-        HashEntry &entry = hashTable[i];
-        if (entry.distribution.load())
-            delete entry.distribution.load();
-    }
+    for (int i = 0; i < nVoxels[0] * nVoxels[1] * nVoxels[2]; ++i)
+        delete voxels[i].distribution.load();
 }
 
-const Distribution1D *SpatialLightDistribution::Lookup(const Point3f &p) const {
-    ProfilePhase _(Prof::LightDistribLookup);
-    ++nLookups;
-
-    // First, compute integer voxel coordinates for the given point |p|
-    // with respect to the overall voxel grid.
+Point3i SpatialLightDistribution::VoxelCoordinates(const Point3f &p) const {
     Vector3f offset = scene.WorldBound().Offset(p);  // offset in [0,1].
     Point3i pi;
     for (int i = 0; i < 3; ++i)
@@ -145,88 +126,105 @@ const Distribution1D *SpatialLightDistribution::Lookup(const Point3f &p) const {
         // robust to computed intersection points being slightly outside
         // the scene bounds due to floating-point roundoff error.
         pi[i] = Clamp(int(offset[i] * nVoxels[i]), 0, nVoxels[i] - 1);
+    return pi;
+}
 
-    // Pack the 3D integer voxel coordinates into a single 64-bit value.
-    uint64_t packedPos = (uint64_t(pi[0]) << 40) | (uint64_t(pi[1]) << 20) | pi[2];
-    CHECK_NE(packedPos, invalidPackedPos);
-
-    // Compute a hash value from the packed voxel coordinates.  We could
-    // just take packedPos mod the hash table size, but since packedPos
-    // isn't necessarily well distributed on its own, it's worthwhile to do
-    // a little work to make sure that its bits values are individually
-    // fairly random. For details of and motivation for the following, see:
-    // http://zimbry.blogspot.ch/2011/09/better-bit-mixing-improving-on.html
-    uint64_t hash = packedPos;
-    hash ^= (hash >> 31);
-    hash *= 0x7fb5d329728ea185;
-    hash ^= (hash >> 27);
-    hash *= 0x81dadef4bc2dd44d;
-    hash ^= (hash >> 33);
-    hash %= hashTableSize;
-    CHECK_GE(hash, 0);
-
-    // Now, see if the hash table already has an entry for the voxel. We'll
-    // use quadratic probing when the hash table entry is already used for
-    // another value; step stores the square root of the probe step.
-    int step = 1;
-    int nProbes = 0;
-    while (true) {
-        ++nProbes;
-        HashEntry &entry = hashTable[hash];
-        // Does the hash table entry at offset |hash| match the current point?
-        uint64_t entryPackedPos = entry.packedPos.load(std::memory_order_acquire);
-        if (entryPackedPos == packedPos) {
-            // Yes! Most of the time, there should already by a light
-            // sampling distribution available.
-            Distribution1D *dist = entry.distribution.load(std::memory_order_acquire);
-            if (dist == nullptr) {
-                // Rarely, another thread will have already done a lookup
-                // at this point, found that there isn't a sampling
-                // distribution, and will already be computing the
-                // distribution for the point.  In this case, we spin until
-                // the sampling distribution is ready.  We assume that this
-                // is a rare case, so don't do anything more sophisticated
-                // than spinning.
-                ProfilePhase _(Prof::LightDistribSpinWait);
-                while ((dist = entry.distribution.load(std::memory_order_acquire)) ==
-                       nullptr)
-                    // spin :-(. If we were fancy, we'd have any threads
-                    // that hit this instead help out with computing the
-                    // distribution for the voxel...
-                    ;
-            }
-            // We have a valid sampling distribution.
-            ReportValue(nProbesPerLookup, nProbes);
-            return dist;
-        } else if (entryPackedPos != invalidPackedPos) {
-            // The hash table entry we're checking has already been
-            // allocated for another voxel. Advance to the next entry with
-            // quadratic probing.
-            hash += step * step;
-            if (hash >= hashTableSize)
-                hash %= hashTableSize;
-            ++step;
-        } else {
-            // We have found an invalid entry. (Though this may have
-            // changed since the load into entryPackedPos above.)  Use an
-            // atomic compare/exchange to try to claim this entry for the
-            // current position.
-            uint64_t invalid = invalidPackedPos;
-            if (entry.packedPos.compare_exchange_weak(invalid, packedPos)) {
-                // Success; we've claimed this position for this voxel's
-                // distribution. Now compute the sampling distribution and
-                // add it to the hash table. As long as packedPos has been
-                // set but the entry's distribution pointer is nullptr, any
-                // other threads looking up the distribution for this voxel
-                // will spin wait until the distribution pointer is
-                // written.
-                Distribution1D *dist = ComputeDistribution(pi);
-                entry.distribution.store(dist, std::memory_order_release);
-                ReportValue(nProbesPerLookup, nProbes);
-                return dist;
+const Distribution1D *SpatialLightDistribution::Lookup(const Point3f &p) const {
+    ProfilePhase _(Prof::LightDistribLookup);
+    ++nLookups;
+
+    // First, compute integer voxel coordinates for the given point |p|
+    // with respect to the overall voxel grid.
+    Point3i pi = VoxelCoordinates(p);
+    Voxel &voxel = voxels[VoxelIndex(pi)];
+
+    // Most of the time, there should already be a light sampling
+    // distribution available.
+    Distribution1D *dist = voxel.distribution.load(std::memory_order_acquire);
+    if (dist) return dist;
+
+    // Otherwise, try to claim the voxel for computing its distribution.
+    if (!voxel.claimed.exchange(true, std::memory_order_acq_rel)) {
+        // Success; compute the sampling distribution and add it to the
+        // voxel. As long as the voxel has been claimed but its
+        // distribution pointer is nullptr, any other threads looking up
+        // the distribution for this voxel will spin wait until the
+        // distribution pointer is written.
+        dist = ComputeDistribution(pi);
+        voxel.distribution.store(dist, std::memory_order_release);
+        return dist;
+    }
+
+    // Rarely, another thread will have already done a lookup in the voxel,
+    // found that there isn't a sampling distribution, and will already be
+    // computing the distribution.  In this case, we spin until the
+    // sampling distribution is ready. (Precompute() avoids this for
+    // surface points.)
+    {
+        ProfilePhase _(Prof::LightDistribSpinWait);
+        while ((dist = voxel.distribution.load(std::memory_order_acquire)) ==
+               nullptr)
+            ;
+    }
+    return dist;
+}
+
+void SpatialLightDistribution::Precompute() {
+    // Find the voxels that contain geometry: trace a stratified grid of
+    // nRays x nRays rays along each axis through each column of voxels and
+    // mark the voxels of all intersections along them
+    const Bounds3f &b = scene.WorldBound();
+    const int nTotalVoxels = nVoxels[0] * nVoxels[1] * nVoxels[2];
+    const int nRays = 4;
+    std::unique_ptr<std::atomic<bool>[]> occupied(
+        new std::atomic<bool>[nTotalVoxels]);
+    for (int i = 0; i < nTotalVoxels; ++i) occupied[i].store(false);
+    for (int axis = 0; axis < 3; ++axis) {
+        const int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+        // Bound the number of intersections per ray in case that spawned
+        // rays do not advance
+        const int maxHits = 64 * nVoxels[axis];
+        ParallelFor([&](int64_t column) {
+            const int i1 = column % nVoxels[a1], i2 = column / nVoxels[a1];
+            for (int s = 0; s < nRays * nRays; ++s) {
+                Point3f o;
+                o[a1] = Lerp((i1 + (s % nRays + .5f) / nRays) / nVoxels[a1],
+                             b.pMin[a1], b.pMax[a1]);
+                o[a2] = Lerp((i2 + (s / nRays + .5f) / nRays) / nVoxels[a2],
+                             b.pMin[a2], b.pMax[a2]);
+                o[axis] = Lerp(-.01f, b.pMin[axis], b.pMax[axis]);
+                Vector3f d(0, 0, 0);
+                d[axis] = 1;
+                Ray ray(o, d);
+                SurfaceInteraction isect;
+                for (int hit = 0; hit < maxHits && scene.Intersect(ray, &isect);
+                     ++hit) {
+                    occupied[VoxelIndex(VoxelCoordinates(isect.p))].store(
+                        true, std::memory_order_relaxed);
+                    ray = isect.SpawnRay(d);
+                }
             }
-        }
+        }, nVoxels[a1] * nVoxels[a2], 16);
     }
+
+    // Compute the distributions of the occupied voxels in parallel
+    std::vector<int> occupiedVoxels;
+    for (int i = 0; i < nTotalVoxels; ++i)
+        if (occupied[i].load(std::memory_order_relaxed))
+            occupiedVoxels.push_back(i);
+    ParallelFor([&](int64_t i) {
+        const int index = occupiedVoxels[i];
+        Voxel &voxel = voxels[index];
+        if (voxel.claimed.exchange(true, std::memory_order_acq_rel)) return;
+        const Point3i pi(index % nVoxels[0], (index / nVoxels[0]) % nVoxels[1],
+                         index / (nVoxels[0] * nVoxels[1]));
+        voxel.distribution.store(ComputeDistribution(pi),
+                                 std::memory_order_release);
+        ++nPrecomputed;
+    }, occupiedVoxels.size(), 8);
+
+    LOG(INFO) << "SpatialLightDistribution: precomputed " <<
+        occupiedVoxels.size() << " of " << nTotalVoxels << " voxels";
 }
 
 Distribution1D *
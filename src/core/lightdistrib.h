@@ -96,14 +96,27 @@ class PowerLightDistribution : public LightDistribution {
 // A spatially-varying light distribution that adjusts the probability of
 // sampling a light source based on an estimate of its contribution to a
 // region of space.  A fixed voxel grid is imposed over the scene bounds
-// and a sampling distribution is computed as needed for each voxel.
+// and a sampling distribution is computed as needed for each voxel, or
+// up front for all voxels that contain geometry with Precompute().
 class SpatialLightDistribution : public LightDistribution {
   public:
     SpatialLightDistribution(const Scene &scene, int maxVoxels = 64);
     ~SpatialLightDistribution();
     const Distribution1D *Lookup(const Point3f &p) const;
 
+    // Finds the voxels that contain geometry by tracing rays along the
+    // axes through the voxel grid and computes their distributions in
+    // parallel, so that lookups at surface points do not have to wait for
+    // other threads computing a distribution. Distributions of voxels that
+    // are missed are still computed on demand.
+    void Precompute();
+
   private:
+    Point3i VoxelCoordinates(const Point3f &p) const;
+    int VoxelIndex(const Point3i &pi) const {
+        return (pi[2] * nVoxels[1] + pi[1]) * nVoxels[0] + pi[0];
+    }
+
     // Compute the sampling distribution for the voxel with integer
     // coordiantes given by "pi".
     Distribution1D *ComputeDistribution(Point3i pi) const;
@@ -111,17 +124,15 @@ class SpatialLightDistribution : public LightDistribution {
     const Scene &scene;
     int nVoxels[3];
 
-    // The hash table is a fixed number of HashEntry structs (where we
-    // allocate more than enough entries in the SpatialLightDistribution
-    // constructor). During rendering, the table is allocated without
-    // locks, using atomic operations. (See the Lookup() method
+    // The voxels are stored in a flat array that is indexed by
+    // VoxelIndex(). During rendering, the distributions are computed
+    // without locks, using atomic operations. (See the Lookup() method
     // implementation for details.)
-    struct HashEntry {
-        std::atomic<uint64_t> packedPos;
+    struct Voxel {
         std::atomic<Distribution1D *> distribution;
+        std::atomic<bool> claimed;  // Distribution is being computed
     };
-    mutable std::unique_ptr<HashEntry[]> hashTable;
-    size_t hashTableSize;
+    mutable std::unique_ptr<Voxel[]> voxels;
 };
 
 }  // namespace pbrt
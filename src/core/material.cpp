@@ -48,8 +48,10 @@
 #include "stats.h"
 #include "spectrum.h"
 #include "reflection.h"
+#include "parallel.h"
 #include "statistics/lut.h"
-#include <bitset>
+#include <map>
+#include <mutex>
 
 namespace pbrt {
 
@@ -61,33 +63,29 @@ unsigned long long Material::GetId() const {
 }
 
 RGBSpectrum Material::GetAlbedo(SurfaceInteraction *si) const {
-    std::vector<std::vector<Float>> indices(3, std::vector<Float>(albedoLUTNDims));
+    LUTIndices indices;
+    GetLUTIndices(si, indices);
+
+    DCHECK(albedoLUT->values);
+    Float albedoRGB[3];
+    LookupTableRGB(*albedoLUT, indices, albedoRGB);
+
+    return RGBSpectrum::FromRGB(albedoRGB);
+}
 
+RGBSpectrum Material::GetAlbedoPerChannel(SurfaceInteraction *si) const {
+    LUTIndices indices;
     GetLUTIndices(si, indices);
 
-    const Float albedoRGB[3] = {
-        LookupTable(
-            &albedoLUT[albedoLUTRGBOffsets[0]],
-             albedoLUTNDims,
-             albedoLUTMaxIndices,
-             albedoLUTOffsets,
-            &indices[0][0]
-        ),
-        LookupTable(
-            &albedoLUT[albedoLUTRGBOffsets[1]],
-             albedoLUTNDims,
-             albedoLUTMaxIndices,
-             albedoLUTOffsets,
-            &indices[1][0]
-        ),
-        LookupTable(
-            &albedoLUT[albedoLUTRGBOffsets[2]],
-             albedoLUTNDims,
-             albedoLUTMaxIndices,
-             albedoLUTOffsets,
-            &indices[2][0]
-        )
-    };
+    Float albedoRGB[3];
+    for (unsigned char c = 0; c < 3; c++)
+        albedoRGB[c] = LookupTable(
+            albedoLUT->stride == 1 ? albedoLUT->values : albedoLUT->values + c,
+            albedoLUT->nDims,
+            albedoLUT->maxIndices,
+            albedoLUT->offsets,
+            indices[c]
+        );
 
     return RGBSpectrum::FromRGB(albedoRGB);
 }
@@ -131,144 +129,237 @@ void Material::Bump(const std::shared_ptr<Texture<Float>> &d,
                            false);
 }
 
-void Material::AllocateLUT(
-          Float          *source,
-    const unsigned char   sourceNDims,
-          unsigned char  *sourceMaxIndices,
-          unsigned int   *sourceOffsets,
-          Float         *&target,
-          unsigned char  &targetNDims,
-          unsigned char *&targetMaxIndices,
-          unsigned int  *&targetOffsets,
-          unsigned int  *&targetRGBOffsets
-) const {
-    ProfilePhase p(Prof::ReduceLUT);
+// ReducedLUT Declarations
+// A reduced LUT is fully determined by its source LUT, the reducible
+// dimensions, and the constant (per-channel) indices of these dimensions.
+class ReducedLUT {
+  public:
+    // ReducedLUT Public Methods
+    ReducedLUT(const LUT &source, const bool *reducibilities,
+               const LUTIndices &constants)
+        : source(source) {
+        for (unsigned char i = 0; i < source.nDims; i++)
+            this->reducibilities[i] = reducibilities[i];
+        for (unsigned char c = 0; c < 3; c++)
+            for (unsigned char i = 0; i < LUTMaxDims; i++)
+                this->constants[c][i] = constants[c][i];
+    }
+    void Reduce();
+
+    // ReducedLUT Public Data
+    LUT lut;
+
+  private:
+    // ReducedLUT Private Data
+    const LUT                  source;
+    bool                       reducibilities[LUTMaxDims] = {};
+    LUTIndices                 constants;
+    std::vector<Float>         values;
+    std::vector<unsigned char> maxIndices;
+    std::vector<unsigned int>  offsets;
+};
+
+struct ReducedLUTKey {
+    const Float *source;
+    std::vector<int> constants; // Quantized; -1 for non-reducible dimensions
+
+    bool operator<(const ReducedLUTKey &key) const {
+        return source < key.source ||
+               (source == key.source && constants < key.constants);
+    }
+};
 
-    // Initialize variables
-    targetNDims = sourceNDims;
+// Constant parameters closer than 1/LUTQuantization in LUT index space share
+// a reduced LUT.
+static PBRT_CONSTEXPR Float LUTQuantization = 1 << 20;
 
-    // Identify reducibilities
-    bool reducible = false;
-    bool reducibilities[sourceNDims];
+STAT_PERCENT("Materials/Shared reduced LUTs", nSharedReducedLUTs, nReducedLUTs);
+STAT_MEMORY_COUNTER("Memory/Reduced albedo LUTs", reducedLUTMemory);
+
+static std::mutex reducedLUTMutex;
+static std::map<ReducedLUTKey, std::weak_ptr<const ReducedLUT>> reducedLUTCache;
+static size_t reducedLUTCachePurgeSize = 64;
+static bool deferLUTReductions = false;
+static std::vector<std::shared_ptr<ReducedLUT>> deferredLUTReductions;
+
+// ReducedLUT Method Definitions
+void ReducedLUT::Reduce() {
+    ProfilePhase p(Prof::ReduceLUT);
+
+    // Calculate target LUT parameters
+    const unsigned char sourceNDims = source.nDims;
+    unsigned char targetNDims = 0;
     for (unsigned char i = 0; i < sourceNDims; i++)
-        reducibilities[i] = false;
-    GetLUTReducibilities(reducible, &reducibilities[0], targetNDims);
+        if (!reducibilities[i]) {
+            maxIndices.push_back(source.maxIndices[i]);
+            targetNDims++;
+        }
+    unsigned char targetIndices[LUTMaxDims];
+    unsigned char targetLengths[LUTMaxDims];
+    for (unsigned char i = 0; i < targetNDims; i++) {
+        targetIndices[i] = 0;
+        targetLengths[i] = maxIndices[i] + 1;
+    }
 
-    if (reducible) {
-        // Calculate target LUT parameters
-        targetMaxIndices = new unsigned char[targetNDims];
-        unsigned char targetIndices[targetNDims];
-        unsigned char targetLengths[targetNDims];
+    // Allocate memory for target LUT
+    // Reducing spectrum parameters requires storing each spectrum
+    // coefficient individually; we interleave them (padded to LUTRGBStride)
+    // so that lookups can interpolate all channels at once.
+    unsigned int length = 1;
+    for (unsigned char i = 0; i < targetNDims; i++)
+        length *= targetLengths[i];
+    values.resize(LUTRGBStride * length);
+    reducedLUTMemory += values.size() * sizeof(Float);
+
+    unsigned char targetDimIndex = 0;
+    LUTIndices sourceIndices;
+    for (unsigned char c = 0; c < 3; c++)
+        for (unsigned char i = 0; i < LUTMaxDims; i++)
+            sourceIndices[c][i] = constants[c][i];
+    while (true) {
+        // Assign source LUT value to target LUT value
         unsigned char offset = 0;
-        for (unsigned char i = 0; i < targetNDims; i++) {
-            if (reducibilities[i])
+        Float sourceIndex;
+        for (unsigned char i = 0; i < sourceNDims; i++) {
+            if (!reducibilities[i]) {
+                sourceIndex = (Float)targetIndices[i - offset] / maxIndices[i - offset];
+                sourceIndices[0][i] = sourceIndex;
+                sourceIndices[1][i] = sourceIndex;
+                sourceIndices[2][i] = sourceIndex;
+            } else
                 offset++;
-            targetIndices[i] = 0;
-            targetMaxIndices[i] = sourceMaxIndices[i + offset];
-            targetLengths[i] = targetMaxIndices[i] + 1;
         }
 
-        // Allocate memory for target LUT
-        unsigned int length = 1;
-        for (unsigned char i = 0; i < targetNDims; i++)
-            length *= targetLengths[i];
-        target = new Float[3 * length]; // number of spectrum coefficients
-
-        unsigned char targetDimIndex = 0;
-        std::vector<std::vector<Float>> sourceIndices(3, std::vector<Float>(sourceNDims));
-        while (true) {
-            // Assign source LUT value to target LUT value
-            offset = 0;
-            Float sourceIndex;
-            for (unsigned char i = 0; i < sourceNDims; i++) {
-                if (!reducibilities[i]) {
-                    sourceIndex = (Float)targetIndices[i - offset] / targetMaxIndices[i - offset];
-                    sourceIndices[0][i] = sourceIndex;
-                    sourceIndices[1][i] = sourceIndex;
-                    sourceIndices[2][i] = sourceIndex;
-                } else
-                    offset++;
-            }
-            GetLUTReductionIndices(sourceIndices);
-
-            // Reducing spectrum parameters requires storing each spectrum coefficient individually
-            unsigned int targetIndex = 0;
-            for (unsigned char c = 0; c < 3; c++) {
-                targetIndex = c;
-                for (char i = targetNDims - 1; i > -1; i--) {
-                    targetIndex *= targetLengths[i];
-                    targetIndex += targetIndices[i];
-                }
-                target[targetIndex] = LookupTable(
-                     source,
-                     sourceNDims,
-                     sourceMaxIndices,
-                     sourceOffsets,
-                    &sourceIndices[c][0]
-                );
-            }
-
-            // Increment indices
-            targetIndices[0]++;
-
-            while (targetIndices[targetDimIndex] == targetLengths[targetDimIndex]) {
-                if (targetDimIndex == targetNDims - 1)
-                    goto breakAll;
-                targetIndices[targetDimIndex++] = 0;
-                targetIndices[targetDimIndex]++;
-            }
-
-            targetDimIndex = 0;
+        unsigned int targetIndex = 0;
+        for (char i = targetNDims - 1; i > -1; i--) {
+            targetIndex *= targetLengths[i];
+            targetIndex += targetIndices[i];
+        }
+        targetIndex *= LUTRGBStride;
+        for (unsigned char c = 0; c < 3; c++)
+            values[targetIndex + c] = LookupTable(
+                 source.values,
+                 source.nDims,
+                 source.maxIndices,
+                 source.offsets,
+                 sourceIndices[c]
+            );
+
+        // Increment indices
+        targetIndices[0]++;
+
+        while (targetIndices[targetDimIndex] == targetLengths[targetDimIndex]) {
+            if (targetDimIndex == targetNDims - 1)
+                goto breakAll;
+            targetIndices[targetDimIndex++] = 0;
+            targetIndices[targetDimIndex]++;
         }
 
-        breakAll:
-
-        // Calculate offsets
-        const unsigned short targetOffsetCount = 1 << targetNDims;
-        targetOffsets = new unsigned int[targetOffsetCount];
-        for (unsigned short i = 0; i < targetOffsetCount; i++) {
-            targetOffsets[i] = 0;
-            std::bitset<6> bits(i);
-            unsigned int increment = 1;
-            for (unsigned char j = 0; j < targetNDims; j++) {
-                if (bits[j])
-                    targetOffsets[i] += increment;
-                increment *= targetLengths[j];
-            }
+        targetDimIndex = 0;
+    }
+
+    breakAll:
+
+    // Calculate offsets (including the stride)
+    const unsigned short targetOffsetCount = 1 << targetNDims;
+    offsets.resize(targetOffsetCount);
+    for (unsigned short i = 0; i < targetOffsetCount; i++) {
+        offsets[i] = 0;
+        unsigned int increment = LUTRGBStride;
+        for (unsigned char j = 0; j < targetNDims; j++) {
+            if ((i >> j) & 1)
+                offsets[i] += increment;
+            increment *= targetLengths[j];
         }
- 
-        targetRGBOffsets = new unsigned int[3];
-        for (unsigned char c = 0; c < 3; c++)
-            targetRGBOffsets[c] = c * length;
-    } else {
-        // LUT is not reducible: copy
-        target           = source;
-        targetNDims      = sourceNDims;
-        targetMaxIndices = sourceMaxIndices;
-        targetOffsets    = sourceOffsets;
-
-        targetRGBOffsets = new unsigned int[3];
-        for (unsigned char c = 0; c < 3; c++)
-            targetRGBOffsets[c] = 0;
     }
+
+    lut.values     = &values[0];
+    lut.nDims      = targetNDims;
+    lut.maxIndices = &maxIndices[0];
+    lut.offsets    = &offsets[0];
+    lut.stride     = LUTRGBStride;
 }
 
-void Material::DeallocateLUT(
-    const Float          *source,
-    const unsigned char  *sourceMaxIndices,
-    const unsigned int   *sourceOffsets,
-          Float         *&target,
-          unsigned char *&targetMaxIndices,
-          unsigned int  *&targetOffsets,
-          unsigned int  *&targetRGBOffsets
+void Material::AllocateLUT(
+    const LUT                          &source,
+    const LUT                         *&target,
+    std::shared_ptr<const ReducedLUT>  &reducedTarget
 ) const {
-    if (target != source)
-        delete[] target;
-    if (targetMaxIndices != sourceMaxIndices)
-        delete[] targetMaxIndices;
-    if (targetOffsets != sourceOffsets)
-        delete[] targetOffsets;
-    delete[] targetRGBOffsets;
+    // Identify reducibilities
+    bool reducible = false;
+    bool reducibilities[LUTMaxDims] = {};
+    unsigned char targetNDims = source.nDims;
+    GetLUTReducibilities(reducible, &reducibilities[0], targetNDims);
+
+    if (!reducible) {
+        // LUT is not reducible: point to the source LUT
+        target = &source;
+        reducedTarget.reset();
+        return;
+    }
+
+    // Get the constant indices of the reducible dimensions and quantize them
+    LUTIndices constants = {};
+    GetLUTReductionIndices(constants);
+    ReducedLUTKey key;
+    key.source = source.values;
+    for (unsigned char i = 0; i < source.nDims; i++)
+        for (unsigned char c = 0; c < 3; c++) {
+            if (reducibilities[i]) {
+                const int q = std::round(Clamp(constants[c][i], 0, 1) * LUTQuantization);
+                constants[c][i] = q / LUTQuantization;
+                key.constants.push_back(q);
+            } else
+                key.constants.push_back(-1);
+        }
+
+    // Share an existing reduced LUT or create a new one
+    std::lock_guard<std::mutex> lock(reducedLUTMutex);
+    ++nReducedLUTs;
+    std::shared_ptr<const ReducedLUT> reduced = reducedLUTCache[key].lock();
+    if (reduced)
+        ++nSharedReducedLUTs;
+    else {
+        std::shared_ptr<ReducedLUT> newReduced =
+            std::make_shared<ReducedLUT>(source, reducibilities, constants);
+        if (deferLUTReductions)
+            deferredLUTReductions.push_back(newReduced);
+        else
+            newReduced->Reduce();
+        reducedLUTCache[key] = newReduced;
+        reduced = newReduced;
+
+        // Remove entries of LUTs that are no longer used (amortized)
+        if (reducedLUTCache.size() >= reducedLUTCachePurgeSize) {
+            for (auto iter = reducedLUTCache.begin(); iter != reducedLUTCache.end();)
+                if (iter->second.expired())
+                    iter = reducedLUTCache.erase(iter);
+                else
+                    ++iter;
+            reducedLUTCachePurgeSize = 2 * std::max(reducedLUTCache.size(), (size_t)32);
+        }
+    }
+
+    target        = &reduced->lut;
+    reducedTarget = reduced;
+}
+
+void Material::DeferLUTReductions() {
+    std::lock_guard<std::mutex> lock(reducedLUTMutex);
+    deferLUTReductions = true;
+}
+
+void Material::ReduceDeferredLUTs() {
+    std::vector<std::shared_ptr<ReducedLUT>> reductions;
+    {
+        std::lock_guard<std::mutex> lock(reducedLUTMutex);
+        deferLUTReductions = false;
+        reductions.swap(deferredLUTReductions);
+    }
+
+    // Reduced LUTs are independent of each other
+    ParallelFor([&](int64_t i) { reductions[i]->Reduce(); },
+                reductions.size(), 1);
 }
 
 }  // namespace pbrt
@@ -52,9 +52,12 @@
 #include "pbrt.h"
 #include "memory.h"
 #include "spectrum.h"
+#include "statistics/lut.h"
 
 namespace pbrt {
 
+class ReducedLUT;
+
 // TransportMode Declarations
 enum class TransportMode { Radiance, Importance };
 
@@ -70,39 +73,32 @@ class Material {
     virtual ~Material();
     virtual unsigned long long GetId() const;
     virtual RGBSpectrum GetAlbedo(SurfaceInteraction *si) const;
+    // Reference for GetAlbedo() using one scalar lookup per channel (used by
+    // precomputealbedo for testing and benchmarking)
+    RGBSpectrum GetAlbedoPerChannel(SurfaceInteraction *si) const;
     static void Bump(const std::shared_ptr<Texture<Float>> &d,
                      SurfaceInteraction *si);
+    // Between these calls (i.e., during scene construction), LUT reductions
+    // of newly created materials are deferred and then performed in parallel
+    // by ReduceDeferredLUTs().
+    static void DeferLUTReductions();
+    static void ReduceDeferredLUTs();
 
   protected:
     // Material Protected Data
-    Float         *albedoLUT;
-    unsigned char  albedoLUTNDims;
-    unsigned char *albedoLUTMaxIndices;
-    unsigned int  *albedoLUTOffsets;
-    unsigned int  *albedoLUTRGBOffsets;
+    const LUT                         *albedoLUT = nullptr;
+    std::shared_ptr<const ReducedLUT>  reducedAlbedoLUT;
 
     // Material Protected Methods
     // These allocation methods intentionally do not access the members
     // directly for the possibility of using these for other LUTs in future.
+    // _source_ has to outlive the material. Reduced LUTs are shared between
+    // all materials with the same source LUT and (quantized) constant
+    // parameters; they are stored as interleaved RGB (stride LUTRGBStride).
     void AllocateLUT(
-              Float          *source,
-        const unsigned char   sourceNDims,
-              unsigned char  *sourceMaxIndices,
-              unsigned int   *sourceOffsets,
-              Float         *&target, // https://stackoverflow.com/a/37013270
-              unsigned char  &targetNDims,
-              unsigned char *&targetMaxIndices,
-              unsigned int  *&targetOffsets,
-              unsigned int  *&targetRGBOffsets
-    ) const;
-    void DeallocateLUT(
-        const Float          *source,
-        const unsigned char  *sourceMaxIndices,
-        const unsigned int   *sourceOffsets,
-              Float         *&target,
-              unsigned char *&targetMaxIndices,
-              unsigned int  *&targetOffsets,
-              unsigned int  *&targetRGBOffsets
+        const LUT                          &source,
+        const LUT                         *&target,
+        std::shared_ptr<const ReducedLUT>  &reducedTarget
     ) const;
 
   private:
@@ -134,13 +130,13 @@ class Material {
         LOG(FATAL) << "Material::GetLUTReducibilities() is not implemented!";
     };
     virtual void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const {
         LOG(FATAL) << "Material::GetLUTReductionIndices() is not implemented!";
     };
     virtual void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const {
         LOG(FATAL) << "Material::GetLUTIndices() is not implemented!";
     };
@@ -33,6 +33,20 @@
 
 // core/memory.cpp*
 #include "memory.h"
+#include "parallel.h"
+#ifdef PBRT_IS_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(PBRT_IS_LINUX) || defined(PBRT_IS_OSX)
+#include <sys/resource.h>
+#endif
+#ifdef PBRT_IS_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
 
 namespace pbrt {
 
@@ -58,4 +72,70 @@ void FreeAligned(void *ptr) {
 #endif
 }
 
+int FirstTouchThread(int row, int nRows) {
+    return nRows > 0 ? (int)((int64_t)row * MaxThreadIndex() / nRows) : 0;
+}
+
+void ParallelFirstTouch(void *ptr, size_t rowBytes, int nRows,
+                        bool hugePages) {
+    uint8_t *begin = (uint8_t *)ptr;
+    uint8_t *end = begin + rowBytes * nRows;
+#ifdef PBRT_IS_LINUX
+    // Release the pages that lie entirely within the buffer, so that they
+    // are placed anew on first touch below
+    const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uint8_t *pageBegin =
+        (uint8_t *)(((uintptr_t)begin + pageSize - 1) & ~(pageSize - 1));
+    uint8_t *pageEnd = (uint8_t *)((uintptr_t)end & ~(pageSize - 1));
+    if (pageBegin < pageEnd) {
+#ifdef MADV_HUGEPAGE
+        if (hugePages) madvise(pageBegin, pageEnd - pageBegin, MADV_HUGEPAGE);
+#endif
+        madvise(pageBegin, pageEnd - pageBegin, MADV_DONTNEED);
+    }
+#endif
+
+    // Zero each band of rows in the thread that FirstTouchThread() assigns
+    // it to
+    const int nThreads = MaxThreadIndex();
+    std::vector<int64_t> bands(nThreads);
+    std::vector<int> homeThreads(nThreads);
+    for (int b = 0; b < nThreads; ++b) bands[b] = homeThreads[b] = b;
+    ParallelForOrdered([&](int64_t b) {
+        // First row _r_ with FirstTouchThread(r, nRows) == b
+        int64_t r0 = (b * nRows + nThreads - 1) / nThreads;
+        int64_t r1 = ((b + 1) * nRows + nThreads - 1) / nThreads;
+        if (r0 < r1) memset(begin + r0 * rowBytes, 0, (r1 - r0) * rowBytes);
+    }, bands, &homeThreads);
+}
+
+bool GetNumaNodes(const void *const *addresses, int n, int *nodes) {
+#ifdef PBRT_IS_LINUX
+    // move_pages() without target nodes only queries the nodes
+    return syscall(SYS_move_pages, 0, (unsigned long)n, addresses, nullptr,
+                   nodes, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+size_t PeakResidentMemory() {
+#if defined(PBRT_IS_WINDOWS)
+    PROCESS_MEMORY_COUNTERS info;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info)))
+        return 0;
+    return (size_t)info.PeakWorkingSetSize;
+#elif defined(PBRT_IS_LINUX) || defined(PBRT_IS_OSX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef PBRT_IS_OSX
+    return (size_t)usage.ru_maxrss;  // Bytes
+#else
+    return (size_t)usage.ru_maxrss * 1024;  // Kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
 }  // namespace pbrt
@@ -54,6 +54,25 @@ T *AllocAligned(size_t count) {
 }
 
 void FreeAligned(void *);
+
+// NUMA placement (see --firsttouch and --hugepages; Linux only)
+// Returns the thread that places row _row_ of a row-major buffer with
+// _nRows_ rows in ParallelFirstTouch(); rows are split into contiguous bands,
+// one per thread.
+int FirstTouchThread(int row, int nRows);
+// Zeroes the row-major buffer at _ptr_ so that each band of rows is first
+// touched, and thereby placed on the NUMA node of, the thread given by
+// FirstTouchThread(). Pages that have already been touched are released
+// first. Optionally, transparent huge pages are requested for the buffer.
+// The previous contents are lost.
+void ParallelFirstTouch(void *ptr, size_t rowBytes, int nRows,
+                        bool hugePages);
+// Stores the NUMA node of the page at each of the _n_ _addresses_ in
+// _nodes_ (negative if unknown); returns false if not supported
+bool GetNumaNodes(const void *const *addresses, int n, int *nodes);
+// Returns the peak resident set size of the process in bytes, or 0 if
+// unknown
+size_t PeakResidentMemory();
 class
 #ifdef PBRT_HAVE_ALIGNAS
 alignas(PBRT_L1_CACHE_LINE_SIZE)
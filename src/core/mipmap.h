@@ -65,12 +65,18 @@ class MIPMap {
     // MIPMap Public Methods
     MIPMap(const Point2i &resolution, const T *data, bool doTri = false,
            Float maxAniso = 8.f, ImageWrap wrapMode = ImageWrap::Repeat);
+    MIPMap(const std::vector<Point2i> &levelResolutions, const T *levelData,
+           bool doTri, Float maxAniso, ImageWrap wrapMode);
     int Width() const { return resolution[0]; }
     int Height() const { return resolution[1]; }
     int Levels() const { return pyramid.size(); }
     const T &Texel(int level, int s, int t) const;
     T Lookup(const Point2f &st, Float width = 0.f) const;
     T Lookup(const Point2f &st, Vector2f dstdx, Vector2f dstdy) const;
+    // Returns the resolutions of the pyramid levels and appends their texels
+    // to _levelData_ (in linear order, finest level first); the second
+    // constructor recreates the _MIPMap_ from them (e.g., for the scene cache)
+    std::vector<Point2i> GetLevels(std::vector<T> *levelData) const;
 
   private:
     // MIPMap Private Methods
@@ -101,6 +107,7 @@ class MIPMap {
     }
     T triangle(int level, const Point2f &st) const;
     T EWA(int level, Point2f st, Vector2f dst0, Vector2f dst1) const;
+    static void initWeightLut();
 
     // MIPMap Private Data
     const bool doTrilinear;
@@ -206,15 +213,54 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
         }, tRes, 16);
     }
 
-    // Initialize EWA filter weights if needed
-    if (weightLut[0] == 0.) {
+    initWeightLut();
+    mipMapMemory += (4 * resolution[0] * resolution[1] * sizeof(T)) / 3;
+}
+
+template <typename T>
+MIPMap<T>::MIPMap(const std::vector<Point2i> &levelResolutions,
+                  const T *levelData, bool doTrilinear, Float maxAnisotropy,
+                  ImageWrap wrapMode)
+    : doTrilinear(doTrilinear),
+      maxAnisotropy(maxAnisotropy),
+      wrapMode(wrapMode),
+      resolution(levelResolutions[0]) {
+    pyramid.resize(levelResolutions.size());
+    for (size_t i = 0; i < levelResolutions.size(); ++i) {
+        const Point2i &res = levelResolutions[i];
+        pyramid[i].reset(new BlockedArray<T>(res.x, res.y, levelData));
+        levelData += res.x * res.y;
+    }
+    initWeightLut();
+    mipMapMemory += (4 * resolution[0] * resolution[1] * sizeof(T)) / 3;
+}
+
+template <typename T>
+std::vector<Point2i> MIPMap<T>::GetLevels(std::vector<T> *levelData) const {
+    std::vector<Point2i> levelResolutions;
+    for (const auto &level : pyramid) {
+        const Point2i res(level->uSize(), level->vSize());
+        levelResolutions.push_back(res);
+        size_t offset = levelData->size();
+        levelData->resize(offset + res.x * res.y);
+        level->GetLinearArray(&(*levelData)[offset]);
+    }
+    return levelResolutions;
+}
+
+template <typename T>
+void MIPMap<T>::initWeightLut() {
+    // Initialize EWA filter weights once; MIP maps may be created
+    // concurrently by asynchronous texture loads
+    static const bool initialized = []() {
         for (int i = 0; i < WeightLUTSize; ++i) {
             Float alpha = 2;
             Float r2 = Float(i) / Float(WeightLUTSize - 1);
             weightLut[i] = std::exp(-alpha * r2) - std::exp(-alpha);
         }
-    }
-    mipMapMemory += (4 * resolution[0] * resolution[1] * sizeof(T)) / 3;
+        return true;
+    }();
+    (void)initialized;
 }
 
 template <typename T>
@@ -35,9 +35,16 @@
 #include "parallel.h"
 #include "memory.h"
 #include "stats.h"
+#include <deque>
 #include <list>
 #include <thread>
 #include <condition_variable>
+#ifdef PBRT_IS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace pbrt {
 
@@ -47,6 +54,11 @@ static bool shutdownThreads = false;
 class ParallelForLoop;
 static ParallelForLoop *workList = nullptr;
 static std::mutex workListMutex;
+// Tasks of ParallelAsync(); protected by _workListMutex_
+static std::deque<std::function<void()>> asyncTasks;
+
+STAT_PERCENT("Parallel/Stolen work-stealing iterations", nStolenIterations,
+             nWorkStealingIterations);
 
 // Bookkeeping variables to help with the implementation of
 // MergeWorkerThreadStats().
@@ -58,6 +70,29 @@ static std::atomic<int> reporterCount;
 static std::condition_variable reportDoneCondition;
 static std::mutex reportDoneMutex;
 
+// Deque of loop iterations of a work-stealing loop; its front and back
+// indices into the loop's _items_ are packed into a single atomic, so that the
+// owner (taking from the front) and thieves (taking from the back) can claim
+// iterations with a single compare-and-swap.
+struct alignas(PBRT_L1_CACHE_LINE_SIZE) WorkStealingDeque {
+    std::atomic<uint64_t> range;
+
+    static uint64_t Pack(uint32_t front, uint32_t back) {
+        return ((uint64_t)back << 32) | front;
+    }
+    bool Pop(bool fromBack, uint32_t *item) {
+        uint64_t r = range.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t front = (uint32_t)r, back = (uint32_t)(r >> 32);
+            if (front >= back) return false;
+            *item = fromBack ? back - 1 : front;
+            uint64_t newRange =
+                fromBack ? Pack(front, back - 1) : Pack(front + 1, back);
+            if (range.compare_exchange_weak(r, newRange)) return true;
+        }
+    }
+};
+
 class ParallelForLoop {
   public:
     // ParallelForLoop Public Methods
@@ -75,11 +110,47 @@ class ParallelForLoop {
           profilerState(profilerState) {
         nX = count.x;
     }
+    ParallelForLoop(void (*funcStealing)(void *, int64_t), void *context,
+                    const std::vector<int64_t> &order,
+                    const std::vector<int> *homeThreads, int nDeques,
+                    uint64_t profilerState)
+        : funcStealing(funcStealing),
+          context(context),
+          maxIndex(order.size()),
+          chunkSize(1),
+          profilerState(profilerState),
+          items(order.size()),
+          deques(new WorkStealingDeque[nDeques]),
+          nDeques(nDeques) {
+        // Deal the iterations round-robin, so that every deque starts with
+        // one of the first (e.g., most expensive) iterations.
+        CHECK_LE(order.size(), (size_t)UINT32_MAX);
+        uint32_t offset = 0;
+        if (homeThreads) {
+            // Deal each iteration to its home thread, keeping the order
+            for (int d = 0; d < nDeques; ++d) {
+                uint32_t front = offset;
+                for (int64_t index : order)
+                    if ((*homeThreads)[index] % nDeques == d)
+                        items[offset++] = index;
+                deques[d].range = WorkStealingDeque::Pack(front, offset);
+            }
+            return;
+        }
+        for (int d = 0; d < nDeques; ++d) {
+            uint32_t front = offset;
+            for (size_t i = d; i < order.size(); i += nDeques)
+                items[offset++] = order[i];
+            deques[d].range = WorkStealingDeque::Pack(front, offset);
+        }
+    }
 
   public:
     // ParallelForLoop Private Data
     std::function<void(int64_t)> func1D;
     std::function<void(Point2i)> func2D;
+    void (*funcStealing)(void *, int64_t) = nullptr;
+    void *context = nullptr;
     const int64_t maxIndex;
     const int chunkSize;
     uint64_t profilerState;
@@ -87,13 +158,54 @@ class ParallelForLoop {
     int activeWorkers = 0;
     ParallelForLoop *next = nullptr;
     int nX = -1;
+    std::vector<int64_t> items;
+    std::unique_ptr<WorkStealingDeque[]> deques;
+    int nDeques = 0;
 
     // ParallelForLoop Private Methods
     bool Finished() const {
         return nextIndex >= maxIndex && activeWorkers == 0;
     }
+    bool IsWorkStealing() const { return funcStealing != nullptr; }
+    void RunWorkStealing(int threadIndex);
 };
 
+// Runs iterations of a work-stealing loop until all deques are empty; must be
+// called without holding _workListMutex_.
+void ParallelForLoop::RunWorkStealing(int threadIndex) {
+    int own = threadIndex % nDeques;
+    uint64_t oldState = ProfilerState;
+    ProfilerState = profilerState;
+    while (true) {
+        uint32_t item;
+        bool stolen = false;
+        if (!deques[own].Pop(false, &item)) {
+            stolen = true;
+            int d = 1;
+            for (; d < nDeques; ++d)
+                if (deques[(own + d) % nDeques].Pop(true, &item)) break;
+            if (d == nDeques) break;
+        }
+        ++nWorkStealingIterations;
+        if (stolen) ++nStolenIterations;
+        funcStealing(context, items[item]);
+    }
+    ProfilerState = oldState;
+}
+
+// Removes _loop_ from _workList_ once all of its iterations have been
+// claimed; _workListMutex_ must be held. Unlike for the other loops, _loop_
+// is not necessarily at the head of the list, as loops started within its
+// iterations are pushed on top of it.
+static void RemoveFromWorkList(ParallelForLoop &loop) {
+    loop.nextIndex = loop.maxIndex;
+    for (ParallelForLoop **l = &workList; *l; l = &(*l)->next)
+        if (*l == &loop) {
+            *l = loop.next;
+            break;
+        }
+}
+
 void Barrier::Wait() {
     std::unique_lock<std::mutex> lock(mutex);
     CHECK_GT(count, 0);
@@ -109,9 +221,44 @@ void Barrier::Wait() {
 
 static std::condition_variable workListCondition;
 
+// Pins the calling thread to the _threadIndex_-th CPU that the process may
+// run on (see --pinthreads), so that threads with adjacent indices share a
+// NUMA node on typical systems
+static void PinThread(int threadIndex) {
+#ifdef PBRT_IS_LINUX
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int nAllowed = CPU_COUNT(&allowed);
+    if (nAllowed == 0) return;
+    int n = threadIndex % nAllowed;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || n-- > 0) continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            LOG(WARNING) << "Couldn't pin thread " << threadIndex;
+        else
+            LOG(INFO) << "Pinned thread " << threadIndex << " to CPU " << cpu;
+        return;
+    }
+#else
+    if (threadIndex == 0) Warning("--pinthreads is only supported on Linux.");
+#endif
+}
+
+int CurrentNumaNode() {
+#ifdef PBRT_IS_LINUX
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+#endif
+    return -1;
+}
+
 static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
     LOG(INFO) << "Started execution in worker thread " << tIndex;
     ThreadIndex = tIndex;
+    if (PbrtOptions.pinThreads) PinThread(tIndex);
 
     // Give the profiler a chance to do per-thread initialization for
     // the worker thread before the profiling system actually stops running.
@@ -136,13 +283,31 @@ static void workerThreadFunc(int tIndex, std::shared_ptr<Barrier> barrier) {
                 reportDoneCondition.notify_one();
             // Now sleep again.
             workListCondition.wait(lock);
-        } else if (!workList) {
+        } else if (!workList && asyncTasks.empty()) {
             // Sleep until there are more tasks to run
             workListCondition.wait(lock);
+        } else if (!workList) {
+            // Run a task of ParallelAsync()
+            std::function<void()> task = std::move(asyncTasks.front());
+            asyncTasks.pop_front();
+            lock.unlock();
+            task();
+            lock.lock();
         } else {
             // Get work from _workList_ and run loop iterations
             ParallelForLoop &loop = *workList;
 
+            if (loop.IsWorkStealing()) {
+                loop.activeWorkers++;
+                lock.unlock();
+                loop.RunWorkStealing(tIndex);
+                lock.lock();
+                RemoveFromWorkList(loop);
+                loop.activeWorkers--;
+                if (loop.Finished()) workListCondition.notify_all();
+                continue;
+            }
+
             // Run a chunk of loop iterations for _loop_
 
             // Find the set of loop iterations to run next
@@ -238,6 +403,38 @@ void ParallelFor(std::function<void(int64_t)> func, int64_t count,
     }
 }
 
+void ParallelForWorkStealing(void (*func)(void *, int64_t), void *context,
+                             const std::vector<int64_t> &order,
+                             const std::vector<int> *homeThreads) {
+    CHECK(threads.size() > 0 || MaxThreadIndex() == 1);
+
+    if (threads.empty() || order.size() <= 1) {
+        for (int64_t index : order) func(context, index);
+        return;
+    }
+
+    ParallelForLoop loop(func, context, order, homeThreads, MaxThreadIndex(),
+                         CurrentProfilerState());
+    {
+        std::lock_guard<std::mutex> lock(workListMutex);
+        loop.next = workList;
+        workList = &loop;
+    }
+
+    std::unique_lock<std::mutex> lock(workListMutex);
+    workListCondition.notify_all();
+
+    // Help out with the loop iterations in the current thread and wait for
+    // the iterations still running in the worker threads
+    loop.activeWorkers++;
+    lock.unlock();
+    loop.RunWorkStealing(ThreadIndex);
+    lock.lock();
+    RemoveFromWorkList(loop);
+    loop.activeWorkers--;
+    workListCondition.wait(lock, [&loop]() { return loop.Finished(); });
+}
+
 PBRT_THREAD_LOCAL int ThreadIndex;
 
 int MaxThreadIndex() {
@@ -306,6 +503,7 @@ void ParallelInit() {
     CHECK_EQ(threads.size(), 0);
     int nThreads = MaxThreadIndex();
     ThreadIndex = 0;
+    if (PbrtOptions.pinThreads) PinThread(0);
 
     // Create a barrier so that we can be sure all worker threads get past
     // their call to ProfilerWorkerThreadInit() before we return from this
@@ -321,7 +519,39 @@ void ParallelInit() {
     barrier->Wait();
 }
 
+void EnqueueAsyncTask(std::function<void()> task) {
+    // Run the task with the profiler state of the caller
+    uint64_t profilerState = CurrentProfilerState();
+    std::function<void()> func = [task, profilerState]() {
+        uint64_t oldState = ProfilerState;
+        ProfilerState = profilerState;
+        task();
+        ProfilerState = oldState;
+    };
+    if (threads.empty()) {
+        func();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(workListMutex);
+    asyncTasks.push_back(std::move(func));
+    workListCondition.notify_one();
+}
+
+bool RunAsyncTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(workListMutex);
+        if (asyncTasks.empty()) return false;
+        task = std::move(asyncTasks.front());
+        asyncTasks.pop_front();
+    }
+    task();
+    return true;
+}
+
 void ParallelCleanup() {
+    while (RunAsyncTask())
+        ;
     if (threads.empty()) return;
 
     {
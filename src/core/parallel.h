@@ -44,7 +44,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <chrono>
+#include <future>
 #include <atomic>
+#include <type_traits>
+#include <vector>
 
 namespace pbrt {
 
@@ -102,8 +106,57 @@ void ParallelFor(std::function<void(int64_t)> func, int64_t count,
                  int chunkSize = 1);
 extern PBRT_THREAD_LOCAL int ThreadIndex;
 void ParallelFor2D(std::function<void(Point2i)> func, const Point2i &count);
+void ParallelForWorkStealing(void (*func)(void *, int64_t), void *context,
+                             const std::vector<int64_t> &order,
+                             const std::vector<int> *homeThreads = nullptr);
+
+// Calls _func_ for each index in _order_ in parallel, starting the
+// iterations approximately in the given order (e.g., most expensive first).
+// The iterations are dealt round-robin to per-thread deques; a thread takes
+// iterations from the front of its own deque and, once that is empty,
+// steals from the back of the others. Claiming an iteration does not take a
+// lock, and _func_ is called directly rather than through std::function.
+// If _homeThreads_ is given, iteration _i_ is instead dealt to the deque of
+// thread _(*homeThreads)[i]_ (e.g., the thread whose memory it accesses).
+template <typename Func>
+void ParallelForOrdered(Func &&func, const std::vector<int64_t> &order,
+                        const std::vector<int> *homeThreads = nullptr) {
+    typedef typename std::remove_reference<Func>::type F;
+    ParallelForWorkStealing(
+        [](void *context, int64_t index) { (*(F *)context)(index); },
+        (void *)&func, order, homeThreads);
+}
+
+// Runs _func_ asynchronously on an idle worker thread (or right away on the
+// calling thread if there are no worker threads) and returns a future for
+// its result. Loops of ParallelFor() take precedence over these tasks; _func_
+// may use ParallelFor() itself. Tasks that have not run by the time of
+// ParallelCleanup() are run by it.
+void EnqueueAsyncTask(std::function<void()> task);
+// Runs one queued task on the calling thread; returns false if there is none
+bool RunAsyncTask();
+template <typename Func>
+auto ParallelAsync(Func func) -> std::shared_future<decltype(func())> {
+    typedef decltype(func()) T;
+    auto task = std::make_shared<std::packaged_task<T()>>(std::move(func));
+    std::shared_future<T> future = task->get_future().share();
+    EnqueueAsyncTask([task]() { (*task)(); });
+    return future;
+}
+// Waits for the result of ParallelAsync(), helping with the queued tasks
+// in the meantime
+template <typename T>
+const T &ParallelWait(const std::shared_future<T> &future) {
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        if (!RunAsyncTask()) break;
+    return future.get();
+}
+
 int MaxThreadIndex();
 int NumSystemCores();
+// Returns the NUMA node of the CPU that the calling thread runs on, or -1 if
+// unknown (only supported on Linux)
+int CurrentNumaNode();
 
 void ParallelInit();
 void ParallelCleanup();
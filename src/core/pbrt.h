@@ -201,6 +201,17 @@ struct Options {
     int baseSeed = 0;
     bool denoise = false;
     bool warmUp = false;
+    std::string lutDir;
+    bool pinThreads = false;
+    bool firstTouch = false;
+    bool hugePages = false;
+    std::string traceFile;
+    std::string metricsFile;
+    std::string sceneCacheDir;
+    std::string serverSocket;
+    int residentScenes = 2;
+    bool compactMeshes = false;
+    bool compactUVs = false;
 };
 
 extern Options PbrtOptions;
@@ -73,6 +73,9 @@ class Sampler {
     const Point2f *Get2DArray(int n);
     virtual bool StartNextSample();
     virtual std::unique_ptr<Sampler> Clone(int seed) = 0;
+    // Puts the random state into that of Clone(seed), so that one sampler
+    // can be reused for several tiles; no-op for deterministic samplers
+    virtual void Reseed(int seed) {}
     virtual bool SetSampleNumber(int64_t sampleNum);
     virtual void SetSPP(int64_t samplesPerPixel); // HSTODO: Isn't implemented with RequestXDArray() in mind
     std::string StateString() const {
@@ -105,6 +108,7 @@ class PixelSampler : public Sampler {
     bool SetSampleNumber(int64_t);
     Float Get1D();
     Point2f Get2D();
+    void Reseed(int seed) { rng.SetSequence(seed); }
 
   protected:
     // PixelSampler Protected Data
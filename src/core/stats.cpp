@@ -90,6 +90,10 @@ void PrintStats(FILE *dest) { statsAccumulator.Print(dest); }
 
 void ClearStats() { statsAccumulator.Clear(); }
 
+int64_t GetStatsCounter(const std::string &name) {
+    return statsAccumulator.GetCounter(name);
+}
+
 static void getCategoryAndTitle(const std::string &str, std::string *category,
                                 std::string *title) {
     const char *s = str.c_str();
@@ -391,4 +395,90 @@ void ReportProfilerResults(FILE *dest) {
 #endif
 }
 
+// Timeline Tracing Definitions
+bool TracingEnabled = false;
+static PBRT_CONSTEXPR int64_t TraceBufferSize = 1 << 16;  // Events per thread
+static std::chrono::steady_clock::time_point traceStartTime;
+
+struct TraceEvent {
+    const char *name;
+    int64_t begin, end, arg;
+};
+
+struct TraceBuffer {
+    TraceBuffer(int threadIndex)
+        : events(TraceBufferSize), threadIndex(threadIndex) {}
+    std::vector<TraceEvent> events;
+    int64_t nEvents = 0;  // Including overwritten ones
+    int threadIndex;
+};
+
+// The buffers are owned here rather than by the threads, so that they
+// outlive the worker threads and can be written after ParallelCleanup().
+static std::mutex traceBuffersMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> traceBuffers;
+static PBRT_THREAD_LOCAL TraceBuffer *threadTraceBuffer;
+
+void InitTracing() {
+    TracingEnabled = !PbrtOptions.traceFile.empty();
+    traceStartTime = std::chrono::steady_clock::now();
+}
+
+int64_t TraceTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - traceStartTime)
+        .count();
+}
+
+void RecordTraceEvent(const char *name, int64_t begin, int64_t arg) {
+    int64_t end = TraceTimestamp();
+    if (!threadTraceBuffer) {
+        // Only the first event of each thread takes the lock
+        std::lock_guard<std::mutex> lock(traceBuffersMutex);
+        traceBuffers.emplace_back(new TraceBuffer(ThreadIndex));
+        threadTraceBuffer = traceBuffers.back().get();
+    }
+    TraceBuffer &buffer = *threadTraceBuffer;
+    buffer.events[buffer.nEvents++ % TraceBufferSize] = {name, begin, end, arg};
+}
+
+// Must only be called while no events are being recorded
+void WriteTrace(const std::string &filename) {
+    FILE *f = fopen(filename.c_str(), "w");
+    if (!f) {
+        Error("%s: unable to open trace file", filename.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(traceBuffersMutex);
+    int64_t nDropped = 0;
+    const char *sep = "";
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (size_t tid = 0; tid < traceBuffers.size(); ++tid) {
+        const TraceBuffer &buffer = *traceBuffers[tid];
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                   "\"tid\":%zu,\"args\":{\"name\":\"Thread %d\"}}",
+                sep, tid, buffer.threadIndex);
+        sep = ",\n";
+        int64_t first = std::max<int64_t>(0, buffer.nEvents - TraceBufferSize);
+        nDropped += first;
+        for (int64_t i = first; i < buffer.nEvents; ++i) {
+            const TraceEvent &e = buffer.events[i % TraceBufferSize];
+            // Chrome trace timestamps are in microseconds
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,"
+                       "\"ts\":%.3f,\"dur\":%.3f",
+                    sep, e.name, tid, e.begin / 1000., (e.end - e.begin) / 1000.);
+            if (e.arg >= 0) fprintf(f, ",\"args\":{\"index\":%" PRId64 "}", e.arg);
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    if (nDropped > 0)
+        Warning("%" PRId64 " trace events were overwritten; the trace only "
+                "contains the most recent %" PRId64 " events per thread.",
+                nDropped, TraceBufferSize);
+}
+
 }  // namespace pbrt
@@ -81,6 +81,9 @@ class StatRegisterer {
 void PrintStats(FILE *dest);
 void ClearStats();
 void ReportThreadStats();
+// Returns the accumulated value of the counter with the given title (only
+// includes the values reported so far, see ReportThreadStats())
+int64_t GetStatsCounter(const std::string &name);
 
 class StatsAccumulator {
   public:
@@ -88,6 +91,10 @@ class StatsAccumulator {
     void ReportCounter(const std::string &name, int64_t val) {
         counters[name] += val;
     }
+    int64_t GetCounter(const std::string &name) const {
+        auto iter = counters.find(name);
+        return iter != counters.end() ? iter->second : 0;
+    }
     void ReportMemoryCounter(const std::string &name, int64_t val) {
         memoryCounters[name] += val;
     }
@@ -299,6 +306,40 @@ void ReportProfilerResults(FILE *dest);
 void ClearProfiler();
 void CleanupProfiler();
 
+// Timeline Tracing Declarations
+// Opt-in (--tracefile) recording of timed events, e.g., per tile or per
+// rendering phase, for diagnosing load imbalance and serialization points.
+// Each thread records into its own ring buffer without locking (the oldest
+// events are overwritten once it is full); WriteTrace() dumps all buffers
+// as Chrome trace JSON, which can be viewed in chrome://tracing or Perfetto.
+extern bool TracingEnabled;
+int64_t TraceTimestamp();
+void RecordTraceEvent(const char *name, int64_t begin, int64_t arg);
+
+class TraceScope {
+  public:
+    // TraceScope Public Methods
+    // _name_ must outlive the trace (e.g., a string literal); _arg_ is
+    // recorded if it is nonnegative (e.g., a tile index).
+    TraceScope(const char *name, int64_t arg = -1)
+        : name(TracingEnabled ? name : nullptr), arg(arg) {
+        if (this->name) begin = TraceTimestamp();
+    }
+    ~TraceScope() {
+        if (name) RecordTraceEvent(name, begin, arg);
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    // TraceScope Private Data
+    const char *name;
+    int64_t arg, begin;
+};
+
+void InitTracing();
+void WriteTrace(const std::string &filename);
+
 // Statistics Macros
 #define STAT_COUNTER(title, var)                           \
     static PBRT_THREAD_LOCAL int64_t var;                  \
@@ -14,6 +14,8 @@
 
 #include <pbrt/util/parallel.h>
 
+#include "core/parallel.h"
+
 #include <pbrt/util/check.h>
 #include <pbrt/util/print.h>
 #ifdef PBRT_BUILD_GPU_RENDERER
@@ -298,13 +300,25 @@ void ParallelForLoop2D::RunStep(std::unique_lock<std::mutex> *lock) {
 }
 
 // Parallel Function Definitions
+// Unless a pbrt-v4 _ThreadPool_ has been created with ParallelInit(), the
+// loops are run by pbrt-v3's scheduler (core/parallel.h), so that image
+// processing shares the rendering threads (and --nthreads) instead of
+// oversubscribing the cores with a second pool.
 void ParallelFor(int64_t start, int64_t end, std::function<void(int64_t, int64_t)> func) {
-    PBRT_V4_CHECK(ParallelJob::threadPool);
     if (start == end)
         return;
     // Compute chunk size for parallel loop
     int64_t chunkSize = std::max<int64_t>(1, (end - start) / (8 * RunningThreads()));
 
+    if (!ParallelJob::threadPool) {
+        int64_t nChunks = (end - start + chunkSize - 1) / chunkSize;
+        pbrt::ParallelFor([&](int64_t chunk) {
+            int64_t indexStart = start + chunk * chunkSize;
+            func(indexStart, std::min(indexStart + chunkSize, end));
+        }, nChunks);
+        return;
+    }
+
     // Create and enqueue _ParallelForLoop1D_ for this loop
     ParallelForLoop1D loop(start, end, chunkSize, std::move(func));
     std::unique_lock<std::mutex> lock = ParallelJob::threadPool->AddToJobList(&loop);
@@ -315,8 +329,6 @@ void ParallelFor(int64_t start, int64_t end, std::function<void(int64_t, int64_t
 }
 
 void ParallelFor2D(const Bounds2i &extent, std::function<void(Bounds2i)> func) {
-    PBRT_V4_CHECK(ParallelJob::threadPool);
-
     if (extent.IsEmpty())
         return;
     if (extent.Area() == 1) {
@@ -331,6 +343,17 @@ void ParallelFor2D(const Bounds2i &extent, std::function<void(Bounds2i)> func) {
                                        (8 * RunningThreads()))),
                          1, 32);
 
+    if (!ParallelJob::threadPool) {
+        Vector2i nTiles((extent.Diagonal().x + tileSize - 1) / tileSize,
+                        (extent.Diagonal().y + tileSize - 1) / tileSize);
+        pbrt::ParallelFor([&](int64_t tile) {
+            Point2i start = extent.pMin + Vector2i(int(tile % nTiles.x) * tileSize,
+                                                   int(tile / nTiles.x) * tileSize);
+            func(Intersect(Bounds2i(start, start + Vector2i(tileSize, tileSize)), extent));
+        }, int64_t(nTiles.x) * nTiles.y);
+        return;
+    }
+
     ParallelForLoop2D loop(extent, tileSize, std::move(func));
     std::unique_lock<std::mutex> lock = ParallelJob::threadPool->AddToJobList(&loop);
 
@@ -346,7 +369,8 @@ int AvailableCores() {
 }
 
 int RunningThreads() {
-    return ParallelJob::threadPool ? (1 + ParallelJob::threadPool->size()) : 1;
+    return ParallelJob::threadPool ? (1 + ParallelJob::threadPool->size())
+                                   : pbrt::MaxThreadIndex();
 }
 
 void ParallelInit(int nThreads) {
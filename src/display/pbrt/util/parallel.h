@@ -445,7 +445,7 @@ inline auto RunAsync(F func, Args &&...args) {
 
     // Enqueue _job_ or run it immediately
     std::unique_lock<std::mutex> lock;
-    if (RunningThreads() == 1)
+    if (!ParallelJob::threadPool)
         job->DoWork();
     else
         lock = ParallelJob::threadPool->AddToJobList(job);
@@ -36,6 +36,7 @@
 #include "sampling.h"
 #include "shapes/triangle.h"
 #include "stats.h"
+#include "statistics/lightbvh.h"
 
 namespace pbrt {
 
@@ -65,6 +66,22 @@ Spectrum DiffuseAreaLight::Power() const {
     return (twoSided ? 2 : 1) * Lemit * area * Pi;
 }
 
+bool DiffuseAreaLight::GetBounds(LightBounds *lightBounds) const {
+    // Triangles emit around their (oriented) normal; bound other shapes
+    // with the entire sphere of directions
+    Vector3f w(0, 0, 1);
+    Float cosTheta_o = -1;
+    if (dynamic_cast<const Triangle *>(shape.get())) {
+        Float pdf;
+        w = Vector3f(shape->Sample(Point2f(.5f, .5f), &pdf).n);
+        cosTheta_o = 1;
+    }
+    *lightBounds = LightBounds(shape->WorldBound(), w,
+                               Power().MaxComponentValue(), cosTheta_o,
+                               std::cos(Pi / 2), twoSided);
+    return true;
+}
+
 Spectrum DiffuseAreaLight::Sample_Li(const Interaction &ref, const Point2f &u,
                                      Vector3f *wi, Float *pdf,
                                      VisibilityTester *vis) const {
@@ -65,6 +65,7 @@ class DiffuseAreaLight : public AreaLight {
                        Float *pdfDir) const;
     void Pdf_Le(const Ray &, const Normal3f &, Float *pdfPos,
                 Float *pdfDir) const;
+    bool GetBounds(LightBounds *lightBounds) const;
 
   protected:
     // DiffuseAreaLight Protected Data
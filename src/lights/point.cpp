@@ -37,6 +37,7 @@
 #include "paramset.h"
 #include "sampling.h"
 #include "stats.h"
+#include "statistics/lightbvh.h"
 
 namespace pbrt {
 
@@ -54,6 +55,13 @@ Spectrum PointLight::Sample_Li(const Interaction &ref, const Point2f &u,
 
 Spectrum PointLight::Power() const { return 4 * Pi * I; }
 
+bool PointLight::GetBounds(LightBounds *lightBounds) const {
+    *lightBounds = LightBounds(Bounds3f(pLight), Vector3f(0, 0, 1),
+                               4 * Pi * I.MaxComponentValue(), std::cos(Pi),
+                               std::cos(Pi / 2), false);
+    return true;
+}
+
 Float PointLight::Pdf_Li(const Interaction &, const Vector3f &) const {
     return 0;
 }
@@ -37,6 +37,7 @@
 #include "sampling.h"
 #include "reflection.h"
 #include "stats.h"
+#include "statistics/lightbvh.h"
 
 namespace pbrt {
 
@@ -76,6 +77,17 @@ Spectrum SpotLight::Power() const {
     return I * 2 * Pi * (1 - .5f * (cosFalloffStart + cosTotalWidth));
 }
 
+bool SpotLight::GetBounds(LightBounds *lightBounds) const {
+    // The spot light emits around its axis at full intensity up to the
+    // falloff start and then falls off until the total width
+    Float phi = 4 * Pi * I.MaxComponentValue();
+    Float cosTheta_e =
+        std::cos(std::acos(cosTotalWidth) - std::acos(cosFalloffStart));
+    *lightBounds = LightBounds(Bounds3f(pLight), LightToWorld(Vector3f(0, 0, 1)),
+                               phi, cosFalloffStart, cosTheta_e, false);
+    return true;
+}
+
 Float SpotLight::Pdf_Li(const Interaction &, const Vector3f &) const {
     return 0.f;
 }
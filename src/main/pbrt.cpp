@@ -47,6 +47,13 @@
 #include "parser.h"
 #include "parallel.h"
 #include <glog/logging.h>
+#include <chrono>
+#include <signal.h>
+#ifndef PBRT_IS_WINDOWS
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 #include "pbrt/util/display.h"
 
@@ -74,6 +81,37 @@ Rendering options:
                            passes without rerendering).
   --warmup                 Perform a warm-up iteration (useful for consistent
                            performance measurements).
+  --lutdir <dir>           Load albedo LUT files (<material>albedo.lut) from the
+                           specified directory instead of using the compiled-in
+                           LUTs.
+  --pinthreads             Pin each rendering thread to its own CPU (Linux only).
+  --firsttouch             Place film and statistics buffers on the NUMA nodes
+                           of the threads that render the corresponding image
+                           rows and prefer these threads for the tiles (Linux
+                           only; best combined with --pinthreads).
+  --hugepages              Request transparent huge pages for film and
+                           statistics buffers (Linux only).
+  --tracefile <filename>   Record a timeline of rendering phases and tiles per
+                           thread and write it to the given file in Chrome
+                           trace format (viewable in chrome://tracing or
+                           Perfetto).
+  --metricsfile <filename> Write per-iteration metrics (timings, throughput,
+                           memory, and relative standard error) to the given
+                           file as JSON Lines, or as CSV if it ends in ".csv".
+  --scenecache <dir>       Cache parsed PLY meshes, MIP maps and BVHs in the
+                           specified directory and reuse them in later runs.
+  --server <socket>        Run as render server: accept jobs on the specified
+                           Unix domain socket (or on standard input if "-")
+                           and keep the scenes of the last jobs resident (see
+                           scripts/_render-client.py). Syntax errors in a
+                           scene file or in the directives of a job terminate
+                           the server.
+  --residentscenes <num>   Keep at most the specified number of scenes
+                           resident in server mode. Default: 2.
+  --compactmeshes          Store triangle mesh normals as 32-bit octahedral
+                           encodings (lossy).
+  --compactuvs             Store triangle mesh UVs as 16-bit fixed-point
+                           values within their bounds (lossy).
 
 Logging options:
   --logdir <dir>       Specify directory that log files should be written to.
@@ -93,6 +131,113 @@ Reformatting options:
     exit(msg ? 1 : 0);
 }
 
+// Render Server
+// Jobs are sent as lines of text, each answered by a line starting with "ok"
+// or "error":
+//   render <filename.pbrt> [<directives>]  Render the scene; the directives
+//                                          (e.g., Integrator, Sampler, Film)
+//                                          override those of the scene.
+//   clear                                  Drop all resident scenes.
+//   quit                                   Stop the server.
+// Syntax errors in the scene file or the directives exit the process like in
+// regular runs, so jobs should be validated (e.g., by running pbrt --cat).
+static bool ReadLine(FILE *f, std::string *line) {
+    line->clear();
+    int c;
+    while ((c = fgetc(f)) != EOF && c != '\n') line->push_back(c);
+    return c != EOF || !line->empty();
+}
+
+// Processes the jobs read from _in_; returns true if the server is to stop
+static bool ServeJobs(FILE *in, FILE *out) {
+    std::string line;
+    while (ReadLine(in, &line)) {
+        // Split off command and scene filename (which may be quoted)
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+        size_t end = line.find_first_of(" \t\r", start);
+        const std::string command = line.substr(start, end - start);
+        std::string filename, directives;
+        start = end == std::string::npos ? end : line.find_first_not_of(" \t\r", end);
+        if (start != std::string::npos) {
+            if (line[start] == '"') {
+                end = line.find('"', start + 1);
+                filename = line.substr(start + 1, end - start - 1);
+                if (end != std::string::npos) ++end;
+            } else {
+                end = line.find_first_of(" \t\r", start);
+                filename = line.substr(start, end - start);
+            }
+            if (end != std::string::npos) directives = line.substr(end);
+        }
+
+        if (command == "render" && !filename.empty()) {
+            auto startTime = std::chrono::steady_clock::now();
+            bool rendered = pbrtRenderJob(filename, directives);
+            double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - startTime).count();
+            fprintf(out, "%s %.3f\n", rendered ? "ok" : "error", seconds);
+        } else if (command == "clear") {
+            pbrtClearResidentScenes();
+            fprintf(out, "ok\n");
+        } else if (command == "quit") {
+            fprintf(out, "ok\n");
+            fflush(out);
+            return true;
+        } else
+            fprintf(out, "error unknown command \"%s\"\n", line.c_str());
+        fflush(out);
+    }
+    return false;
+}
+
+static void RunServer(const std::string &socketName) {
+    if (socketName == "-") {
+        ServeJobs(stdin, stdout);
+        return;
+    }
+#ifdef PBRT_IS_WINDOWS
+    Error("--server only supports standard input (\"-\") on Windows.");
+#else
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socketName.size() >= sizeof(addr.sun_path)) {
+        Error("%s: socket name too long", socketName.c_str());
+        return;
+    }
+    strcpy(addr.sun_path, socketName.c_str());
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketName.c_str());
+    if (listenFd == -1 || bind(listenFd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, 4) != 0) {
+        Error("%s: %s", socketName.c_str(), strerror(errno));
+        if (listenFd != -1) close(listenFd);
+        return;
+    }
+    // Clients that disconnect early must not terminate the server
+    signal(SIGPIPE, SIG_IGN);
+    if (!PbrtOptions.quiet)
+        printf("Render server listening on %s\n", socketName.c_str());
+
+    // Serve one client at a time; jobs are rendered back to back
+    bool quit = false;
+    while (!quit) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            Error("accept: %s", strerror(errno));
+            break;
+        }
+        FILE *in = fdopen(fd, "r"), *out = fdopen(dup(fd), "w");
+        if (in && out) quit = ServeJobs(in, out);
+        if (out) fclose(out);
+        if (in) fclose(in);
+    }
+    close(listenFd);
+    unlink(socketName.c_str());
+#endif  // PBRT_IS_WINDOWS
+}
+
 // main program
 int main(int argc, char *argv[]) {
     google::InitGoogleLogging(argv[0]);
@@ -170,6 +315,54 @@ int main(int argc, char *argv[]) {
             options.denoise = true;
         } else if (!strcmp(argv[i], "--warmup") || !strcmp(argv[i], "-warmup")) {
             options.warmUp = true;
+        } else if (!strcmp(argv[i], "--lutdir") || !strcmp(argv[i], "-lutdir")) {
+            if (i + 1 == argc)
+                usage("missing value after --lutdir argument");
+            options.lutDir = argv[++i];
+        } else if (!strncmp(argv[i], "--lutdir=", 9)) {
+            options.lutDir = &argv[i][9];
+        } else if (!strcmp(argv[i], "--pinthreads") || !strcmp(argv[i], "-pinthreads")) {
+            options.pinThreads = true;
+        } else if (!strcmp(argv[i], "--firsttouch") || !strcmp(argv[i], "-firsttouch")) {
+            options.firstTouch = true;
+        } else if (!strcmp(argv[i], "--hugepages") || !strcmp(argv[i], "-hugepages")) {
+            options.hugePages = true;
+        } else if (!strcmp(argv[i], "--tracefile") || !strcmp(argv[i], "-tracefile")) {
+            if (i + 1 == argc)
+                usage("missing value after --tracefile argument");
+            options.traceFile = argv[++i];
+        } else if (!strncmp(argv[i], "--tracefile=", 12)) {
+            options.traceFile = &argv[i][12];
+        } else if (!strcmp(argv[i], "--metricsfile") || !strcmp(argv[i], "-metricsfile")) {
+            if (i + 1 == argc)
+                usage("missing value after --metricsfile argument");
+            options.metricsFile = argv[++i];
+        } else if (!strncmp(argv[i], "--metricsfile=", 14)) {
+            options.metricsFile = &argv[i][14];
+        } else if (!strcmp(argv[i], "--scenecache") || !strcmp(argv[i], "-scenecache")) {
+            if (i + 1 == argc)
+                usage("missing value after --scenecache argument");
+            options.sceneCacheDir = argv[++i];
+        } else if (!strncmp(argv[i], "--scenecache=", 13)) {
+            options.sceneCacheDir = &argv[i][13];
+        } else if (!strcmp(argv[i], "--server") || !strcmp(argv[i], "-server")) {
+            if (i + 1 == argc)
+                usage("missing value after --server argument");
+            options.serverSocket = argv[++i];
+        } else if (!strncmp(argv[i], "--server=", 9)) {
+            options.serverSocket = &argv[i][9];
+        } else if (!strcmp(argv[i], "--residentscenes") ||
+                   !strcmp(argv[i], "-residentscenes")) {
+            if (i + 1 == argc)
+                usage("missing value after --residentscenes argument");
+            options.residentScenes = atoi(argv[++i]);
+        } else if (!strncmp(argv[i], "--residentscenes=", 17)) {
+            options.residentScenes = atoi(&argv[i][17]);
+        } else if (!strcmp(argv[i], "--compactmeshes") ||
+                   !strcmp(argv[i], "-compactmeshes")) {
+            options.compactMeshes = true;
+        } else if (!strcmp(argv[i], "--compactuvs") || !strcmp(argv[i], "-compactuvs")) {
+            options.compactUVs = true;
         } else
             filenames.push_back(argv[i]);
     }
@@ -205,7 +398,11 @@ int main(int argc, char *argv[]) {
     if (options.displayImages)
         pbrtv4::ConnectToDisplayServer(options.displayServer);
     // Process scene description
-    if (filenames.empty()) {
+    if (!options.serverSocket.empty()) {
+        if (!filenames.empty())
+            Warning("Ignoring scene files in server mode; send them as jobs.");
+        RunServer(options.serverSocket);
+    } else if (filenames.empty()) {
         // Parse scene from standard input
         pbrtParseFile("-");
     } else {
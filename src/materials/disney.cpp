@@ -597,7 +597,26 @@ void DisneyMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
 }
 
 RGBSpectrum DisneyMaterial::GetAlbedo(SurfaceInteraction *si) const {
-    return si->bsdf->rho(si->wo);
+    // The parameters that ComputeScatteringFunctions() depends on
+    Float rgb[3];
+    Spectrum(color->Evaluate(*si).Clamp()).ToRGB(rgb);
+    const Float params[] = {
+        rgb[0], rgb[1], rgb[2],
+        metallic->Evaluate(*si),
+        eta->Evaluate(*si),
+        specTrans->Evaluate(*si),
+        diffTrans->Evaluate(*si),
+        roughness->Evaluate(*si),
+        sheen->Evaluate(*si),
+        sheenTint->Evaluate(*si),
+        thin ? flatness->Evaluate(*si)
+             : (Float)scatterDistance->Evaluate(*si).IsBlack(),
+        anisotropic->Evaluate(*si),
+        specularTint->Evaluate(*si),
+        clearcoat->Evaluate(*si),
+        clearcoatGloss->Evaluate(*si)
+    };
+    return albedoCache.Lookup(*si, params, sizeof(params) / sizeof(Float));
 };
 
 DisneyMaterial *CreateDisneyMaterial(const TextureParams &mp,
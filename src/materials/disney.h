@@ -52,6 +52,7 @@
 #include "material.h"
 #include "pbrt.h"
 #include "spectrum.h"
+#include "statistics/albedocache.h"
 
 namespace pbrt {
 
@@ -108,6 +109,7 @@ class DisneyMaterial : public Material {
     std::shared_ptr<Texture<Spectrum>> scatterDistance;
     bool thin;
     std::shared_ptr<Texture<Float>> flatness, diffTrans, bumpMap;
+    AlbedoCache albedoCache;
 };
 
 DisneyMaterial *CreateDisneyMaterial(const TextureParams &mp,
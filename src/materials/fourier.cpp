@@ -234,7 +234,8 @@ void FourierMaterial::ComputeScatteringFunctions(
 }
 
 RGBSpectrum FourierMaterial::GetAlbedo(SurfaceInteraction *si) const {
-    return si->bsdf->rho(si->wo);
+    // The (isotropic) measured BSDF only depends on the outgoing direction.
+    return albedoCache.Lookup(*si, nullptr, 0);
 };
 
 FourierMaterial *CreateFourierMaterial(const TextureParams &mp,
@@ -54,6 +54,7 @@
 #include "reflection.h"
 #include "interpolation.h"
 #include "spectrum.h"
+#include "statistics/albedocache.h"
 #include <map>
 
 namespace pbrt {
@@ -74,6 +75,7 @@ class FourierMaterial : public Material {
     // FourierMaterial Private Data
     FourierBSDFTable *bsdfTable;
     std::shared_ptr<Texture<Float>> bumpMap;
+    AlbedoCache albedoCache;
     static std::map<std::string, std::unique_ptr<FourierBSDFTable>> loadedBSDFs;
 };
 
@@ -48,6 +48,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/glassalbedo.h"
 
 namespace pbrt {
@@ -72,27 +73,9 @@ GlassMaterial::GlassMaterial(
     remapRoughness(remapRoughness)
 {
     AllocateLUT(
-        &glassAlbedoLUT[0],
-         glassAlbedoLUTNDims,
-        &glassAlbedoLUTMaxIndices[0],
-        &glassAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-GlassMaterial::~GlassMaterial() {
-    DeallocateLUT(
-        &glassAlbedoLUT[0],
-        &glassAlbedoLUTMaxIndices[0],
-        &glassAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("glass", 6, ALBEDO_LUT_FALLBACK(glass)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -173,7 +156,7 @@ void GlassMaterial::GetLUTReducibilities(
 // Moreover, this one does not require a surface interaction, whereas the other one does.
 // Lastly, the index calculation is handled differently (source vs. target LUT indices).
 void GlassMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (Kr->IsConstant()) {
         const RGBSpectrum krMapped = Kr->Evaluate().Clamp(0.f, 1.f);
@@ -205,7 +188,7 @@ void GlassMaterial::GetLUTReductionIndices(
 
 void GlassMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
@@ -67,7 +67,6 @@ class GlassMaterial : public Material {
                   const std::shared_ptr<Texture<Float>> &bumpMap,
                   bool remapRoughness,
                   const unsigned long long id = 0);
-    ~GlassMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -87,11 +86,11 @@ class GlassMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
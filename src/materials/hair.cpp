@@ -51,6 +51,7 @@
 #include "spectrum.h"
 #include "texture.h"
 #include "textures/constant.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/hairalbedo.h"
 
 namespace pbrt {
@@ -169,27 +170,9 @@ HairMaterial::HairMaterial(
     alpha(alpha)
 {
     AllocateLUT(
-        &hairAlbedoLUT[0],
-         hairAlbedoLUTNDims,
-        &hairAlbedoLUTMaxIndices[0],
-        &hairAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-HairMaterial::~HairMaterial() {
-    DeallocateLUT(
-        &hairAlbedoLUT[0],
-        &hairAlbedoLUTMaxIndices[0],
-        &hairAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("hair", 4, ALBEDO_LUT_FALLBACK(hair)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -242,7 +225,7 @@ void HairMaterial::GetLUTReducibilities(
 }
 
 void HairMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if ((sigma_a && sigma_a->IsConstant()) ||
         (!sigma_a && color && color->IsConstant()) ||
@@ -277,7 +260,7 @@ void HairMaterial::GetLUTReductionIndices(
 
 void HairMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
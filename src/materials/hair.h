@@ -77,7 +77,6 @@ class HairMaterial : public Material {
                  const std::shared_ptr<Texture<Float>> &beta_n,
                  const std::shared_ptr<Texture<Float>> &alpha,
                  const unsigned long long id = 0);
-    ~HairMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -95,11 +94,11 @@ class HairMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 
     RGBSpectrum GetAlbedo(SurfaceInteraction *si) const;
@@ -54,6 +54,7 @@
 #include "material.h"
 #include "bssrdf.h"
 #include "spectrum.h"
+#include "statistics/albedocache.h"
 
 namespace pbrt {
 
@@ -100,6 +101,7 @@ class KdSubsurfaceMaterial : public Material {
     Float eta;
     bool remapRoughness;
     BSSRDFTable table;
+    AlbedoCache albedoCache;
 };
 
 KdSubsurfaceMaterial *CreateKdSubsurfaceMaterial(const TextureParams &mp,
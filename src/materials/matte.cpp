@@ -48,6 +48,7 @@
 #include "interaction.h"
 #include "texture.h"
 #include "spectrum.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/mattealbedo.h"
 
 namespace pbrt {
@@ -64,27 +65,9 @@ MatteMaterial::MatteMaterial(
     bumpMap(bumpMap)
 {
     AllocateLUT(
-        &matteAlbedoLUT[0],
-         matteAlbedoLUTNDims,
-        &matteAlbedoLUTMaxIndices[0],
-        &matteAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-MatteMaterial::~MatteMaterial() {
-    DeallocateLUT(
-        &matteAlbedoLUT[0],
-        &matteAlbedoLUTMaxIndices[0],
-        &matteAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("matte", 2, ALBEDO_LUT_FALLBACK(matte)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -124,7 +107,7 @@ void MatteMaterial::GetLUTReducibilities(
 }
 
 void MatteMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (sigma->IsConstant()) {
         const Float sigmaMapped = Clamp(InverseLerp(sigma->Evaluate(), 0.f, 90.f), 0.f, 1.f);
@@ -134,7 +117,7 @@ void MatteMaterial::GetLUTReductionIndices(
 
 void MatteMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
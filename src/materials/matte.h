@@ -63,7 +63,6 @@ class MatteMaterial : public Material {
                   const std::shared_ptr<Texture<Float>> &sigma,
                   const std::shared_ptr<Texture<Float>> &bumpMap,
                   const unsigned long long id = 0);
-    ~MatteMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -81,11 +80,11 @@ class MatteMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
@@ -47,6 +47,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/metalalbedo.h"
 
 namespace pbrt {
@@ -71,27 +72,9 @@ MetalMaterial::MetalMaterial(
     remapRoughness(remapRoughness)
 {
     AllocateLUT(
-        &metalAlbedoLUT[0],
-         metalAlbedoLUTNDims,
-        &metalAlbedoLUTMaxIndices[0],
-        &metalAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-MetalMaterial::~MetalMaterial() {
-    DeallocateLUT(
-        &metalAlbedoLUT[0],
-        &metalAlbedoLUTMaxIndices[0],
-        &metalAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("metal", 5, ALBEDO_LUT_FALLBACK(metal)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -138,7 +121,7 @@ void MetalMaterial::GetLUTReducibilities(bool          &reducible,
 }
 
 void MetalMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (eta->IsConstant()) {
         const RGBSpectrum etaMapped = InverseLerp(eta->Evaluate(), RGBSpectrum(Epsilon), RGBSpectrum(7.14f)).Clamp(0.f, 1.f);
@@ -168,7 +151,7 @@ void MetalMaterial::GetLUTReductionIndices(
 
 void MetalMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
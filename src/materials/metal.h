@@ -67,7 +67,6 @@ class MetalMaterial : public Material {
                   const std::shared_ptr<Texture<Float>> &bump,
                   bool remapRoughness,
                   const unsigned long long id = 0);
-    ~MetalMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -85,11 +84,11 @@ class MetalMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
@@ -77,6 +77,13 @@ RGBSpectrum MixMaterial::GetAlbedo(SurfaceInteraction *si) const {
     Spectrum s1 = scale->Evaluate(*si).Clamp();
     Spectrum s2 = (Spectrum(1.f) - s1).Clamp();
 
+    // Skip the lookup of a material that does not contribute (e.g., for
+    // binary masks); LUT lookups themselves do not allocate.
+    if (s1.IsBlack())
+        return s2 * m2->GetAlbedo(si);
+    if (s2.IsBlack())
+        return s1 * m1->GetAlbedo(si);
+
     return s1 * m1->GetAlbedo(si) + s2 * m2->GetAlbedo(si);
 }
 
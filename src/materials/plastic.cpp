@@ -48,6 +48,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/plasticalbedo.h"
 
 namespace pbrt {
@@ -68,27 +69,9 @@ PlasticMaterial::PlasticMaterial(
     remapRoughness(remapRoughness)
 {
     AllocateLUT(
-        &plasticAlbedoLUT[0],
-         plasticAlbedoLUTNDims,
-        &plasticAlbedoLUTMaxIndices[0],
-        &plasticAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-PlasticMaterial::~PlasticMaterial() {
-    DeallocateLUT(
-        &plasticAlbedoLUT[0],
-        &plasticAlbedoLUTMaxIndices[0],
-        &plasticAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("plastic", 4, ALBEDO_LUT_FALLBACK(plastic)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -136,7 +119,7 @@ void PlasticMaterial::GetLUTReducibilities(
 }
 
 void PlasticMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (Kd->IsConstant()) {
         const RGBSpectrum kdMapped = Kd->Evaluate().Clamp(0.f, 1.f);
@@ -157,7 +140,7 @@ void PlasticMaterial::GetLUTReductionIndices(
 
 void PlasticMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
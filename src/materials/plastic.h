@@ -65,7 +65,6 @@ class PlasticMaterial : public Material {
                     const std::shared_ptr<Texture<Float>> &bumpMap,
                     bool remapRoughness,
                     const unsigned long long id = 0);
-    ~PlasticMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -83,11 +82,11 @@ class PlasticMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
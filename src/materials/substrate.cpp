@@ -48,6 +48,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/substratealbedo.h"
 
 namespace pbrt {
@@ -70,27 +71,9 @@ SubstrateMaterial::SubstrateMaterial(
     remapRoughness(remapRoughness)
 {
     AllocateLUT(
-        &substrateAlbedoLUT[0],
-         substrateAlbedoLUTNDims,
-        &substrateAlbedoLUTMaxIndices[0],
-        &substrateAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-SubstrateMaterial::~SubstrateMaterial() {
-    DeallocateLUT(
-        &substrateAlbedoLUT[0],
-        &substrateAlbedoLUTMaxIndices[0],
-        &substrateAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("substrate", 5, ALBEDO_LUT_FALLBACK(substrate)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -134,7 +117,7 @@ void SubstrateMaterial::GetLUTReducibilities(bool          &reducible,
 }
 
 void SubstrateMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (Kd->IsConstant()) {
         const RGBSpectrum kdMapped = Kd->Evaluate().Clamp(0.f, 1.f);
@@ -162,7 +145,7 @@ void SubstrateMaterial::GetLUTReductionIndices(
 
 void SubstrateMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
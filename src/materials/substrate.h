@@ -66,7 +66,6 @@ class SubstrateMaterial : public Material {
                       const std::shared_ptr<Texture<Float>> &bumpMap,
                       bool remapRoughness,
                       const unsigned long long id = 0);
-    ~SubstrateMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -85,11 +84,11 @@ class SubstrateMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
@@ -108,7 +108,17 @@ void SubsurfaceMaterial::ComputeScatteringFunctions(
 }
 
 RGBSpectrum SubsurfaceMaterial::GetAlbedo(SurfaceInteraction *si) const {
-    return si->bsdf->rho(si->wo);
+    // The parameters of the BSDF; the BSSRDF does not contribute to rho().
+    Float r[3], t[3];
+    Spectrum(Kr->Evaluate(*si).Clamp()).ToRGB(r);
+    Spectrum(Kt->Evaluate(*si).Clamp()).ToRGB(t);
+    const Float params[] = {
+        r[0], r[1], r[2],
+        t[0], t[1], t[2],
+        uRoughness->Evaluate(*si),
+        vRoughness->Evaluate(*si)
+    };
+    return albedoCache.Lookup(*si, params, sizeof(params) / sizeof(Float));
 };
 
 SubsurfaceMaterial *CreateSubsurfaceMaterial(const TextureParams &mp,
@@ -54,6 +54,7 @@
 #include "reflection.h"
 #include "bssrdf.h"
 #include "spectrum.h"
+#include "statistics/albedocache.h"
 
 namespace pbrt {
 
@@ -100,6 +101,7 @@ class SubsurfaceMaterial : public Material {
     const Float eta;
     const bool remapRoughness;
     BSSRDFTable table;
+    AlbedoCache albedoCache;
 };
 
 SubsurfaceMaterial *CreateSubsurfaceMaterial(const TextureParams &mp,
@@ -48,6 +48,7 @@
 #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/translucentalbedo.h"
 
 namespace pbrt {
@@ -72,27 +73,9 @@ TranslucentMaterial::TranslucentMaterial(
     remapRoughness = remap;
 
     AllocateLUT(
-        &translucentAlbedoLUT[0],
-         translucentAlbedoLUTNDims,
-        &translucentAlbedoLUTMaxIndices[0],
-        &translucentAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-TranslucentMaterial::~TranslucentMaterial() {
-    DeallocateLUT(
-        &translucentAlbedoLUT[0],
-        &translucentAlbedoLUTMaxIndices[0],
-        &translucentAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("translucent", 6, ALBEDO_LUT_FALLBACK(translucent)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -156,7 +139,7 @@ void TranslucentMaterial::GetLUTReducibilities(
 }
 
 void TranslucentMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (Kd->IsConstant()) {
         const RGBSpectrum kdMapped = Kd->Evaluate().Clamp(0.f, 1.f);
@@ -185,7 +168,7 @@ void TranslucentMaterial::GetLUTReductionIndices(
 
 void TranslucentMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
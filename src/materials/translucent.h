@@ -67,7 +67,6 @@ class TranslucentMaterial : public Material {
                         const std::shared_ptr<Texture<Float>> &bump,
                         bool remap,
                         const unsigned long long id = 0);
-    ~TranslucentMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -87,11 +86,11 @@ class TranslucentMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
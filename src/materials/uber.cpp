@@ -48,6 +48,7 @@
 #include "texture.h"
 #include "interaction.h"
 #include "paramset.h"
+#include "statistics/lutfile.h"
 #include "statistics/luts/uberalbedo.h"
 
 namespace pbrt {
@@ -80,27 +81,9 @@ UberMaterial::UberMaterial(
     remapRoughness(remapRoughness)
 {
     AllocateLUT(
-        &uberAlbedoLUT[0],
-         uberAlbedoLUTNDims,
-        &uberAlbedoLUTMaxIndices[0],
-        &uberAlbedoLUTOffsets[0],
-         albedoLUT,           // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTNDims,
-         albedoLUTMaxIndices, // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTOffsets,    // Potentially allocated with new (we might just point to the data given above)
-         albedoLUTRGBOffsets  // Allocated with new
-    );
-}
-
-UberMaterial::~UberMaterial() {
-    DeallocateLUT(
-        &uberAlbedoLUT[0],
-        &uberAlbedoLUTMaxIndices[0],
-        &uberAlbedoLUTOffsets[0],
-         albedoLUT,
-         albedoLUTMaxIndices,
-         albedoLUTOffsets,
-         albedoLUTRGBOffsets
+        GetAlbedoLUT("uber", 8, ALBEDO_LUT_FALLBACK(uber)),
+        albedoLUT,       // Points to the source LUT or the reduced LUT
+        reducedAlbedoLUT // Shared with other materials with the same constant parameters
     );
 }
 
@@ -197,7 +180,7 @@ void UberMaterial::GetLUTReducibilities(
 }
 
 void UberMaterial::GetLUTReductionIndices(
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     if (Kd->IsConstant()) {
         const RGBSpectrum kdMapped = Kd->Evaluate().Clamp(0.f, 1.f);
@@ -247,7 +230,7 @@ void UberMaterial::GetLUTReductionIndices(
 
 void UberMaterial::GetLUTIndices(
     SurfaceInteraction *si,
-    std::vector<std::vector<Float>> &indices
+    LUTIndices &indices
 ) const {
     const Float cosThetaMapped = Clamp(InverseLerp(Dot(si->wo, si->shading.n), CosEpsilon, 1.f), 0.f, 1.f); // Transform wo.z to local space
     LUT_SET_INDICES(0, cosThetaMapped)
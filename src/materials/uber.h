@@ -71,7 +71,6 @@ class UberMaterial : public Material {
                  const std::shared_ptr<Texture<Float>> &bumpMap,
                  bool remapRoughness,
                  const unsigned long long id = 0);
-    ~UberMaterial();
     void ComputeScatteringFunctions(SurfaceInteraction *si, MemoryArena &arena,
                                     TransportMode mode,
                                     bool allowMultipleLobes) const;
@@ -91,11 +90,11 @@ class UberMaterial : public Material {
         unsigned char &nDims
     ) const;
     void GetLUTReductionIndices(
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
     void GetLUTIndices(
         SurfaceInteraction *si,
-        std::vector<std::vector<Float>> &indices
+        LUTIndices &indices
     ) const;
 };
 
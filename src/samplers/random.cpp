@@ -69,6 +69,10 @@ std::unique_ptr<Sampler> RandomSampler::Clone(int seed) {
     return std::unique_ptr<Sampler>(rs);
 }
 
+void RandomSampler::Reseed(int seed) {
+    rng.SetSequence((baseSeed + 1) * (seed + 1));
+}
+
 void RandomSampler::StartPixel(const Point2i &p) {
     ProfilePhase _(Prof::StartPixel);
     for (size_t i = 0; i < sampleArray1D.size(); ++i)
@@ -61,6 +61,7 @@ class RandomSampler : public Sampler {
     Float Get1D();
     Point2f Get2D();
     std::unique_ptr<Sampler> Clone(int seed);
+    void Reseed(int seed);
 
   private:
     RNG rng;
@@ -35,6 +35,7 @@
 #include "shapes/triangle.h"
 #include "textures/constant.h"
 #include "paramset.h"
+#include "statistics/scenecache.h"
 #include "ext/rply.h"
 
 #include <iostream>
@@ -154,11 +155,70 @@ int rply_face_callback(p_ply_argument argument) {
     return 1;
 }
 
+static std::vector<std::shared_ptr<Shape>> CreatePLYTriangleMesh(
+    const Transform *o2w, const Transform *w2o, bool reverseOrientation,
+    const ParamSet &params,
+    std::map<std::string, std::shared_ptr<Texture<Float>>> *floatTextures,
+    int nTriangles, const int *indices, int nVertices, const Point3f *p,
+    const Normal3f *n, const Point2f *uv, const int *faceIndices) {
+    // Look up an alpha texture, if applicable
+    std::shared_ptr<Texture<Float>> alphaTex;
+    std::string alphaTexName = params.FindTexture("alpha");
+    if (alphaTexName != "") {
+        if (floatTextures->find(alphaTexName) != floatTextures->end())
+            alphaTex = (*floatTextures)[alphaTexName];
+        else
+            Error("Couldn't find float texture \"%s\" for \"alpha\" parameter",
+                  alphaTexName.c_str());
+    } else if (params.FindOneFloat("alpha", 1.f) == 0.f) {
+        alphaTex.reset(new ConstantTexture<Float>(0.f));
+    }
+
+    std::shared_ptr<Texture<Float>> shadowAlphaTex;
+    std::string shadowAlphaTexName = params.FindTexture("shadowalpha");
+    if (shadowAlphaTexName != "") {
+        if (floatTextures->find(shadowAlphaTexName) != floatTextures->end())
+            shadowAlphaTex = (*floatTextures)[shadowAlphaTexName];
+        else
+            Error(
+                "Couldn't find float texture \"%s\" for \"shadowalpha\" "
+                "parameter",
+                shadowAlphaTexName.c_str());
+    } else if (params.FindOneFloat("shadowalpha", 1.f) == 0.f)
+        shadowAlphaTex.reset(new ConstantTexture<Float>(0.f));
+
+    return CreateTriangleMesh(o2w, w2o, reverseOrientation, nTriangles,
+                              indices, nVertices, p, nullptr, n, uv, alphaTex,
+                              shadowAlphaTex, faceIndices);
+}
+
 std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
     const Transform *o2w, const Transform *w2o, bool reverseOrientation,
     const ParamSet &params,
     std::map<std::string, std::shared_ptr<Texture<Float>>> *floatTextures) {
     const std::string filename = params.FindOneFilename("filename", "");
+
+    // Use mesh from scene cache if present
+    SceneCacheKey cacheKey("ply");
+    const bool cacheKeyValid = SceneCacheEnabled() && cacheKey.AddFile(filename);
+    if (cacheKeyValid) {
+        std::unique_ptr<SceneCacheEntry> cached =
+            SceneCacheEntry::Read("ply", cacheKey.Get());
+        size_t nVertices, nNormals, nUVs, nIndices, nFaceIndices;
+        const Point3f *p = cached ? cached->Section<Point3f>(0, &nVertices) : nullptr;
+        const Normal3f *n = p ? cached->Section<Normal3f>(1, &nNormals) : nullptr;
+        const Point2f *uv = n ? cached->Section<Point2f>(2, &nUVs) : nullptr;
+        const int *indices = uv ? cached->Section<int>(3, &nIndices) : nullptr;
+        const int *faceIndices =
+            indices ? cached->Section<int>(4, &nFaceIndices) : nullptr;
+        if (faceIndices)
+            return CreatePLYTriangleMesh(
+                o2w, w2o, reverseOrientation, params, floatTextures,
+                nIndices / 3, indices, nVertices, p,
+                nNormals > 0 ? n : nullptr, nUVs > 0 ? uv : nullptr,
+                nFaceIndices > 0 ? faceIndices : nullptr);
+    }
+
     p_ply ply = ply_open(filename.c_str(), rply_message_callback, 0, nullptr);
     if (!ply) {
         Error("Couldn't open PLY file \"%s\"", filename.c_str());
@@ -256,37 +316,22 @@ std::vector<std::shared_ptr<Shape>> CreatePLYMesh(
 
     if (context.error) return std::vector<std::shared_ptr<Shape>>();
 
-    // Look up an alpha texture, if applicable
-    std::shared_ptr<Texture<Float>> alphaTex;
-    std::string alphaTexName = params.FindTexture("alpha");
-    if (alphaTexName != "") {
-        if (floatTextures->find(alphaTexName) != floatTextures->end())
-            alphaTex = (*floatTextures)[alphaTexName];
-        else
-            Error("Couldn't find float texture \"%s\" for \"alpha\" parameter",
-                  alphaTexName.c_str());
-    } else if (params.FindOneFloat("alpha", 1.f) == 0.f) {
-        alphaTex.reset(new ConstantTexture<Float>(0.f));
+    // Store mesh in scene cache
+    if (SceneCacheEnabled() && cacheKeyValid) {
+        SceneCacheWriter writer;
+        writer.AddSection(context.p, vertexCount);
+        writer.AddSection(context.n, context.n ? vertexCount : 0);
+        writer.AddSection(context.uv, context.uv ? vertexCount : 0);
+        writer.AddSection(context.indices, context.indexCtr);
+        writer.AddSection(context.faceIndices,
+                          context.faceIndices ? context.faceIndexCtr : 0);
+        writer.Write("ply", cacheKey.Get());
     }
 
-    std::shared_ptr<Texture<Float>> shadowAlphaTex;
-    std::string shadowAlphaTexName = params.FindTexture("shadowalpha");
-    if (shadowAlphaTexName != "") {
-        if (floatTextures->find(shadowAlphaTexName) != floatTextures->end())
-            shadowAlphaTex = (*floatTextures)[shadowAlphaTexName];
-        else
-            Error(
-                "Couldn't find float texture \"%s\" for \"shadowalpha\" "
-                "parameter",
-                shadowAlphaTexName.c_str());
-    } else if (params.FindOneFloat("shadowalpha", 1.f) == 0.f)
-        shadowAlphaTex.reset(new ConstantTexture<Float>(0.f));
-
-    return CreateTriangleMesh(o2w, w2o, reverseOrientation,
-                              context.indexCtr / 3, context.indices,
-                              vertexCount, context.p, nullptr, context.n,
-                              context.uv, alphaTex, shadowAlphaTex,
-                              context.faceIndices);
+    return CreatePLYTriangleMesh(o2w, w2o, reverseOrientation, params,
+                                 floatTextures, context.indexCtr / 3,
+                                 context.indices, vertexCount, context.p,
+                                 context.n, context.uv, context.faceIndices);
 }
 
 }  // namespace pbrt
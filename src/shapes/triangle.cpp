@@ -51,6 +51,7 @@ static void PlyErrorCallback(p_ply, const char *message) {
 
 // Triangle Method Definitions
 STAT_RATIO("Scene/Triangles per triangle mesh", nTris, nMeshes);
+STAT_MEMORY_COUNTER("Memory/Triangle mesh compaction savings", compactMeshBytesSaved);
 TriangleMesh::TriangleMesh(
     const Transform &ObjectToWorld, int nTriangles, const int *vertexIndices,
     int nVertices, const Point3f *P, const Vector3f *S, const Normal3f *N,
@@ -64,21 +65,51 @@ TriangleMesh::TriangleMesh(
       shadowAlphaMask(shadowAlphaMask) {
     ++nMeshes;
     nTris += nTriangles;
+    const bool compactNormals = N && PbrtOptions.compactMeshes;
+    const bool compactUVs = UV && PbrtOptions.compactUVs;
     triMeshBytes += sizeof(*this) + this->vertexIndices.size() * sizeof(int) +
-                    nVertices * (sizeof(*P) + (N ? sizeof(*N) : 0) +
-                                 (S ? sizeof(*S) : 0) + (UV ? sizeof(*UV) : 0) +
+                    nVertices * (sizeof(*P) + (S ? sizeof(*S) : 0) +
                                  (fIndices ? sizeof(*fIndices) : 0));
+    if (N)
+        triMeshBytes += nVertices * (compactNormals ? sizeof(uint32_t) : sizeof(*N));
+    if (UV)
+        triMeshBytes += nVertices * (compactUVs ? 2 * sizeof(uint16_t) : sizeof(*UV));
+    if (compactNormals)
+        compactMeshBytesSaved += nVertices * (sizeof(*N) - sizeof(uint32_t));
+    if (compactUVs)
+        compactMeshBytesSaved += nVertices * (sizeof(*UV) - 2 * sizeof(uint16_t));
 
     // Transform mesh vertices to world space
     p.reset(new Point3f[nVertices]);
     for (int i = 0; i < nVertices; ++i) p[i] = ObjectToWorld(P[i]);
 
     // Copy _UV_, _N_, and _S_ vertex data, if present
-    if (UV) {
+    if (compactUVs) {
+        // Quantize UVs to 16 bits within their bounds
+        for (int i = 0; i < nVertices; ++i) uvBounds = Union(uvBounds, UV[i]);
+        Vector2f extent = uvBounds.Diagonal();
+        uvScale = Vector2f(extent.x / 65535, extent.y / 65535);
+        quantizedUVs.reset(new uint16_t[2 * nVertices]);
+        for (int i = 0; i < nVertices; ++i)
+            for (int c = 0; c < 2; ++c)
+                quantizedUVs[2 * i + c] =
+                    extent[c] > 0 ? (uint16_t)std::round(
+                                        (UV[i][c] - uvBounds.pMin[c]) /
+                                        extent[c] * 65535)
+                                  : 0;
+    } else if (UV) {
         uv.reset(new Point2f[nVertices]);
         memcpy(uv.get(), UV, nVertices * sizeof(Point2f));
     }
-    if (N) {
+    if (compactNormals) {
+        octNormals.reset(new uint32_t[nVertices]);
+        for (int i = 0; i < nVertices; ++i) {
+            Vector3f ni(ObjectToWorld(N[i]));
+            // Degenerate normals are encoded as +z
+            octNormals[i] = EncodeOctahedral(
+                ni.LengthSquared() > 0 ? ni : Vector3f(0, 0, 1));
+        }
+    } else if (N) {
         n.reset(new Normal3f[nVertices]);
         for (int i = 0; i < nVertices; ++i) n[i] = ObjectToWorld(N[i]);
     }
@@ -98,14 +129,40 @@ std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
     const Point2f *uv, const std::shared_ptr<Texture<Float>> &alphaMask,
     const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
     const int *faceIndices) {
-    std::shared_ptr<TriangleMesh> mesh = std::make_shared<TriangleMesh>(
-        *ObjectToWorld, nTriangles, vertexIndices, nVertices, p, s, n, uv,
-        alphaMask, shadowAlphaMask, faceIndices);
+    // Allocate the mesh and its triangles as one block; the shared_ptrs of
+    // the triangles share the ownership of the block
+    struct TriangleMeshStorage {
+        TriangleMeshStorage(const Transform &ObjectToWorld, int nTriangles,
+                            const int *vertexIndices, int nVertices,
+                            const Point3f *P, const Vector3f *S,
+                            const Normal3f *N, const Point2f *UV,
+                            const std::shared_ptr<Texture<Float>> &alphaMask,
+                            const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
+                            const int *faceIndices)
+            : mesh(ObjectToWorld, nTriangles, vertexIndices, nVertices, P, S, N,
+                   UV, alphaMask, shadowAlphaMask, faceIndices) {}
+        TriangleMesh mesh;
+        std::vector<Triangle> triangles;
+    };
+    std::shared_ptr<TriangleMeshStorage> storage =
+        std::make_shared<TriangleMeshStorage>(
+            *ObjectToWorld, nTriangles, vertexIndices, nVertices, p, s, n, uv,
+            alphaMask, shadowAlphaMask, faceIndices);
+    storage->triangles.reserve(nTriangles);
     std::vector<std::shared_ptr<Shape>> tris;
     tris.reserve(nTriangles);
-    for (int i = 0; i < nTriangles; ++i)
-        tris.push_back(std::make_shared<Triangle>(ObjectToWorld, WorldToObject,
-                                                  reverseOrientation, mesh, i));
+    for (int i = 0; i < nTriangles; ++i) {
+        storage->triangles.emplace_back(ObjectToWorld, WorldToObject,
+                                        reverseOrientation, &storage->mesh, i);
+        tris.push_back(
+            std::shared_ptr<Shape>(storage, &storage->triangles.back()));
+    }
+    // Count the shared_ptr control blocks (vtable pointer and reference
+    // counts, excluding allocator overhead) that are no longer allocated per
+    // triangle
+    if (nTriangles > 1)
+        compactMeshBytesSaved +=
+            (nTriangles - 1) * (sizeof(void *) + 2 * sizeof(int));
     return tris;
 }
 
@@ -340,20 +397,23 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
     // Fill in _SurfaceInteraction_ from triangle hit
     *isect = SurfaceInteraction(pHit, pError, uvHit, -ray.d, dpdu, dpdv,
                                 Normal3f(0, 0, 0), Normal3f(0, 0, 0), ray.time,
-                                this, faceIndex);
+                                this, FaceIndex());
 
     // Override surface normal in _isect_ for triangle
     isect->n = isect->shading.n = Normal3f(Normalize(Cross(dp02, dp12)));
     if (reverseOrientation ^ transformSwapsHandedness)
         isect->n = isect->shading.n = -isect->n;
 
-    if (mesh->n || mesh->s) {
+    if (mesh->HasNormals() || mesh->s) {
         // Initialize _Triangle_ shading geometry
+        Normal3f n[3];
+        if (mesh->HasNormals())
+            for (int i = 0; i < 3; ++i) n[i] = mesh->GetNormal(v[i]);
 
         // Compute shading normal _ns_ for triangle
         Normal3f ns;
-        if (mesh->n) {
-            ns = (b0 * mesh->n[v[0]] + b1 * mesh->n[v[1]] + b2 * mesh->n[v[2]]);
+        if (mesh->HasNormals()) {
+            ns = (b0 * n[0] + b1 * n[1] + b2 * n[2]);
             if (ns.LengthSquared() > 0)
                 ns = Normalize(ns);
             else
@@ -382,12 +442,12 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
 
         // Compute $\dndu$ and $\dndv$ for triangle shading geometry
         Normal3f dndu, dndv;
-        if (mesh->n) {
+        if (mesh->HasNormals()) {
             // Compute deltas for triangle partial derivatives of normal
             Vector2f duv02 = uv[0] - uv[2];
             Vector2f duv12 = uv[1] - uv[2];
-            Normal3f dn1 = mesh->n[v[0]] - mesh->n[v[2]];
-            Normal3f dn2 = mesh->n[v[1]] - mesh->n[v[2]];
+            Normal3f dn1 = n[0] - n[2];
+            Normal3f dn2 = n[1] - n[2];
             Float determinant = duv02[0] * duv12[1] - duv02[1] * duv12[0];
             bool degenerateUV = std::abs(determinant) < 1e-8;
             if (degenerateUV) {
@@ -397,8 +457,8 @@ bool Triangle::Intersect(const Ray &ray, Float *tHit, SurfaceInteraction *isect,
                 // (rather than giving up) so that ray differentials for
                 // rays reflected from triangles with degenerate
                 // parameterizations are still reasonable.
-                Vector3f dn = Cross(Vector3f(mesh->n[v[2]] - mesh->n[v[0]]),
-                                    Vector3f(mesh->n[v[1]] - mesh->n[v[0]]));
+                Vector3f dn = Cross(Vector3f(n[2] - n[0]),
+                                    Vector3f(n[1] - n[0]));
                 if (dn.LengthSquared() == 0)
                     dndu = dndv = Normal3f(0, 0, 0);
                 else {
@@ -591,9 +651,9 @@ Interaction Triangle::Sample(const Point2f &u, Float *pdf) const {
     it.n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
     // Ensure correct orientation of the geometric normal; follow the same
     // approach as was used in Triangle::Intersect().
-    if (mesh->n) {
-        Normal3f ns(b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] +
-                    (1 - b[0] - b[1]) * mesh->n[v[2]]);
+    if (mesh->HasNormals()) {
+        Normal3f ns(b[0] * mesh->GetNormal(v[0]) + b[1] * mesh->GetNormal(v[1]) +
+                    (1 - b[0] - b[1]) * mesh->GetNormal(v[2]));
         it.n = Faceforward(it.n, ns);
     } else if (reverseOrientation ^ transformSwapsHandedness)
         it.n *= -1;
@@ -47,7 +47,37 @@ namespace pbrt {
 
 STAT_MEMORY_COUNTER("Memory/Triangle meshes", triMeshBytes);
 
+// Octahedral encoding of unit vectors in 32 bits (16 bits per coordinate of
+// the octahedron unfolded onto the square)
+inline uint32_t EncodeOctahedral(Vector3f v) {
+    v /= std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    Float x = v.x, y = v.y;
+    if (v.z < 0) {
+        x = (1 - std::abs(v.y)) * (v.x >= 0 ? 1 : -1);
+        y = (1 - std::abs(v.x)) * (v.y >= 0 ? 1 : -1);
+    }
+    auto encode = [](Float f) {
+        return (uint32_t)std::round(Clamp((f + 1) / 2, 0, 1) * 65535);
+    };
+    return encode(x) | (encode(y) << 16);
+}
+
+inline Vector3f DecodeOctahedral(uint32_t e) {
+    Vector3f v(-1 + 2 * (e & 0xffff) / Float(65535),
+               -1 + 2 * (e >> 16) / Float(65535), 0);
+    v.z = 1 - std::abs(v.x) - std::abs(v.y);
+    if (v.z < 0) {
+        Float x = v.x;
+        v.x = (1 - std::abs(v.y)) * (x >= 0 ? 1 : -1);
+        v.y = (1 - std::abs(x)) * (v.y >= 0 ? 1 : -1);
+    }
+    return Normalize(v);
+}
+
 // Triangle Declarations
+// With --compactmeshes, the (normalized) normals of a mesh are stored
+// octahedrally encoded in 32 bits; with --compactuvs, its UVs are stored as
+// 16-bit fixed-point values within the UV bounds of the mesh.
 struct TriangleMesh {
     // TriangleMesh Public Methods
     TriangleMesh(const Transform &ObjectToWorld, int nTriangles,
@@ -56,28 +86,42 @@ struct TriangleMesh {
                  const std::shared_ptr<Texture<Float>> &alphaMask,
                  const std::shared_ptr<Texture<Float>> &shadowAlphaMask,
                  const int *faceIndices);
+    bool HasNormals() const { return n || octNormals; }
+    Normal3f GetNormal(int i) const {
+        return n ? n[i] : Normal3f(DecodeOctahedral(octNormals[i]));
+    }
+    bool HasUVs() const { return uv || quantizedUVs; }
+    Point2f GetUV(int i) const {
+        if (uv) return uv[i];
+        return Point2f(uvBounds.pMin.x + quantizedUVs[2 * i] * uvScale.x,
+                       uvBounds.pMin.y + quantizedUVs[2 * i + 1] * uvScale.y);
+    }
 
     // TriangleMesh Data
     const int nTriangles, nVertices;
     std::vector<int> vertexIndices;
     std::unique_ptr<Point3f[]> p;
     std::unique_ptr<Normal3f[]> n;
+    std::unique_ptr<uint32_t[]> octNormals;    // If compact
     std::unique_ptr<Vector3f[]> s;
     std::unique_ptr<Point2f[]> uv;
+    std::unique_ptr<uint16_t[]> quantizedUVs;  // If compact
+    Bounds2f uvBounds;
+    Vector2f uvScale;
     std::shared_ptr<Texture<Float>> alphaMask, shadowAlphaMask;
     std::vector<int> faceIndices;
 };
 
+// Triangles are allocated in one block per mesh that also owns the mesh (see
+// CreateTriangleMesh()), so they only keep a pointer to it.
 class Triangle : public Shape {
   public:
     // Triangle Public Methods
     Triangle(const Transform *ObjectToWorld, const Transform *WorldToObject,
-             bool reverseOrientation, const std::shared_ptr<TriangleMesh> &mesh,
-             int triNumber)
+             bool reverseOrientation, const TriangleMesh *mesh, int triNumber)
         : Shape(ObjectToWorld, WorldToObject, reverseOrientation), mesh(mesh) {
         v = &mesh->vertexIndices[3 * triNumber];
         triMeshBytes += sizeof(*this);
-        faceIndex = mesh->faceIndices.size() ? mesh->faceIndices[triNumber] : 0;
     }
     Bounds3f ObjectBound() const;
     Bounds3f WorldBound() const;
@@ -93,13 +137,20 @@ class Triangle : public Shape {
     // reference point p.
     Float SolidAngle(const Point3f &p, int nSamples = 0) const;
 
+    // Returns the (world space) vertex positions
+    void GetVertices(Point3f p[3]) const {
+        p[0] = mesh->p[v[0]];
+        p[1] = mesh->p[v[1]];
+        p[2] = mesh->p[v[2]];
+    }
+
   private:
     // Triangle Private Methods
     void GetUVs(Point2f uv[3]) const {
-        if (mesh->uv) {
-            uv[0] = mesh->uv[v[0]];
-            uv[1] = mesh->uv[v[1]];
-            uv[2] = mesh->uv[v[2]];
+        if (mesh->HasUVs()) {
+            uv[0] = mesh->GetUV(v[0]);
+            uv[1] = mesh->GetUV(v[1]);
+            uv[2] = mesh->GetUV(v[2]);
         } else {
             uv[0] = Point2f(0, 0);
             uv[1] = Point2f(1, 0);
@@ -107,10 +158,15 @@ class Triangle : public Shape {
         }
     }
 
+    int FaceIndex() const {
+        return mesh->faceIndices.empty()
+                   ? 0
+                   : mesh->faceIndices[(v - &mesh->vertexIndices[0]) / 3];
+    }
+
     // Triangle Private Data
-    std::shared_ptr<TriangleMesh> mesh;
+    const TriangleMesh *mesh;
     const int *v;
-    int faceIndex;
 };
 
 std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(
@@ -0,0 +1,102 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// statistics/albedocache.cpp*
+#include "statistics/albedocache.h"
+#include "interaction.h"
+#include "lowdiscrepancy.h"
+#include "reflection.h"
+#include "stats.h"
+
+#include <cstring>
+
+namespace pbrt {
+
+STAT_PERCENT("Materials/Albedo cache hits", nAlbedoCacheHits, nAlbedoCacheLookups);
+STAT_MEMORY_COUNTER("Memory/Albedo caches", albedoCacheMemory);
+
+static PBRT_CONSTEXPR int   AlbedoCacheNCosThetaBins = 64;
+static PBRT_CONSTEXPR int   AlbedoCacheMantissaBits  = 6;       // ~1.6% relative precision
+static PBRT_CONSTEXPR float AlbedoCacheMinParam      = 1.f / 1024.f; // Smaller values are treated as 0
+
+// Quantizes relative to the magnitude of _v_, so that parameters do not need
+// to be normalized (e.g., eta or scaled colors).
+static uint32_t QuantizeParam(const Float v) {
+    const float f = (float)v;
+    if (std::abs(f) < AlbedoCacheMinParam)
+        return 0;
+    const int nDroppedBits = 23 - AlbedoCacheMantissaBits;
+    return (FloatToBits(f) + (1u << (nDroppedBits - 1))) >> nDroppedBits;
+}
+
+// Hammersley points; the (0, 0) corner is avoided, as it is a degenerate
+// sample for some BxDFs.
+static const Point2f *AlbedoCacheSamples() {
+    static const struct Samples {
+        Samples() {
+            for (int i = 0; i < AlbedoCacheNSamples; i++)
+                u[i] = Point2f((i + .5f) / AlbedoCacheNSamples,
+                               RadicalInverse(0, i) + .5f / AlbedoCacheNSamples);
+        }
+        Point2f u[AlbedoCacheNSamples];
+    } samples;
+    return samples.u;
+}
+
+// AlbedoCache Method Definitions
+bool AlbedoCache::Key::operator==(const Key &key) const {
+    return nValues == key.nValues &&
+           memcmp(values, key.values, nValues * sizeof(uint32_t)) == 0;
+}
+
+size_t AlbedoCache::KeyHash::operator()(const Key &key) const {
+    uint64_t hash = key.nValues;
+    for (unsigned char i = 0; i < key.nValues; i++) {
+        hash ^= key.values[i] + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        hash *= 0xff51afd7ed558ccdull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+RGBSpectrum AlbedoCache::Lookup(
+    const SurfaceInteraction &si,
+    const Float              *params,
+    const int                 nParams
+) const {
+    CHECK_LE(nParams, AlbedoCacheMaxParams);
+    DCHECK(si.bsdf);
+
+    Key key;
+    const Float cosThetaO = AbsDot(si.wo, si.shading.n);
+    key.values[0] = std::min((int)(cosThetaO * AlbedoCacheNCosThetaBins),
+                             AlbedoCacheNCosThetaBins - 1);
+    for (int i = 0; i < nParams; i++)
+        key.values[i + 1] = QuantizeParam(params[i]);
+    key.nValues = nParams + 1;
+
+    const size_t hash = KeyHash()(key);
+    Shard &shard = shards[(hash >> 8) & (AlbedoCacheNShards - 1)];
+
+    ++nAlbedoCacheLookups;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto iter = shard.entries.find(key);
+        if (iter != shard.entries.end()) {
+            ++nAlbedoCacheHits;
+            return iter->second;
+        }
+    }
+
+    // Estimate the albedo without holding the lock; if another thread has
+    // inserted the same key in the meantime, its value is kept.
+    const RGBSpectrum albedo =
+        si.bsdf->rho(si.wo, AlbedoCacheNSamples, AlbedoCacheSamples());
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.entries.size() < AlbedoCacheMaxShardSize &&
+        shard.entries.emplace(key, albedo).second)
+        albedoCacheMemory += sizeof(Key) + sizeof(RGBSpectrum) + 2 * sizeof(void *);
+
+    return albedo;
+}
+
+}  // namespace pbrt
@@ -0,0 +1,66 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_STATISTICS_ALBEDOCACHE_H
+#define PBRT_STATISTICS_ALBEDOCACHE_H
+
+// statistics/albedocache.h*
+#include "pbrt.h"
+#include "spectrum.h"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace pbrt {
+
+static PBRT_CONSTEXPR int AlbedoCacheMaxParams    = 16;
+static PBRT_CONSTEXPR int AlbedoCacheNSamples     = 64;   // BSDF samples per estimate
+static PBRT_CONSTEXPR int AlbedoCacheNShards      = 16;   // Power of 2
+static PBRT_CONSTEXPR int AlbedoCacheMaxShardSize = 1024; // Entries per shard
+
+// AlbedoCache Declarations
+// Runtime replacement for albedo LUTs for materials whose albedos cannot be
+// precomputed (see precomputealbedo). Albedos are estimated on demand with
+// AlbedoCacheNSamples BSDF samples and cached per material, keyed on the
+// quantized cosine of the outgoing direction and the quantized texture-
+// evaluated material parameters; the azimuth of the outgoing direction is
+// ignored, as for the LUTs. The cache is split into shards with separate
+// locks to reduce contention between threads. Once a shard is full, misses
+// are computed but not inserted.
+class AlbedoCache {
+  public:
+    // AlbedoCache Public Methods
+    // _si_ must have a BSDF; _params_ are the texture-evaluated parameters
+    // that the BSDF depends on (at most AlbedoCacheMaxParams).
+    RGBSpectrum Lookup(
+        const SurfaceInteraction &si,
+        const Float              *params,
+        const int                 nParams
+    ) const;
+
+  private:
+    // AlbedoCache Private Declarations
+    struct Key {
+        uint32_t      values[AlbedoCacheMaxParams + 1]; // cos(theta_o) and parameters
+        unsigned char nValues;
+        bool operator==(const Key &key) const;
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const;
+    };
+    struct alignas(PBRT_L1_CACHE_LINE_SIZE) Shard {
+        std::mutex                                   mutex;
+        std::unordered_map<Key, RGBSpectrum, KeyHash> entries;
+    };
+
+    // AlbedoCache Private Data
+    mutable Shard shards[AlbedoCacheNShards];
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_STATISTICS_ALBEDOCACHE_H
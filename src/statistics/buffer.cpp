@@ -2,6 +2,7 @@
 
 #include "statistics/buffer.h"
 #include "pbrt/util/display.h"
+#include "stats.h"
 
 namespace pbrt {
 
@@ -32,12 +33,14 @@ OutputBufferSelection::OutputBufferSelection(
 }
 
 void OutputBufferSelection::PrepareOutput() const {
+    TraceScope t("Prepare output");
     for (const Buffer &b : buffers)
         if (b.mat.depth() != CV_32F)
             b.mat.convertTo(b.outMat, CV_32F);
 }
 
 void OutputBufferSelection::Write(const std::string &filenameSuffix) const {
+    TraceScope t("Write images");
     for (const Buffer &b : buffers) {
         std::string filename =
             (filenameSuffix.empty() ? filenameStem : filenameStem + "-" + filenameSuffix) +
@@ -54,6 +57,7 @@ void OutputBufferSelection::Write(const std::string &filenameSuffix) const {
 
 static PBRT_CONSTEXPR char MaxNDisplayBuffers = 100; // We get a segfault for higher values.
 void OutputBufferSelection::Display(const std::string &titleSuffix) const {
+    TraceScope t("Display images");
     if (outMats.size() > 0) {
         if (outMats.size() > MaxNDisplayBuffers)
              LOG(FATAL) << "Exceeded the maximum number of buffers for display!";
@@ -3,6 +3,7 @@
 #include "statistics/estimator.h"
 #include <opencv2/cudaimgproc.hpp>
 #include "spectrum.h"
+#include "stats.h"
 #include "statistics/statpath.h"
 
 struct float3 {
@@ -294,12 +295,14 @@ void Estimator::AllocateBuffers(BufferRegistry &reg) {
 #undef PREPARE_G_BUFFER_GPU_PTRS
 
 
-template <typename T>
-std::vector<StatTile<T>> Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const {
-    return std::vector<StatTile<T>>(bounceEnd, StatTile<T>(tilePixelBounds));
+template <typename T, typename P>
+std::vector<StatTile<T, P>> Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const {
+    return std::vector<StatTile<T, P>>(bounceEnd, StatTile<T, P>(tilePixelBounds));
 }
 template std::vector<StatTile<Float>> Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
 template std::vector<StatTile<Vec3>>  Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
+template std::vector<StatTile<Float, FilmStatTilePixel<Float>>> Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
+template std::vector<StatTile<Vec3,  FilmStatTilePixel<Vec3>>>  Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
 
 template <typename T>
 std::vector<std::vector<StatTile<T>>> Estimator::GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd, const unsigned char n) const {
@@ -371,11 +374,11 @@ template void Estimator::MergeTiles(const std::vector<std::vector<StatTile<Float
 template void Estimator::MergeTiles(const std::vector<std::vector<StatTile<Vec3>>>  &tiles, const std::vector<StatTypeConfig> &cfgs) const;
 
 
-template <typename T>
-inline void Estimator::MergeTransformTile(const StatTile<T> &tile, const unsigned char statTypeIndex, const unsigned char bounceIndex) const {
+template <typename T, typename P>
+inline void Estimator::MergeTransformTile(const StatTile<T, P> &tile, const unsigned char statTypeIndex, const unsigned char bounceIndex) const {
     for (const Point2i p : tile.GetPixelBounds()) {
         const unsigned int offset = p.y * width + p.x;
-        const StatTilePixel<T> &tilePixel = tile.GetPixel(p);
+        const P &tilePixel = tile.GetPixel(p);
 
         ((int *) nBuffers   [statTypeIndex][bounceIndex].matPtr)[offset] = tilePixel.n;
         ((T   *) meanBuffers[statTypeIndex][bounceIndex].matPtr)[offset] = tilePixel.mean;
@@ -387,13 +390,15 @@ inline void Estimator::MergeTransformTile(const StatTile<T> &tile, const unsigne
     }
 }
 
-template <typename T>
-void Estimator::MergeTransformTiles(const std::vector<StatTile<T>> &tiles, const StatTypeConfig &cfg) const {
+template <typename T, typename P>
+void Estimator::MergeTransformTiles(const std::vector<StatTile<T, P>> &tiles, const StatTypeConfig &cfg) const {
     for (unsigned char j = 0; j < cfg.nBounces; j++)
         MergeTransformTile(tiles[j+cfg.bounceStart], cfg.index, j);
 }
 template void Estimator::MergeTransformTiles(const std::vector<StatTile<Float>> &tiles, const StatTypeConfig &cfg) const;
 template void Estimator::MergeTransformTiles(const std::vector<StatTile<Vec3>>  &tiles, const StatTypeConfig &cfg) const;
+template void Estimator::MergeTransformTiles(const std::vector<StatTile<Float, FilmStatTilePixel<Float>>> &tiles, const StatTypeConfig &cfg) const;
+template void Estimator::MergeTransformTiles(const std::vector<StatTile<Vec3,  FilmStatTilePixel<Vec3>>>  &tiles, const StatTypeConfig &cfg) const;
 
 template <typename T>
 void Estimator::MergeTransformTiles(const std::vector<std::vector<StatTile<T>>> &tiles, const std::vector<StatTypeConfig> &cfgs) const {
@@ -407,6 +412,7 @@ template void Estimator::MergeTransformTiles(const std::vector<std::vector<StatT
 template void Estimator::MergeTransformTiles(const std::vector<std::vector<StatTile<Vec3>>>  &tiles, const std::vector<StatTypeConfig> &cfgs) const;
 
 void Estimator::Upload() {
+    TraceScope t("Upload");
     for (Buffer *b : uploadBuffers) {
 #if DEBUG
         std::cout << "Uploading " << b->name << std::endl;
@@ -416,6 +422,7 @@ void Estimator::Upload() {
 }
 
 void Estimator::Download() {
+    TraceScope t("Download");
     for (Buffer *b : downloadBuffers) {
 #if DEBUG
         std::cout << "Downloading " << b->name << std::endl;
@@ -425,6 +432,7 @@ void Estimator::Download() {
 }
 
 void Estimator::Denoise() {
+    TraceScope t("Denoise");
 #if DEBUG
     std::cout << "Denoise()" << std::endl;
     std::cout << "  Float buffer count: " << (int) floatBufferCounts[DenoiseGroup] << std::endl;
@@ -489,6 +497,7 @@ void Estimator::Denoise() {
 }
 
 void Estimator::CalculateMeanVars() {
+    TraceScope t("CalculateMeanVars");
     #if DEBUG
         std::cout << "CalculateMeanVars()" << std::endl;
         std::cout << "  Float buffer count: " << (int) floatBufferCounts[CalculateMeanVarianceGroup] << std::endl;
@@ -568,7 +577,47 @@ void Estimator::CalculateMeanVars() {
     }
 }
 
+template <typename T>
+static double RelativeStandardError(const Mat &nMat, const Mat &meanMat, const Mat &m2Mat) {
+    // _T_ is _Float_ or _Vec3_ (the element types of the statistics buffers)
+    constexpr int nChannels = sizeof(T) / sizeof(Float);
+    double sum = 0.;
+    int64_t count = 0;
+    for (int row = 0; row < nMat.rows; ++row) {
+        const int   *nP    = nMat.ptr<int>(row);
+        const Float *meanP = (const Float *) meanMat.ptr<T>(row);
+        const Float *m2P   = (const Float *) m2Mat.ptr<T>(row);
+
+        for (int col = 0; col < nMat.cols; ++col) {
+            const Float n = (Float) nP[col];
+            if (n < 2)
+                continue;
+            for (int c = 0; c < nChannels; ++c) {
+                const Float mean = meanP[col * nChannels + c];
+                if (mean == 0)
+                    continue;
+                sum += std::sqrt(m2P[col * nChannels + c] / ((n - 1) * n)) / std::abs(mean);
+                count++;
+            }
+        }
+    }
+    return count > 0 ? sum / count : 0.;
+}
+
+double Estimator::RelativeStandardError(const StatTypeConfig &cfg) const {
+    if (!cfg.enable)
+        return 0.;
+    const Mat &n    = nBuffers     [cfg.index][0].mat;
+    const Mat &mean = filmBuffers  [cfg.index][0].mat;
+    const Mat &m2   = filmM2Buffers[cfg.index][0].mat;
+    if (cfg.nChannels == 3)
+        return pbrt::RelativeStandardError<Vec3>(n, mean, m2);
+    else
+        return pbrt::RelativeStandardError<Float>(n, mean, m2);
+}
+
 void Estimator::Synchronize() {
+    TraceScope t("Synchronize");
     cv::cuda::stat_denoiser::synchronize(stream);
 }
 
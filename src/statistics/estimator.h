@@ -52,6 +52,8 @@ class Tile {
                           (p.x - pixelBounds.pMin.x)];
         }
         Bounds2i GetPixelBounds() const { return pixelBounds; }
+        // Resets all pixels in place, without reallocating
+        void Reset() { std::fill(pixels.begin(), pixels.end(), T()); }
 
     protected:
         const Bounds2i pixelBounds;
@@ -123,6 +125,23 @@ struct StatTilePixel { // Float Vec3
 } __attribute__((aligned(64)));
 #endif
 
+// Radiance statistics and film accumulators of a pixel in a single structure,
+// so that film and statistics are updated in one pass over the same cache
+// lines if the pixel filter does not exceed a pixel (see
+// FilmTile::GetSinglePixelSample()); in float builds, the film accumulators
+// fit into the padding of StatTilePixel
+template <typename T>
+struct FilmStatTilePixel {
+    uint64_t n = 0;
+    T mean     = 0.f;
+    T m2       = 0.f;
+    T m3       = 0.f;
+    T filmMean = 0.f;
+    T filmM2   = 0.f;
+    Spectrum contribSum = 0.f;
+    Float filterWeightSum = 0.f;
+} __attribute__((aligned(64)));
+
 // Needed for moment calculation below (definition in .cpp)
 inline Vec3 operator*(const Vec3 &vec1, const Vec3 &vec2) {
     return Vec3(vec1[0] * vec2[0], vec1[1] * vec2[1], vec1[2] * vec2[2]);
@@ -144,22 +163,22 @@ inline Vec3 boxCox(const Vec3 &vec, const Float &lambda) {
     );
 }
 
-template <typename T>
-class StatTile : public Tile<StatTilePixel<T>> {
+template <typename T, typename P = StatTilePixel<T>>
+class StatTile : public Tile<P> {
     public:
-        StatTile(const Bounds2i &pixelBounds) : Tile<StatTilePixel<T>>(pixelBounds), filterTable(nullptr), filterTableSize(0)
+        StatTile(const Bounds2i &pixelBounds) : Tile<P>(pixelBounds), filterTable(nullptr), filterTableSize(0)
         {}
         StatTile(
             const Bounds2i &pixelBounds, const Vector2f &filterRadius,
             const Float *filterTable, int filterTableSize
-        ) : Tile<StatTilePixel<T>>(pixelBounds),
+        ) : Tile<P>(pixelBounds),
             pixelBounds(pixelBounds),
             filterRadius(filterRadius),
             invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
             filterTable(filterTable),
             filterTableSize(filterTableSize)
         {}
-        inline void AddStatSampleM1(StatTilePixel<T> &pixel, const T sample) {
+        inline void AddStatSampleM1(P &pixel, const T sample) {
             uint64_t &n = pixel.n;
 
             T &mean = pixel.mean;
@@ -171,7 +190,7 @@ class StatTile : public Tile<StatTilePixel<T>> {
 
             mean += dN;
         }
-        inline void AddStatSampleM2(StatTilePixel<T> &pixel, const T sample) {
+        inline void AddStatSampleM2(P &pixel, const T sample) {
             uint64_t &n = pixel.n;
 
             T &mean = pixel.mean;
@@ -185,7 +204,7 @@ class StatTile : public Tile<StatTilePixel<T>> {
             mean += dN;
             m2   += d * (d - dN);
         }
-        inline void AddStatSampleM3(StatTilePixel<T> &pixel, const T sample) {
+        inline void AddStatSampleM3(P &pixel, const T sample) {
             uint64_t &n = pixel.n;
 
             T &mean = pixel.mean;
@@ -203,14 +222,14 @@ class StatTile : public Tile<StatTilePixel<T>> {
             m2   +=                    d * (d      - dN      );
             m3   += - 3.f * dN  * m2 + d * (d2     - dN2     );
         }
-        void AddSample(const Point2i p, const T sample, void (StatTile::*fn)(StatTilePixel<T> &pixel, const T sample)) {
-            StatTilePixel<T> &pixel = this->GetPixel(p);
+        void AddSample(const Point2i p, const T sample, void (StatTile::*fn)(P &pixel, const T sample)) {
+            P &pixel = this->GetPixel(p);
             (this->*fn)(pixel, sample);
             pixel.filmMean = pixel.mean;
             pixel.filmM2 = pixel.m2;
         }
-        void AddTransformSample(const Point2i p, const T sample, void (StatTile::*fn)(StatTilePixel<T> &pixel, const T sample)) {
-            StatTilePixel<T> &pixel = this->GetPixel(p);
+        void AddTransformSample(const Point2i p, const T sample, void (StatTile::*fn)(P &pixel, const T sample)) {
+            P &pixel = this->GetPixel(p);
             
             (this->*fn)(pixel, boxCox(sample, .5f));
 
@@ -224,12 +243,32 @@ class StatTile : public Tile<StatTilePixel<T>> {
             filmMean += filmDN;
             filmM2   += filmD * (filmD - filmDN);
         }
-        void AddSampleM1         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T>::AddStatSampleM1); }
-        void AddTransformSampleM1(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T>::AddStatSampleM1); }
-        void AddSampleM2         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T>::AddStatSampleM2); }
-        void AddTransformSampleM2(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T>::AddStatSampleM2); }
-        void AddSampleM3         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T>::AddStatSampleM3); }
-        void AddTransformSampleM3(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T>::AddStatSampleM3); }
+        void AddSampleM1         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T, P>::AddStatSampleM1); }
+        void AddTransformSampleM1(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T, P>::AddStatSampleM1); }
+        void AddSampleM2         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T, P>::AddStatSampleM2); }
+        void AddTransformSampleM2(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T, P>::AddStatSampleM2); }
+        void AddSampleM3         (const Point2i p, const T sample) { AddSample         (p, sample, &StatTile<T, P>::AddStatSampleM3); }
+        void AddTransformSampleM3(const Point2i p, const T sample) { AddTransformSample(p, sample, &StatTile<T, P>::AddStatSampleM3); }
+
+        // Fused film accumulation (FilmStatTilePixel only); _L_ is the sample
+        // contribution as returned by FilmTile::GetSinglePixelSample()
+        void AddFilmSample(const Point2i p, const Spectrum &L, const Float filterWeight) {
+            P &pixel = this->GetPixel(p);
+            pixel.contribSum      += L * filterWeight;
+            pixel.filterWeightSum += filterWeight;
+        }
+        // Moves the fused film accumulators into _filmTile_; _offset_ maps
+        // tile pixels to film pixels
+        void FlushFilmSamples(FilmTile &filmTile, const Vector2i &offset) {
+            for (const Point2i p : this->GetPixelBounds()) {
+                P &pixel = this->GetPixel(p);
+                FilmTilePixel &filmPixel = filmTile.GetPixel(p + offset);
+                filmPixel.contribSum      += pixel.contribSum;
+                filmPixel.filterWeightSum += pixel.filterWeightSum;
+                pixel.contribSum      = 0.f;
+                pixel.filterWeightSum = 0.f;
+            }
+        }
 
     private:
         const Bounds2i pixelBounds;
@@ -281,8 +320,8 @@ class Estimator {
         }
         void RegisterGBuffer(Buffer &b, const Float filterSD);
         void AllocateBuffers(BufferRegistry &reg);
-        template <typename T>
-        std::vector<StatTile<T>> GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
+        template <typename T, typename P = StatTilePixel<T>>
+        std::vector<StatTile<T, P>> GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd) const;
         template <typename T>
         std::vector<std::vector<StatTile<T>>> GetTiles(const Bounds2i &tilePixelBounds, const unsigned char bounceEnd, const unsigned char n) const;
         template <typename T>
@@ -295,10 +334,10 @@ class Estimator {
         void MergeTiles(const std::vector<StatTile<T>> &tiles, const StatTypeConfig &cfg) const;
         template <typename T>
         void MergeTiles(const std::vector<std::vector<StatTile<T>>> &tiles, const std::vector<StatTypeConfig> &cfgs) const;
-        template <typename T>
-        inline void MergeTransformTile(const StatTile<T> &tile, const unsigned char statTypeIndex, const unsigned char bounceIndex) const;
-        template <typename T>
-        void MergeTransformTiles(const std::vector<StatTile<T>> &tiles, const StatTypeConfig &cfg) const;
+        template <typename T, typename P>
+        inline void MergeTransformTile(const StatTile<T, P> &tile, const unsigned char statTypeIndex, const unsigned char bounceIndex) const;
+        template <typename T, typename P>
+        void MergeTransformTiles(const std::vector<StatTile<T, P>> &tiles, const StatTypeConfig &cfg) const;
         template <typename T>
         void MergeTransformTiles(const std::vector<std::vector<StatTile<T>>> &tiles, const std::vector<StatTypeConfig> &cfgs) const;
         void Upload();
@@ -306,6 +345,10 @@ class Estimator {
         void Denoise();
         void CalculateMeanVars();
         void Synchronize();
+        // Mean relative standard error of the (untransformed) pixel means of
+        // the first bounce of _cfg_ over all pixels with at least two samples
+        // and a nonzero mean (averaged over channels)
+        double RelativeStandardError(const StatTypeConfig &cfg) const;
 
 
         const unsigned short width;
@@ -0,0 +1,271 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// statistics/lightbvh.cpp*
+#include "statistics/lightbvh.h"
+#include "interaction.h"
+#include "light.h"
+#include "rng.h"
+#include "stats.h"
+#include "transform.h"
+
+#include <algorithm>
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER("Memory/Light BVH", lightBVHBytes);
+STAT_COUNTER("Light BVH/Bounded lights", nBoundedLights);
+STAT_COUNTER("Light BVH/Unbounded lights", nUnboundedLights);
+
+static Float SafeSqrt(Float x) { return std::sqrt(std::max(x, Float(0))); }
+static Float SafeAcos(Float x) { return std::acos(Clamp(x, -1, 1)); }
+
+// LightBounds Method Definitions
+Float LightBounds::Importance(const Point3f &p, const Normal3f &n) const {
+    // Compute clamped squared distance to the centroid
+    const Point3f pc = Centroid();
+    Float d2 = DistanceSquared(p, pc);
+    d2 = std::max(d2, bounds.Diagonal().Length() / 2);
+
+    // Cosine and sine of the difference of two angles, clamped to zero
+    auto cosSubClamped = [](Float sinTheta_a, Float cosTheta_a,
+                            Float sinTheta_b, Float cosTheta_b) -> Float {
+        if (cosTheta_a > cosTheta_b) return 1;
+        return cosTheta_a * cosTheta_b + sinTheta_a * sinTheta_b;
+    };
+    auto sinSubClamped = [](Float sinTheta_a, Float cosTheta_a,
+                            Float sinTheta_b, Float cosTheta_b) -> Float {
+        if (cosTheta_a > cosTheta_b) return 0;
+        return sinTheta_a * cosTheta_b - cosTheta_a * sinTheta_b;
+    };
+
+    // Compute the angle between _w_ and the direction to _p_
+    const Vector3f wi = d2 > 0 && p != pc ? Normalize(p - pc) : w;
+    Float cosTheta_w = Dot(w, wi);
+    if (twoSided) cosTheta_w = std::abs(cosTheta_w);
+    const Float sinTheta_w = SafeSqrt(1 - cosTheta_w * cosTheta_w);
+
+    // Compute the angle subtended by the bounds at _p_
+    Point3f center;
+    Float radius;
+    bounds.BoundingSphere(&center, &radius);
+    const Float dc2 = DistanceSquared(p, center);
+    const Float cosTheta_b =
+        dc2 < radius * radius ? -1 : SafeSqrt(1 - radius * radius / dc2);
+    const Float sinTheta_b = SafeSqrt(1 - cosTheta_b * cosTheta_b);
+
+    // Compute the minimum angle between the emission cone and _p_ and
+    // test it against the emission angle
+    const Float sinTheta_o = SafeSqrt(1 - cosTheta_o * cosTheta_o);
+    const Float cosTheta_x =
+        cosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    const Float sinTheta_x =
+        sinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    const Float cosThetap =
+        cosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+    if (cosThetap <= cosTheta_e) return 0;
+
+    Float importance = phi * cosThetap / d2;
+
+    // Account for the cosine of the incident angle at surfaces
+    if (n != Normal3f(0, 0, 0)) {
+        const Float cosTheta_i = AbsDot(wi, n);
+        const Float sinTheta_i = SafeSqrt(1 - cosTheta_i * cosTheta_i);
+        importance *=
+            cosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+    }
+    return std::max(importance, Float(0));
+}
+
+LightBounds Union(const LightBounds &a, const LightBounds &b) {
+    if (a.phi == 0) return b;
+    if (b.phi == 0) return a;
+
+    // Compute the cone that contains the normal cones of _a_ and _b_
+    Vector3f w;
+    Float cosTheta_o;
+    const Float theta_a = SafeAcos(a.cosTheta_o), theta_b = SafeAcos(b.cosTheta_o);
+    const Float theta_d = SafeAcos(Dot(a.w, b.w));
+    if (std::min(theta_d + theta_b, Pi) <= theta_a) {
+        w = a.w;
+        cosTheta_o = a.cosTheta_o;
+    } else if (std::min(theta_d + theta_a, Pi) <= theta_b) {
+        w = b.w;
+        cosTheta_o = b.cosTheta_o;
+    } else {
+        const Float theta_o = (theta_a + theta_d + theta_b) / 2;
+        const Vector3f wr = Cross(a.w, b.w);
+        if (theta_o >= Pi || wr.LengthSquared() == 0) {
+            // Entire sphere
+            w = Vector3f(0, 0, 1);
+            cosTheta_o = -1;
+        } else {
+            // Rotate _a.w_ towards _b.w_
+            w = Rotate(Degrees(theta_o - theta_a), wr)(a.w);
+            cosTheta_o = std::cos(theta_o);
+        }
+    }
+
+    return LightBounds(Union(a.bounds, b.bounds), w, a.phi + b.phi, cosTheta_o,
+                       std::min(a.cosTheta_e, b.cosTheta_e),
+                       a.twoSided || b.twoSided);
+}
+
+// LightBVH Method Definitions
+LightBVH::LightBVH(const std::vector<std::shared_ptr<Light>> &lights) {
+    std::vector<std::pair<int, LightBounds>> bvhLights;
+    for (size_t i = 0; i < lights.size(); ++i) {
+        LightBounds lightBounds;
+        if (!lights[i]->GetBounds(&lightBounds)) {
+            infiniteLights.push_back(i);
+            ++nUnboundedLights;
+        } else if (lightBounds.phi > 0) {
+            // Lights without power can never be selected
+            bvhLights.push_back(std::make_pair(int(i), lightBounds));
+            ++nBoundedLights;
+        }
+    }
+    if (!bvhLights.empty()) {
+        nodes.reserve(2 * bvhLights.size() - 1);
+        BuildBVH(bvhLights, 0, bvhLights.size());
+    }
+    lightBVHBytes += nodes.size() * sizeof(LightBVHNode) +
+                     infiniteLights.size() * sizeof(int);
+    LOG(INFO) << "LightBVH: " << bvhLights.size() << " bounded lights, " <<
+        infiniteLights.size() << " unbounded lights, " << nodes.size() <<
+        " nodes";
+}
+
+int LightBVH::BuildBVH(std::vector<std::pair<int, LightBounds>> &bvhLights,
+                       int start, int end) {
+    const int nodeIndex = nodes.size();
+    nodes.push_back(LightBVHNode());
+    if (end - start == 1) {
+        nodes[nodeIndex] = {bvhLights[start].second, bvhLights[start].first,
+                            true};
+        return nodeIndex;
+    }
+
+    // Choose the split dimension and position with the cost of
+    // EvaluateCost() (a SAH that accounts for power and orientation)
+    Bounds3f bounds, centroidBounds;
+    for (int i = start; i < end; ++i) {
+        bounds = Union(bounds, bvhLights[i].second.bounds);
+        centroidBounds = Union(centroidBounds, bvhLights[i].second.Centroid());
+    }
+    PBRT_CONSTEXPR int nBuckets = 12;
+    auto bucket = [&](const LightBounds &lb, int dim) {
+        return std::min(int(nBuckets * centroidBounds.Offset(lb.Centroid())[dim]),
+                        nBuckets - 1);
+    };
+    Float minCost = Infinity;
+    int minCostSplitBucket = -1, minCostSplitDim = -1;
+    for (int dim = 0; dim < 3; ++dim) {
+        if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) continue;
+        LightBounds bucketLightBounds[nBuckets];
+        for (int i = start; i < end; ++i) {
+            LightBounds &b = bucketLightBounds[bucket(bvhLights[i].second, dim)];
+            b = Union(b, bvhLights[i].second);
+        }
+
+        // Compute costs for splitting after each bucket
+        LightBounds below[nBuckets - 1];
+        below[0] = bucketLightBounds[0];
+        for (int i = 1; i < nBuckets - 1; ++i)
+            below[i] = Union(below[i - 1], bucketLightBounds[i]);
+        LightBounds above;
+        for (int i = nBuckets - 2; i >= 0; --i) {
+            above = Union(above, bucketLightBounds[i + 1]);
+            const Float cost = EvaluateCost(below[i], bounds, dim) +
+                               EvaluateCost(above, bounds, dim);
+            if (cost > 0 && cost < minCost) {
+                minCost = cost;
+                minCostSplitBucket = i;
+                minCostSplitDim = dim;
+            }
+        }
+    }
+
+    // Partition lights (at the middle if there is no useful split)
+    int mid = (start + end) / 2;
+    if (minCostSplitDim != -1) {
+        auto pmid = std::partition(
+            bvhLights.begin() + start, bvhLights.begin() + end,
+            [&](const std::pair<int, LightBounds> &l) {
+                return bucket(l.second, minCostSplitDim) <= minCostSplitBucket;
+            });
+        if (pmid != bvhLights.begin() + start && pmid != bvhLights.begin() + end)
+            mid = pmid - bvhLights.begin();
+    }
+
+    // The first child directly follows its parent
+    BuildBVH(bvhLights, start, mid);
+    const int secondChild = BuildBVH(bvhLights, mid, end);
+    nodes[nodeIndex] = {Union(nodes[nodeIndex + 1].lightBounds,
+                              nodes[secondChild].lightBounds),
+                        secondChild, false};
+    return nodeIndex;
+}
+
+Float LightBVH::EvaluateCost(const LightBounds &b, const Bounds3f &bounds,
+                             int dim) const {
+    // Solid angle measure of the normal and emission cones
+    const Float theta_o = SafeAcos(b.cosTheta_o), theta_e = SafeAcos(b.cosTheta_e);
+    const Float theta_w = std::min(theta_o + theta_e, Pi);
+    const Float sinTheta_o = SafeSqrt(1 - b.cosTheta_o * b.cosTheta_o);
+    const Float M_omega =
+        2 * Pi * (1 - b.cosTheta_o) +
+        Pi / 2 * (2 * theta_w * sinTheta_o - std::cos(theta_o - 2 * theta_w) -
+                  2 * theta_o * sinTheta_o + b.cosTheta_o);
+
+    // Penalize thin slabs along _dim_
+    const Vector3f d = bounds.Diagonal();
+    const Float Kr = std::max(d.x, std::max(d.y, d.z)) / d[dim];
+    return b.phi * M_omega * Kr * b.bounds.SurfaceArea();
+}
+
+int LightBVH::Sample(const Interaction &it, Float u, Float *pmf) const {
+    // Select an unbounded light or the BVH
+    const Float pInfinite = Float(infiniteLights.size()) /
+                            Float(infiniteLights.size() + (nodes.empty() ? 0 : 1));
+    if (u < pInfinite) {
+        const int index = std::min(int(u / pInfinite * infiniteLights.size()),
+                                   int(infiniteLights.size()) - 1);
+        *pmf = pInfinite / infiniteLights.size();
+        return infiniteLights[index];
+    }
+    if (nodes.empty()) return -1;
+
+    // Descend the BVH, choosing children proportionally to their importance
+    const Point3f &p = it.p;
+    const Normal3f n = it.IsSurfaceInteraction()
+                           ? ((const SurfaceInteraction &)it).shading.n
+                           : Normal3f(0, 0, 0);
+    u = std::min((u - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+    *pmf = 1 - pInfinite;
+    int nodeIndex = 0;
+    while (true) {
+        const LightBVHNode &node = nodes[nodeIndex];
+        if (node.isLeaf) {
+            // A single light at the root still has to be able to contribute
+            if (nodeIndex > 0 || node.lightBounds.Importance(p, n) > 0)
+                return node.childOrLightIndex;
+            return -1;
+        }
+        const Float ci[2] = {
+            nodes[nodeIndex + 1].lightBounds.Importance(p, n),
+            nodes[node.childOrLightIndex].lightBounds.Importance(p, n)};
+        if (ci[0] == 0 && ci[1] == 0) return -1;
+        const Float p0 = ci[0] / (ci[0] + ci[1]);
+        if (u < p0) {
+            u = std::min(u / p0, OneMinusEpsilon);
+            *pmf *= p0;
+            nodeIndex = nodeIndex + 1;
+        } else {
+            u = std::min((u - p0) / (1 - p0), OneMinusEpsilon);
+            *pmf *= 1 - p0;
+            nodeIndex = node.childOrLightIndex;
+        }
+    }
+}
+
+}  // namespace pbrt
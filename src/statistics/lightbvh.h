@@ -0,0 +1,77 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_STATISTICS_LIGHTBVH_H
+#define PBRT_STATISTICS_LIGHTBVH_H
+
+// statistics/lightbvh.h*
+#include "pbrt.h"
+#include "geometry.h"
+#include <vector>
+
+namespace pbrt {
+
+// Light BVH Declarations
+// Bounds of the emission of a light (or a set of lights): the lights lie
+// within _bounds_, have the total power _phi_, and their surface normals (or
+// main emission directions) lie within the cone around _w_ with the angle
+// acos(cosTheta_o). Around each normal, they emit within the angle
+// acos(cosTheta_e). (See "Importance Sampling of Many Lights with Adaptive
+// Tree Splitting" by Conty Estevez and Kulla and pbrt-v4.)
+struct LightBounds {
+    LightBounds() {}
+    LightBounds(const Bounds3f &bounds, const Vector3f &w, Float phi,
+                Float cosTheta_o, Float cosTheta_e, bool twoSided)
+        : bounds(bounds), w(Normalize(w)), phi(phi), cosTheta_o(cosTheta_o),
+          cosTheta_e(cosTheta_e), twoSided(twoSided) {}
+    Point3f Centroid() const { return (bounds.pMin + bounds.pMax) / 2; }
+    // Returns a conservative estimate of the contribution of the lights to
+    // point _p_ (with surface normal _n_, or (0, 0, 0) for points in media)
+    Float Importance(const Point3f &p, const Normal3f &n) const;
+
+    Bounds3f bounds;
+    Vector3f w;
+    Float phi = 0;
+    Float cosTheta_o, cosTheta_e;
+    bool twoSided;
+};
+
+LightBounds Union(const LightBounds &a, const LightBounds &b);
+
+// Selects lights according to their estimated contribution to a point in
+// O(log(#lights)) by descending a BVH over the bounds of the lights. Lights
+// without bounds (e.g., infinite and distant lights) are selected
+// uniformly with the same probability as the whole BVH.
+class LightBVH {
+  public:
+    LightBVH(const std::vector<std::shared_ptr<Light>> &lights);
+    // Returns the index of the selected light in _lights_ and its selection
+    // probability _pmf_ for a reference point _it_, or -1 if no light can
+    // contribute to it
+    int Sample(const Interaction &it, Float u, Float *pmf) const;
+
+  private:
+    struct LightBVHNode {
+        LightBounds lightBounds;
+        // Index of the second child for interior nodes (the first child
+        // directly follows its parent) or of the light for leaves
+        int childOrLightIndex;
+        bool isLeaf;
+    };
+
+    int BuildBVH(std::vector<std::pair<int, LightBounds>> &bvhLights,
+                 int start, int end);
+    Float EvaluateCost(const LightBounds &b, const Bounds3f &bounds,
+                       int dim) const;
+
+    std::vector<int> infiniteLights;
+    std::vector<LightBVHNode> nodes;
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_STATISTICS_LIGHTBVH_H
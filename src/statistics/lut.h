@@ -10,9 +10,33 @@
 
 #include "pbrt.h"
 #include <algorithm> // std::min
+#if (defined(__SSE__) || defined(_M_X64)) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define PBRT_LUT_SSE
+#include <xmmintrin.h>
+#endif
 
 namespace pbrt {
 
+// Maximum number of dimensions of material LUTs (see LookupTableRGB())
+static PBRT_CONSTEXPR unsigned char LUTMaxDims = 8;
+
+// Normalized per-channel indices as set by Material::GetLUTIndices()
+typedef Float LUTIndices[3][LUTMaxDims];
+
+// Number of values per entry of an interleaved RGB LUT (padded for SIMD)
+static PBRT_CONSTEXPR unsigned char LUTRGBStride = 4;
+
+// LUT Declarations
+// Non-owning view of a LUT; the memory is owned by the compiled-in arrays in
+// statistics/luts/, a memory-mapped LUT file, or a reduced material LUT.
+struct LUT {
+    const Float         *values     = nullptr;
+    unsigned char        nDims      = 0;
+    const unsigned char *maxIndices = nullptr;
+    const unsigned int  *offsets    = nullptr; // Offsets of the 2^nDims hypercube corners
+    unsigned char        stride     = 1;       // 1 or LUTRGBStride (interleaved RGB)
+};
+
 #define LUT_LERP(arrayPrefix, arraySuffix, dimensionIndex, i0, i1) \
     arrayPrefix i0 arraySuffix * d0[dimensionIndex] + \
     arrayPrefix i1 arraySuffix * d1[dimensionIndex]
@@ -271,6 +295,110 @@ inline Float LookupTable(
     return LUT_LERP(c[, ], k, 0, 1);
 }
 
+#ifdef PBRT_LUT_SSE
+typedef __m128 LUTRGBValue;
+
+inline LUTRGBValue LUTLoadRGB(const Float *v) {
+    return _mm_loadu_ps(v);
+}
+inline LUTRGBValue LUTLerpRGB(const LUTRGBValue &v0, const LUTRGBValue &v1,
+                              const Float d0, const Float d1) {
+    return _mm_add_ps(_mm_mul_ps(v0, _mm_set1_ps(d0)),
+                      _mm_mul_ps(v1, _mm_set1_ps(d1)));
+}
+inline void LUTStoreRGB(const LUTRGBValue &v, Float rgb[3]) {
+    alignas(16) float c[4];
+    _mm_store_ps(c, v);
+    rgb[0] = c[0];
+    rgb[1] = c[1];
+    rgb[2] = c[2];
+}
+#else
+struct LUTRGBValue {
+    Float c[LUTRGBStride];
+};
+
+inline LUTRGBValue LUTLoadRGB(const Float *v) {
+    return {{v[0], v[1], v[2], v[3]}};
+}
+inline LUTRGBValue LUTLerpRGB(const LUTRGBValue &v0, const LUTRGBValue &v1,
+                              const Float d0, const Float d1) {
+    LUTRGBValue v;
+    for (unsigned char i = 0; i < LUTRGBStride; i++)
+        v.c[i] = v0.c[i] * d0 + v1.c[i] * d1;
+    return v;
+}
+inline void LUTStoreRGB(const LUTRGBValue &v, Float rgb[3]) {
+    rgb[0] = v.c[0];
+    rgb[1] = v.c[1];
+    rgb[2] = v.c[2];
+}
+#endif
+
+// Looks up all three channels of a LUT with up to LUTMaxDims dimensions.
+// If the indices are the same for all channels (i.e., no spectrum parameter
+// varies per channel), the hypercube corners and weights are computed only
+// once; for an interleaved RGB LUT (stride LUTRGBStride, offsets including
+// the stride), all channels are then interpolated together. Otherwise, we
+// fall back to one lookup per channel.
+inline void LookupTableRGB(
+    const LUT        &lut,
+    const LUTIndices &indices,
+    Float             rgb[3]
+) {
+    const unsigned char nDims = lut.nDims;
+    bool shared = true;
+    for (unsigned char i = 0; i < nDims; i++)
+        if (indices[1][i] != indices[0][i] || indices[2][i] != indices[0][i]) {
+            shared = false;
+            break;
+        }
+
+    if (!shared) {
+        for (unsigned char c = 0; c < 3; c++)
+            rgb[c] = LookupTable(lut.stride == 1 ? lut.values : lut.values + c,
+                                 nDims, lut.maxIndices, lut.offsets,
+                                 indices[c]);
+        return;
+    }
+
+    if (lut.stride == 1) {
+        rgb[0] = rgb[1] = rgb[2] = LookupTable(
+            lut.values, nDims, lut.maxIndices, lut.offsets, indices[0]);
+        return;
+    }
+
+    // Calculate the first index of the hypercube and the deltas once
+    unsigned int lutIndex = 0;
+    Float d0[LUTMaxDims], d1[LUTMaxDims];
+    for (unsigned char i = 0; i < nDims; i++) {
+        const Float index = std::min(indices[0][i] * lut.maxIndices[i],
+                                     (Float) lut.maxIndices[i]);
+        const unsigned char lowerIndex = std::min((int)index,
+                                                  lut.maxIndices[i] - 1);
+        d1[i] = index - lowerIndex;
+        d0[i] = 1.f - d1[i];
+        lutIndex += lowerIndex * lut.offsets[1 << i];
+    }
+    const Float *values = &lut.values[lutIndex];
+
+    // Lerp along the first dimension while reading the corners, then reduce
+    // the remaining dimensions pairwise
+    unsigned int count = 1u << (nDims - 1);
+    LUTRGBValue c[1 << (LUTMaxDims - 1)];
+    for (unsigned int i = 0, j = 0; i < count; i++, j += 2)
+        c[i] = LUTLerpRGB(LUTLoadRGB(values + lut.offsets[j]),
+                          LUTLoadRGB(values + lut.offsets[j + 1]),
+                          d0[0], d1[0]);
+    for (unsigned char k = 1; k < nDims; k++) {
+        count >>= 1;
+        for (unsigned int i = 0, j = 0; i < count; i++, j += 2)
+            c[i] = LUTLerpRGB(c[j], c[j + 1], d0[k], d1[k]);
+    }
+
+    LUTStoreRGB(c[0], rgb);
+}
+
 #undef LUT_LERP
 #undef LUT_LERP_1D
 #undef LUT_LERP_2D
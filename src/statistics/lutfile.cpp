@@ -0,0 +1,247 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// statistics/lutfile.cpp*
+#include "statistics/lutfile.h"
+#include "stats.h"
+
+#include <string.h>
+#ifdef PBRT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#include <fstream>
+#include <map>
+#include <mutex>
+
+namespace pbrt {
+
+STAT_MEMORY_COUNTER("Memory/Albedo LUT files", lutFileMemory);
+
+static bool ValidateLUTFileHeader(
+    const LUTFileHeader &header,
+    const size_t         fileLength,
+    const std::string   &filename
+) {
+    if (memcmp(header.magic, LUTFileMagic, sizeof(LUTFileMagic)) != 0) {
+        Error("%s: not a LUT file", filename.c_str());
+        return false;
+    }
+    if (header.version != LUTFileVersion) {
+        Error("%s: unsupported LUT file version %u (expected %u)",
+              filename.c_str(), header.version, LUTFileVersion);
+        return false;
+    }
+    if (header.nDims == 0 || header.nDims > LUTFileMaxDims) {
+        Error("%s: invalid number of dimensions (%u)", filename.c_str(),
+              header.nDims);
+        return false;
+    }
+
+    // Lookups use unsigned char indices per dimension and unsigned int
+    // linear indices.
+    uint64_t nValues = 1;
+    for (uint32_t i = 0; i < header.nDims; i++) {
+        if (header.lengths[i] < 2 || header.lengths[i] > 256) {
+            Error("%s: invalid length %u of dimension %u", filename.c_str(),
+                  header.lengths[i], i);
+            return false;
+        }
+        nValues *= header.lengths[i];
+    }
+    if (nValues != header.nValues || nValues > (uint64_t)UINT32_MAX + 1) {
+        Error("%s: invalid number of values", filename.c_str());
+        return false;
+    }
+    if (header.dataOffset < sizeof(LUTFileHeader) ||
+        header.dataOffset % sizeof(float) != 0 ||
+        header.dataOffset + nValues * sizeof(float) > fileLength) {
+        Error("%s: file is truncated or has an invalid data offset",
+              filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// LUTFile Method Definitions
+std::unique_ptr<LUTFile> LUTFile::Read(const std::string &filename) {
+    std::unique_ptr<LUTFile> lutFile(new LUTFile());
+    LUTFileHeader header;
+
+#if defined(PBRT_HAVE_MMAP) && !defined(PBRT_FLOAT_AS_DOUBLE)
+    // Map the whole file; pages of the LUT are only read once accessed.
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        Error("%s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+    struct stat stat;
+    if (fstat(fd, &stat) != 0 || (size_t)stat.st_size < sizeof(header)) {
+        Error("%s: unable to determine file size or file too small",
+              filename.c_str());
+        close(fd);
+        return nullptr;
+    }
+    const size_t length = stat.st_size;
+    void *ptr = mmap(0, length, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        Error("%s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+    lutFile->mapping       = ptr;
+    lutFile->mappingLength = length;
+
+    memcpy(&header, ptr, sizeof(header));
+    if (!ValidateLUTFileHeader(header, length, filename))
+        return nullptr;
+
+    lutFile->values = (const Float *)((const char *)ptr + header.dataOffset);
+#else
+    // Read and convert the values if mapping is not possible.
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        Error("%s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+    in.seekg(0, std::ios::end);
+    const size_t length = in.tellg();
+    in.seekg(0, std::ios::beg);
+    if (length < sizeof(header) ||
+        !in.read((char *)&header, sizeof(header)) ||
+        !ValidateLUTFileHeader(header, length, filename))
+        return nullptr;
+
+    std::vector<float> values(header.nValues);
+    in.seekg(header.dataOffset, std::ios::beg);
+    if (!in.read((char *)&values[0], header.nValues * sizeof(float))) {
+        Error("%s: unable to read LUT values", filename.c_str());
+        return nullptr;
+    }
+    lutFile->data.assign(values.begin(), values.end());
+    lutFile->values = &lutFile->data[0];
+#endif
+    lutFileMemory += header.nValues * sizeof(Float);
+
+    // Calculate LUT parameters
+    lutFile->nDims = header.nDims;
+    lutFile->maxIndices.resize(header.nDims);
+    for (unsigned char i = 0; i < header.nDims; i++)
+        lutFile->maxIndices[i] = header.lengths[i] - 1;
+
+    const unsigned int offsetCount = 1u << header.nDims;
+    lutFile->offsets.resize(offsetCount);
+    for (unsigned int i = 0; i < offsetCount; i++) {
+        unsigned int offset = 0, increment = 1;
+        for (unsigned char j = 0; j < header.nDims; j++) {
+            if ((i >> j) & 1)
+                offset += increment;
+            increment *= header.lengths[j];
+        }
+        lutFile->offsets[i] = offset;
+    }
+
+    return lutFile;
+}
+
+LUTFile::~LUTFile() {
+#ifdef PBRT_HAVE_MMAP
+    if (mapping && mappingLength > 0)
+        if (munmap(mapping, mappingLength) != 0)
+            Error("munmap: %s", strerror(errno));
+#endif
+}
+
+bool WriteLUTFile(
+    const std::string               &filename,
+    const std::string               &name,
+    const std::vector<unsigned int> &lengths,
+    const std::vector<float>        &values
+) {
+    LUTFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LUTFileMagic, sizeof(LUTFileMagic));
+    header.version = LUTFileVersion;
+    header.nDims   = lengths.size();
+    if (header.nDims == 0 || header.nDims > LUTFileMaxDims) {
+        Error("%s: invalid number of dimensions (%u)", filename.c_str(),
+              header.nDims);
+        return false;
+    }
+    header.nValues = 1;
+    for (uint32_t i = 0; i < header.nDims; i++) {
+        header.lengths[i] = lengths[i];
+        header.nValues *= lengths[i];
+    }
+    if (header.nValues != values.size()) {
+        Error("%s: expected %llu values, got %zu", filename.c_str(),
+              (unsigned long long)header.nValues, values.size());
+        return false;
+    }
+    header.dataOffset = sizeof(header);
+    strncpy(header.name, name.c_str(), sizeof(header.name) - 1);
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.write((const char *)&header, sizeof(header)) ||
+        !out.write((const char *)&values[0], values.size() * sizeof(float))) {
+        Error("%s: unable to write LUT file", filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+struct AlbedoLUTEntry {
+    std::unique_ptr<LUTFile> file;
+    LUT                      lut;
+};
+
+static std::mutex                            albedoLUTMutex;
+static std::map<std::string, AlbedoLUTEntry> albedoLUTs;
+
+const LUT &GetAlbedoLUT(
+    const std::string   &name,
+    const unsigned char  nDims,
+    const LUT           &fallback
+) {
+    std::lock_guard<std::mutex> lock(albedoLUTMutex);
+
+    auto iter = albedoLUTs.find(name);
+    if (iter != albedoLUTs.end())
+        return iter->second.lut;
+
+    // First use: try to map the LUT file
+    AlbedoLUTEntry &entry = albedoLUTs[name];
+    entry.lut = fallback;
+    if (!PbrtOptions.lutDir.empty()) {
+        const std::string filename =
+            PbrtOptions.lutDir + "/" + name + "albedo.lut";
+        if (std::ifstream(filename).good()) {
+            std::unique_ptr<LUTFile> file = LUTFile::Read(filename);
+            if (file && file->GetLUT().nDims != nDims)
+                Error("%s: LUT has %d dimensions, but %d are required",
+                      filename.c_str(), file->GetLUT().nDims, nDims);
+            else if (file) {
+                LOG(INFO) << "Using albedo LUT file " << filename;
+                entry.file = std::move(file);
+                entry.lut  = entry.file->GetLUT();
+            }
+        } else if (fallback.values)
+            Warning("%s: LUT file not found; using compiled-in LUT",
+                    filename.c_str());
+    }
+
+    if (!entry.lut.values) {
+        Error("No albedo LUT available for \"%s\" (compiled-in LUTs are "
+              "disabled and no LUT file was found via --lutdir)",
+              name.c_str());
+        exit(1);
+    }
+
+    return entry.lut;
+}
+
+}  // namespace pbrt
@@ -0,0 +1,88 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_STATISTICS_LUTFILE_H
+#define PBRT_STATISTICS_LUTFILE_H
+
+// statistics/lutfile.h*
+#include "pbrt.h"
+#include "statistics/lut.h"
+#include <cstdint>
+
+namespace pbrt {
+
+// A LUT file consists of a LUTFileHeader followed by the LUT values as 32-bit
+// floats. The values are stored in the same order as in the compiled-in
+// arrays, i.e., the first dimension varies fastest. The version has to be
+// incremented whenever the layout changes.
+static PBRT_CONSTEXPR char          LUTFileMagic[8] = {'P', 'B', 'R', 'T', 'L', 'U', 'T', '\0'};
+static PBRT_CONSTEXPR uint32_t      LUTFileVersion  = 1;
+static PBRT_CONSTEXPR unsigned char LUTFileMaxDims  = 16;
+
+struct LUTFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nDims;
+    uint32_t lengths[LUTFileMaxDims];
+    uint64_t nValues;
+    uint64_t dataOffset;   // Byte offset of the values from the file start
+    char     name[32];     // Name of the material (informative only)
+};
+static_assert(sizeof(LUTFileHeader) == 128, "Unexpected LUTFileHeader size");
+
+// LUTFile Declarations
+class LUTFile {
+  public:
+    // LUTFile Public Methods
+    static std::unique_ptr<LUTFile> Read(const std::string &filename);
+    ~LUTFile();
+    LUT GetLUT() const {
+        return {values, nDims, &maxIndices[0], &offsets[0]};
+    }
+
+  private:
+    // LUTFile Private Methods
+    LUTFile() {}
+
+    // LUTFile Private Data
+    void                      *mapping       = nullptr;
+    size_t                     mappingLength = 0;
+    std::vector<Float>         data; // Used if the values cannot be mapped
+    const Float               *values = nullptr;
+    unsigned char              nDims  = 0;
+    std::vector<unsigned char> maxIndices;
+    std::vector<unsigned int>  offsets;
+};
+
+bool WriteLUTFile(
+    const std::string               &filename,
+    const std::string               &name,
+    const std::vector<unsigned int> &lengths,
+    const std::vector<float>        &values
+);
+
+// Returns the albedo LUT of the material _name_ (e.g., "metal"). At the first
+// call for a material, "<lutdir>/<name>albedo.lut" is memory-mapped if
+// --lutdir is given and the file exists; otherwise, _fallback_ (the
+// compiled-in LUT) is used. The returned LUT stays valid until exit.
+const LUT &GetAlbedoLUT(
+    const std::string   &name,
+    const unsigned char  nDims,
+    const LUT           &fallback
+);
+
+#ifdef PBRT_EMBED_ALBEDO_LUTS
+#define ALBEDO_LUT_FALLBACK(prefix) \
+    LUT{&prefix##AlbedoLUT[0], prefix##AlbedoLUTNDims, \
+        &prefix##AlbedoLUTMaxIndices[0], &prefix##AlbedoLUTOffsets[0]}
+#else
+#define ALBEDO_LUT_FALLBACK(prefix) LUT{}
+#endif
+
+}  // namespace pbrt
+
+#endif  // PBRT_STATISTICS_LUTFILE_H
@@ -0,0 +1,121 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#ifndef PBRT_STATISTICS_LUTS_PRECOMPUTEALBEDO_ALBEDOCHECKPOINT_H
+#define PBRT_STATISTICS_LUTS_PRECOMPUTEALBEDO_ALBEDOCHECKPOINT_H
+
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstdio>   // std::rename
+#include <cstring>  // memcmp
+#include <fstream>  // std::ifstream, std::ofstream
+#include <string>   // std::string
+#include <vector>   // std::vector
+
+// Binary checkpoint of a precomputealbedo run, shared by precomputealbedo
+// (which writes and resumes from it) and albedojson2dat (which converts and
+// merges it). For each LUT cell, it stores the estimator state, i.e., the sum
+// of f * |cos| / pdf and the number of samples. Checkpoints of runs with
+// different --seedoffset values are statistically independent and can
+// therefore be merged by adding sums and sample counts.
+//
+// Layout (native byte order): magic, version, nDims, lengths[nDims],
+// seedOffset, material name length, material name, nCells, and
+// nCells * (sumF, nF).
+static const char     AlbedoCheckpointMagic[8] = {'P', 'B', 'R', 'T', 'A', 'L', 'B', 'C'};
+static const uint32_t AlbedoCheckpointVersion  = 1;
+
+struct AlbedoCheckpointCell {
+    double   sumF = 0.;
+    uint64_t nF   = 0; // 0 if the cell has not been computed yet
+};
+
+struct AlbedoCheckpoint {
+    std::string                       materialName;
+    std::vector<uint32_t>             lengths;
+    uint64_t                          seedOffset = 0;
+    std::vector<AlbedoCheckpointCell> cells;
+
+    static bool IsCheckpoint(const std::string &filename) {
+        char magic[sizeof(AlbedoCheckpointMagic)];
+        std::ifstream in(filename, std::ios::binary);
+        return in.read(magic, sizeof(magic)) &&
+               memcmp(magic, AlbedoCheckpointMagic, sizeof(magic)) == 0;
+    }
+
+    bool Read(const std::string &filename) {
+        std::ifstream in(filename, std::ios::binary);
+        char magic[sizeof(AlbedoCheckpointMagic)];
+        uint32_t version, nDims, nameLength;
+        uint64_t nCells;
+        if (!in.read(magic, sizeof(magic)) ||
+            memcmp(magic, AlbedoCheckpointMagic, sizeof(magic)) != 0 ||
+            !in.read((char *)&version, sizeof(version)) ||
+            version != AlbedoCheckpointVersion ||
+            !in.read((char *)&nDims, sizeof(nDims)) || nDims > 16)
+            return false;
+        lengths.resize(nDims);
+        if (!in.read((char *)&lengths[0], nDims * sizeof(uint32_t)) ||
+            !in.read((char *)&seedOffset, sizeof(seedOffset)) ||
+            !in.read((char *)&nameLength, sizeof(nameLength)) ||
+            nameLength > 256)
+            return false;
+        materialName.resize(nameLength);
+        if (!in.read(&materialName[0], nameLength) ||
+            !in.read((char *)&nCells, sizeof(nCells)) ||
+            nCells != NumCells())
+            return false;
+        cells.resize(nCells);
+        for (AlbedoCheckpointCell &cell : cells)
+            if (!in.read((char *)&cell.sumF, sizeof(cell.sumF)) ||
+                !in.read((char *)&cell.nF, sizeof(cell.nF)))
+                return false;
+        return true;
+    }
+
+    // Writes to a temporary file first so that an interrupted write never
+    // destroys the previous checkpoint.
+    bool Write(const std::string &filename) const {
+        const std::string tmpFilename = filename + ".tmp";
+        {
+            std::ofstream out(tmpFilename, std::ios::binary);
+            const uint32_t nDims = lengths.size();
+            const uint32_t nameLength = materialName.size();
+            const uint64_t nCells = cells.size();
+            out.write(AlbedoCheckpointMagic, sizeof(AlbedoCheckpointMagic));
+            out.write((const char *)&AlbedoCheckpointVersion, sizeof(AlbedoCheckpointVersion));
+            out.write((const char *)&nDims, sizeof(nDims));
+            out.write((const char *)&lengths[0], nDims * sizeof(uint32_t));
+            out.write((const char *)&seedOffset, sizeof(seedOffset));
+            out.write((const char *)&nameLength, sizeof(nameLength));
+            out.write(materialName.data(), nameLength);
+            out.write((const char *)&nCells, sizeof(nCells));
+            for (const AlbedoCheckpointCell &cell : cells) {
+                out.write((const char *)&cell.sumF, sizeof(cell.sumF));
+                out.write((const char *)&cell.nF, sizeof(cell.nF));
+            }
+            if (!out)
+                return false;
+        }
+        return std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+    }
+
+    uint64_t NumCells() const {
+        uint64_t nCells = 1;
+        for (uint32_t length : lengths)
+            nCells *= length;
+        return nCells;
+    }
+
+    // Adds the samples of another run of the same LUT
+    bool Merge(const AlbedoCheckpoint &checkpoint) {
+        if (checkpoint.materialName != materialName ||
+            checkpoint.lengths != lengths)
+            return false;
+        for (size_t i = 0; i < cells.size(); i++) {
+            cells[i].sumF += checkpoint.cells[i].sumF;
+            cells[i].nF   += checkpoint.cells[i].nF;
+        }
+        return true;
+    }
+};
+
+#endif // PBRT_STATISTICS_LUTS_PRECOMPUTEALBEDO_ALBEDOCHECKPOINT_H
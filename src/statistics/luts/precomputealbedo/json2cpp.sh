@@ -10,7 +10,7 @@ PBRT_BUILD_PATH="../../../../build/pbrt-v3/"
 SCRIPT_LOG_PREFIX="[json2cpp.sh]"
 
 if [ "$#" -gt "2" -o "$#" -lt "1" ] ; then
-    echo "$SCRIPT_LOG_PREFIX Usage: bash json2cpp.sh /path/to/material.json"
+    echo "$SCRIPT_LOG_PREFIX Usage: bash json2cpp.sh /path/to/material.json|material.ckpt"
     exit
 fi
 
@@ -19,7 +19,8 @@ SCRIPT_PATH="$( cd "$( dirname "$0" )" && pwd )"
 echo "$SCRIPT_LOG_PREFIX Started: $( date )"
 echo "$SCRIPT_LOG_PREFIX Path: $SCRIPT_PATH"
 
-BASE_FILE_NAME="$( basename $1 .json )"
+BASE_FILE_NAME="$( basename $1 )"
+BASE_FILE_NAME="${BASE_FILE_NAME%.*}" # Strip .json or .ckpt
 
 ${PBRT_BUILD_PATH}/albedojson2dat $1 > "./${BASE_FILE_NAME}.dat"
 
@@ -2,14 +2,20 @@
 
 #include <float.h>      // LDBL_DIG
 
+#include <cmath>        // std::isnan
 #include <iomanip>      // std::setprecision
 #include <iostream>     // std::cout, std::endl
 #include <sstream>      // std::stringstream
 #include <string>       // std::string
+#include <vector>       // std::vector
 
 #include "rapidjson/document.h"
 #include "rapidjson/filereadstream.h"
 
+#include "statistics/lutfile.h" // WriteLUTFile
+
+#include "../albedocheckpoint.h"
+
 #ifdef LDBL_DECIMAL_DIG
     #define OP_LDBL_DECIMAL_DIG (LDBL_DECIMAL_DIG)
 #else  
@@ -22,6 +28,14 @@
 
 using namespace rapidjson;
 
+// Usage: albedojson2dat material.json [materialalbedo.lut]
+//        albedojson2dat material.ckpt [material2.ckpt ...] [materialalbedo.lut]
+// The input is either the JSON output of precomputealbedo or one or more
+// checkpoints written via --checkpoint. Checkpoints of runs with different
+// seed offsets are merged by adding their samples. Without an output file,
+// the values are printed as text (one "indices value" line per LUT entry) for
+// json2cpp.sh; otherwise, a binary LUT file is written that pbrt loads via
+// --lutdir.
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         std::cerr << "Please specify a file." << std::endl;
@@ -30,44 +44,111 @@ int main(int argc, char *argv[]) {
 
     std::cout << std::setprecision(OP_LDBL_DECIMAL_DIG); // Show enough digits for long double
 
-    FILE* fp = fopen(argv[1], "r"); // For non-Windows use "r"
+    std::vector<std::string> inputFilenames(argv + 1, argv + argc);
+    std::string lutFilename;
+    if (inputFilenames.size() > 1 && !AlbedoCheckpoint::IsCheckpoint(inputFilenames.back())) {
+        lutFilename = inputFilenames.back();
+        inputFilenames.pop_back();
+    }
+
+    std::string name;
+    std::vector<unsigned int> lutLengths;
+    std::vector<double> albedos;
+
+    if (AlbedoCheckpoint::IsCheckpoint(inputFilenames[0])) {
+        AlbedoCheckpoint checkpoint;
+        std::vector<uint64_t> seedOffsets;
+        for (const std::string &filename : inputFilenames) {
+            AlbedoCheckpoint input;
+            if (!input.Read(filename)) {
+                std::cerr << "Unable to read checkpoint \"" << filename << "\"." << std::endl;
+                return 1;
+            }
+            for (uint64_t seedOffset : seedOffsets)
+                if (seedOffset == input.seedOffset)
+                    std::cerr << "Warning: checkpoint \"" << filename << "\" has the same seed offset (" << seedOffset << ") as a previous one; its samples are not independent." << std::endl;
+            seedOffsets.push_back(input.seedOffset);
+
+            if (checkpoint.cells.empty())
+                checkpoint = std::move(input);
+            else if (!checkpoint.Merge(input)) {
+                std::cerr << "Checkpoint \"" << filename << "\" does not match the material or LUT size of the previous ones." << std::endl;
+                return 1;
+            }
+        }
 
-    char buffer[65536];
-    FileReadStream is(fp, buffer, sizeof(buffer));
+        name = checkpoint.materialName;
+        lutLengths.assign(checkpoint.lengths.begin(), checkpoint.lengths.end());
+        albedos.resize(checkpoint.cells.size());
+        for (size_t i = 0; i < checkpoint.cells.size(); i++) {
+            if (checkpoint.cells[i].nF == 0) {
+                std::cerr << "Checkpoint is incomplete (cell " << i << " has no samples); resume precomputealbedo first." << std::endl;
+                return 1;
+            }
+            albedos[i] = checkpoint.cells[i].sumF / checkpoint.cells[i].nF;
+        }
+    } else {
+        FILE* fp = fopen(inputFilenames[0].c_str(), "r"); // For non-Windows use "r"
+        if (!fp) {
+            std::cerr << "Unable to open \"" << inputFilenames[0] << "\"." << std::endl;
+            return 1;
+        }
 
-    Document d;
-    d.ParseStream(is);
+        char buffer[65536];
+        FileReadStream is(fp, buffer, sizeof(buffer));
 
-    fclose(fp);
+        Document d;
+        d.ParseStream(is);
 
-    if (d.HasParseError()) {
-        std::cout << "Parse error " << d.GetParseError() << " at offset " << d.GetErrorOffset() << "encountered.\n";
-        return 1;
+        fclose(fp);
+
+        if (d.HasParseError()) {
+            std::cout << "Parse error " << d.GetParseError() << " at offset " << d.GetErrorOffset() << "encountered.\n";
+            return 1;
+        }
+
+
+        const Value &results = d["results"];    
+        assert(results.IsArray());
+
+        const unsigned int nDims = d["nDims"].GetInt();
+        for (unsigned int i = 0; i < nDims; i++)
+            lutLengths.push_back(d["lengths"][i].GetInt());
+
+        albedos.resize(results.Size());
+        for (SizeType i = 0; i < results.Size(); i++)
+            albedos[i] = results[i]["albedo"].GetDouble();
+
+        name = d.HasMember("materialName") ? d["materialName"].GetString() : "";
     }
 
+    if (!lutFilename.empty()) {
+        std::vector<float> values(albedos.size());
+        for (size_t i = 0; i < albedos.size(); i++)
+            values[i] = std::isnan(albedos[i]) ? 0.f : (float)albedos[i];
 
-    const Value &results = d["results"];    
-    assert(results.IsArray());
+        return pbrt::WriteLUTFile(lutFilename, name, lutLengths, values) ? 0 : 1;
+    }
 
-    const unsigned int nDims = d["nDims"].GetInt();
+    const unsigned int nDims = lutLengths.size();
 
     unsigned int* indices       = (unsigned int*) alloca(sizeof(unsigned int) * nDims);
     unsigned int* lengths       = (unsigned int*) alloca(sizeof(unsigned int) * nDims);
 
     for (unsigned int i = 0; i < nDims; i++) {
         indices[i] = 0;
-        lengths[i] = d["lengths"][i].GetInt();
+        lengths[i] = lutLengths[i];
     }
 
     unsigned int dimIndex = 0;
 
-    for (SizeType i = 0; i < results.Size(); i++) {
+    for (size_t i = 0; i < albedos.size(); i++) {
         std::stringstream indexStream;
         for (int j = nDims - 1; j >= 0; j--)
             indexStream << indices[j] << " ";
         std::string indexString = indexStream.str();
 
-        std::cout << indexString << results[i]["albedo"].GetDouble() << std::endl;
+        std::cout << indexString << albedos[i] << std::endl;
 
         indices[0]++;
 
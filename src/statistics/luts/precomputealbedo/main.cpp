@@ -1,16 +1,24 @@
 // © 2024-2025 Hiroyuki Sakai
 
 #include <float.h>  // LDBL_DIG
+#include <atomic>   // std::atomic
 #include <chrono>   // std::chrono
+#include <condition_variable> // std::condition_variable
+#include <fstream>  // std::ifstream
 #include <iomanip>  // std::setprecision
 #include <iostream> // std::cout, std::endl
+#include <map>      // std::map
+#include <mutex>    // std::mutex
+#include <sstream>  // std::ostringstream
 #include <string>   // std::string
 #include <thread>   // std::thread
+#include <vector>   // std::vector
 
 #include "pbrt.h"
-#include "geometry.h" // Vector, ...
-#include "memory.h"   // MemoryArena
-#include "parallel.h" // NumSystemCores()
+#include "geometry.h"       // Vector, ...
+#include "lowdiscrepancy.h" // SobolSampleFloat()
+#include "memory.h"         // MemoryArena
+#include "parallel.h"       // NumSystemCores()
 
 #include "materials/disney.h"
 #include "materials/fourier.h"
@@ -29,6 +37,8 @@
 #include "samplers/random.h"   // RNG
 #include "textures/constant.h" // ConstantTexture
 
+#include "albedocheckpoint.h"
+
 #if defined LDBL_DECIMAL_DIG
     #define OP_LDBL_DECIMAL_DIG (LDBL_DECIMAL_DIG)
 #elif defined DECIMAL_DIG
@@ -42,10 +52,11 @@ using namespace pbrt;
 typedef long double MyFloat;
 typedef unsigned long long MyCount;
 
-static PBRT_CONSTEXPR long long DefaultNSamplesPerThread = 10000l;
+static PBRT_CONSTEXPR long long DefaultNSamplesPerCell   = 65536l; // Powers of two are best for the Sobol sampler
 static PBRT_CONSTEXPR long long DefaultBenchmarkNSamples = 100000000l;
+static PBRT_CONSTEXPR int       DefaultCheckpointInterval = 300; // In seconds
 
-static PBRT_CONSTEXPR char         LutWidth           = 8;
+static PBRT_CONSTEXPR char         DefaultLutWidth    = 8;
 static PBRT_CONSTEXPR long double  LutCheckThreshold  = 0.05l;
 static PBRT_CONSTEXPR unsigned int PbrtCheckNSamples  = 512;
 static PBRT_CONSTEXPR long double  PbrtCheckThreshold = 0.05l;
@@ -55,23 +66,31 @@ static PBRT_CONSTEXPR char JsonInd2[] = "    ";
 static PBRT_CONSTEXPR char JsonInd3[] = "      ";
 static PBRT_CONSTEXPR char ProgressBarWidth   = 10;
 
+// Hash function to derive independent per-cell seeds and scrambles from
+// the seed offset and the cell index
+static uint64_t MixBits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ull;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= (v >> 33);
+    return v;
+}
+
+static uint64_t CellSeed(const MyCount seedOffset, const MyCount cell) {
+    return MixBits(MixBits(seedOffset) + cell);
+}
+
 class Indexer {
     public:
-        Indexer(const unsigned char nDims, const bool testLUT) : 
+        Indexer(const unsigned char nDims, const unsigned char lutWidth, const bool testLUT) : 
             nDims(nDims),
+            indices(nDims, 0),
+            lengths(nDims, lutWidth),
+            maxIndices(nDims),
             testLUT(testLUT),
             rng(RNG())
         {
-            indices    = new unsigned char[nDims];
-            lengths    = new unsigned char[nDims];
-            maxIndices = new unsigned char[nDims];
-
-            for (unsigned char i = 0; i < nDims; i++) {
-                indices[i] = 0;
-                lengths[i] = LutWidth;
-                maxIndices[i] = lengths[i] - 1;
-            }
-
 // For setting the lengths individually
 #if 0
             const std::string materialName = "";
@@ -128,11 +147,9 @@ class Indexer {
                 lengths[7] = 8; // eta [1+Epsilon/2.42]
             }
 #endif
-        }
-        ~Indexer() {
-            delete indices;
-            delete lengths;
-            delete maxIndices;
+
+            for (unsigned char i = 0; i < nDims; i++)
+                maxIndices[i] = lengths[i] - 1;
         }
         MyFloat GetFloat(const unsigned char i, Float v1 = 0., Float v2 = 1.) {
             Float t = testLUT ? rng.UniformFloat() : (Float)indices[i] / maxIndices[i];
@@ -142,27 +159,30 @@ class Indexer {
             Spectrum t = testLUT ? RandomSpectrum() : Spectrum((MyFloat)indices[i] / maxIndices[i]);
             return Lerp(t, v1, v2);
         }
-        bool Increment() {
-            indices[0]++;
-
-            while (indices[dimIndex] == lengths[dimIndex]) {
-                if (dimIndex == nDims - 1)
-                    return false;
-            
-                indices[dimIndex++] = 0;
-                indices[dimIndex]++;
+        MyCount NumCells() const {
+            MyCount nCells = 1;
+            for (unsigned char i = 0; i < nDims; i++)
+                nCells *= lengths[i];
+            return nCells;
+        }
+        // Selects the cell with the given linear index (the first dimension
+        // varies fastest, as in the LUTs). With --testlut, the RNG for the
+        // random material parameters is reseeded so that the parameters of a
+        // cell do not depend on which thread computes it.
+        void SetCell(MyCount cell, const uint64_t seed) {
+            for (unsigned char i = 0; i < nDims; i++) {
+                indices[i] = cell % lengths[i];
+                cell /= lengths[i];
             }
-
-            dimIndex = 0;
-
-            return true;
+            if (testLUT)
+                rng.SetSequence(seed);
         }
 
         const unsigned char nDims;
 
-        unsigned char *indices    = nullptr;
-        unsigned char *lengths    = nullptr;
-        unsigned char *maxIndices = nullptr;
+        std::vector<unsigned char> indices;
+        std::vector<unsigned char> lengths;
+        std::vector<unsigned char> maxIndices;
 
     private:
         Spectrum RandomSpectrum() {
@@ -181,8 +201,6 @@ class Indexer {
 
         const bool testLUT;
         RNG rng;
-
-        unsigned char dimIndex = 0;
 };
 
 void PrintHoursMinutesSeconds(const float seconds) {
@@ -229,25 +247,27 @@ void PrintProgress(
     std::clog.flush();
 }
 
-void BenchmarkLUT(
+double BenchmarkLUT(
     const Material *material,
     SurfaceInteraction *isect,
     const unsigned int nSamples,
-    const bool full = false
+    const bool perChannel = false
 ) {
-    std::clog << "Benchmarking " << nSamples << " LUT lookups..." << std::endl;
+    std::clog << "Benchmarking " << nSamples << " LUT lookups" <<
+                 (perChannel ? " (per channel)" : "") << "..." << std::endl;
     Spectrum albedo;
     auto startTime = std::chrono::high_resolution_clock::now();
     for (unsigned int i = 0; i < nSamples; i++)
-        // if (full)
-        //     albedo += material->GetAlbedoFull(isect);
-        // else
-            albedo += material->GetAlbedo(isect);
+        if (perChannel)
+            albedo += material->GetAlbedoPerChannel(isect);
+        else
+            albedo += material->Material::GetAlbedo(isect);
     std::chrono::duration<double> duration = std::chrono::high_resolution_clock::now() - startTime;
     std::clog << "Result: " << albedo.y() << std::endl;
     std::clog << "Elapsed time: ";
     PrintHoursMinutesSeconds(duration.count());
-    std::clog << std::endl;
+    std::clog << " (" << duration.count() << " s)" << std::endl;
+    return duration.count();
 }
 
 void BenchmarkPBRT(
@@ -275,26 +295,297 @@ void BenchmarkPBRT(
 
 const Vector3f normal(0.l, 0.l, 1.l);
 
-void SampleAlbedo(
-    const unsigned char threadId,
+enum class AlbedoSampler { Sobol, Random };
+
+// Estimates the albedo (of the first channel) with nSamples samples of the
+// BSDF. The Sobol sampler uses the first two Sobol dimensions with a random
+// XOR scramble per cell (randomized QMC), so that runs with different seed
+// offsets yield independent estimates that can be merged.
+MyFloat SampleAlbedo(
+    const AlbedoSampler sampler,
+    const uint64_t seed,
     const BSDF *bsdf,
     const Vector3f wo,
-    const MyCount nSamples,
-    MyFloat *sumF
+    const MyCount nSamples
 ) {
-    RNG rng(threadId);
+    RNG rng(seed);
+    const uint32_t scrambles[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
 
     Vector3f wi;
     BxDFType flags;
-    *sumF = 0.l;
+    MyFloat sumF = 0.l;
     for (MyCount i = 0; i < nSamples; i++) {
+        const Point2f u = sampler == AlbedoSampler::Sobol ?
+            Point2f(SobolSampleFloat(i, 0, scrambles[0]), SobolSampleFloat(i, 1, scrambles[1])) :
+            Point2f(rng.UniformFloat(), rng.UniformFloat());
         Float pdf = 0.; // Use Float here, because the output from Sample_f is a Float
-        const Spectrum f = bsdf->Sample_f(wo, &wi, {rng.UniformFloat(), rng.UniformFloat()}, &pdf, BSDF_ALL, &flags);
+        const Spectrum f = bsdf->Sample_f(wo, &wi, u, &pdf, BSDF_ALL, &flags);
         Float fRGB[3];
         f.ToRGB(fRGB);
         if (pdf > 0.l && fRGB[0] > 0.l)
-            *sumF += fRGB[0] * AbsCosTheta(wi) / pdf;
+            sumF += fRGB[0] * AbsCosTheta(wi) / pdf;
+    }
+    return sumF;
+}
+
+unsigned char GetNDims(const std::string &materialName) {
+    if      (materialName == "GlassMaterial")       return 6;
+    else if (materialName == "HairMaterial")        return 4;
+    else if (materialName == "MatteMaterial")       return 2;
+    else if (materialName == "MetalMaterial")       return 5;
+    else if (materialName == "MirrorMaterial")      return 2;
+    else if (materialName == "PlasticMaterial")     return 4;
+    else if (materialName == "SubstrateMaterial")   return 5;
+    else if (materialName == "TranslucentMaterial") return 6;
+    else if (materialName == "UberMaterial")        return 8;
+    return 1;
+}
+
+// Creates the material for the current cell of ind and computes its BSDF
+// for the outgoing direction (stored in wo and isect). The caller owns the
+// returned material.
+Material *SetupCell(
+    const std::string &materialName,
+    Indexer &ind,
+    MemoryArena &arena,
+    SurfaceInteraction *isect,
+    Vector3f *wo
+) {
+    const MyFloat woz = ind.GetFloat(0, CosEpsilon, 1.l);
+    *wo = Normalize(Vector3f(std::sqrt(1.l - woz * woz), 0.l, woz)); // We do not consider anisotropic materials
+
+    // Setup material
+    Material *material = nullptr;
+    if (materialName == "GlassMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kr      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Spectrum>> kt      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
+        const std::shared_ptr<Texture<Float>> uRoughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> vRoughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> index      = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (5, 1.l + Epsilon,      2.42l));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new GlassMaterial(kr, kt, uRoughness, vRoughness, index, bumpMap, remapRoughness);
+    } else if (materialName == "HairMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> sigmaA   = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1, Epsilon, 1.l));
+        const std::shared_ptr<Texture<Spectrum>> color    = nullptr;
+        const std::shared_ptr<Texture<Float>> eumelanin   = nullptr;
+        const std::shared_ptr<Texture<Float>> pheomelanin = nullptr;
+        const std::shared_ptr<Texture<Float>> eta         = std::make_shared<ConstantTexture<Float>>(1.55l);
+        const std::shared_ptr<Texture<Float>> betaM       = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(2, Epsilon, 1.l));
+        const std::shared_ptr<Texture<Float>> betaN       = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(3, Epsilon, 1.l));
+        const std::shared_ptr<Texture<Float>> alpha       = std::make_shared<ConstantTexture<Float>>(2.l);
+
+        material = new HairMaterial(sigmaA, color, eumelanin, pheomelanin, eta, betaM, betaN, alpha);
+    } else if (materialName == "MatteMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kd   = std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.l));
+        const std::shared_ptr<Texture<Float>> sigma   = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(1, 0.l, 90.l));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+
+        material = new MatteMaterial(kd, sigma, bumpMap);
+    } else if (materialName == "MetalMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> eta     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1, Epsilon, 7.14l));
+        const std::shared_ptr<Texture<Spectrum>> k       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2, Epsilon, 8.62l));
+        const std::shared_ptr<Texture<Float>> roughness  = nullptr;
+        const std::shared_ptr<Texture<Float>> uRoughness = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> vRoughness = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new MetalMaterial(eta, k, roughness, uRoughness, vRoughness, bumpMap, remapRoughness);
+    } else if (materialName == "MirrorMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kr = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+
+        material = new MirrorMaterial(kr, bumpMap);
+    } else if (materialName == "PlasticMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kd     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Spectrum>> ks     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
+        const std::shared_ptr<Texture<Float>> roughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new PlasticMaterial(kd, ks, roughness, bumpMap, remapRoughness);
+    } else if (materialName == "SubstrateMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kd = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Spectrum>> ks = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
+        const std::shared_ptr<Texture<Float>> nu    = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> nv    = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new SubstrateMaterial(kd, ks, nu, nv, bumpMap, remapRoughness);
+    } else if (materialName == "TranslucentMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kd       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Spectrum>> ks       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
+        const std::shared_ptr<Texture<Float>> roughness   = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Spectrum>> reflect  = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(4));
+        const std::shared_ptr<Texture<Spectrum>> transmit = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(5));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new TranslucentMaterial(kd, ks, roughness, reflect, transmit, bumpMap, remapRoughness);
+    } else if (materialName == "UberMaterial") {
+        const std::shared_ptr<Texture<Spectrum>> kd      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
+        const std::shared_ptr<Texture<Spectrum>> ks      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
+        const std::shared_ptr<Texture<Spectrum>> kr      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(3));
+        const std::shared_ptr<Texture<Spectrum>> kt      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(4));
+        const std::shared_ptr<Texture<Float>> roughness  = nullptr;
+        const std::shared_ptr<Texture<Float>> roughnessu = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(5, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Float>> roughnessv = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(6, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
+        const std::shared_ptr<Texture<Spectrum>> opacity = std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.l));
+        const std::shared_ptr<Texture<Float>> eta        = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(7, 1.l + Epsilon, 2.42l));
+        const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
+        const bool remapRoughness = false;
+
+        material = new UberMaterial(kd, ks, kr, kt, roughness, roughnessu, roughnessv, opacity, eta, bumpMap, remapRoughness);
+    }
+
+    // Setup BSDF
+    *isect = SurfaceInteraction(Point3f (0.l, 0.l, 0.l), // p
+                                Vector3f(0.l, 0.l, 0.l), // pError
+                                Point2f (0.l, 0.l),      // uv
+                                *wo,                     // wo
+                                Vector3f(1.l, 0.l, 0.l), // dpdu
+                                Vector3f(0.l, 1.l, 0.l), // dpdv
+                                Normal3f(0.l, 0.l, 0.l), // dndu
+                                Normal3f(0.l, 0.l, 0.l), // dndv
+                                MyFloat (0.l),           // time
+                                nullptr);                // shape
+    material->ComputeScatteringFunctions(isect, arena, TransportMode::Radiance, false);
+
+    return material;
+}
+
+struct PrecomputeSettings {
+    std::string   materialName;
+    unsigned char lutWidth;
+    AlbedoSampler sampler;
+    MyCount       nSamples;
+    MyCount       seedOffset;
+    bool          compareToPBRT;
+    bool          testLUT;
+};
+
+struct CellResult {
+    MyFloat     sumF = 0.l;
+    MyCount     nF   = 0;
+    std::string indexString;
+    Float       lutAlbedoRGB[3];
+#ifdef PBRT_STATISTICS_FULL_LOOKUPS
+    Float       lutFullAlbedoRGB[3];
+#endif
+    Float       pbrtAlbedoRGB[3];
+    std::string warnings; // Printed by the main thread to keep them in order
+};
+
+// Computes a single LUT cell. If the cell has already been sampled in a
+// previous (checkpointed) run, only the checks are performed.
+CellResult ComputeCell(
+    const PrecomputeSettings &settings,
+    const MyCount cell,
+    const AlbedoCheckpointCell previous
+) {
+    CellResult result;
+    std::ostringstream warnings;
+    warnings << std::setprecision(OP_LDBL_DECIMAL_DIG);
+
+    const uint64_t seed = CellSeed(settings.seedOffset, cell);
+    Indexer ind(GetNDims(settings.materialName), settings.lutWidth, settings.testLUT);
+    ind.SetCell(cell, seed);
+
+    MemoryArena arena;
+    SurfaceInteraction isect;
+    Vector3f wo;
+    Material *material = SetupCell(settings.materialName, ind, arena, &isect, &wo);
+    const BSDF *bsdf = isect.bsdf;
+
+    // Calculate albedo
+    if (previous.nF > 0) {
+        result.sumF = previous.sumF;
+        result.nF   = previous.nF;
+    } else {
+        result.sumF = SampleAlbedo(settings.sampler, MixBits(seed), bsdf, wo, settings.nSamples);
+        result.nF   = settings.nSamples;
+    }
+    const MyFloat albedo = result.sumF / result.nF;
+
+
+    // Checks
+    if (albedo > 1.l)
+        warnings << "Warning: calculated albedo " << albedo << " is greater than 1." << std::endl;
+
+    Float lutRGBAlbedoRGB[3], lutPerChannelAlbedoRGB[3];
+    material->GetAlbedo(&isect).ToRGB(result.lutAlbedoRGB);
+    material->Material::GetAlbedo(&isect).ToRGB(lutRGBAlbedoRGB);
+    material->GetAlbedoPerChannel(&isect).ToRGB(lutPerChannelAlbedoRGB);
+    for (unsigned char c = 0; c < 3; c++)
+        if (std::abs(lutRGBAlbedoRGB[c] - lutPerChannelAlbedoRGB[c]) > 1e-5f)
+            warnings << "Warning: RGB LUT lookup (" << lutRGBAlbedoRGB[c] << ") differs from per-channel LUT lookup (" << lutPerChannelAlbedoRGB[c] << ")." << std::endl;
+#ifdef PBRT_STATISTICS_FULL_LOOKUPS
+    material->GetAlbedoFull(&isect).ToRGB(result.lutFullAlbedoRGB);
+#endif
+    delete material;
+    if (std::abs(albedo - result.lutAlbedoRGB[0]) > LutCheckThreshold)
+        warnings << "Warning: calculated albedo " << albedo << " is significantly different from LUT albedo (" << result.lutAlbedoRGB[0] << ")." << std::endl;
+
+    if (settings.compareToPBRT) {
+        RNG rng(0);
+        Point2f rhoSamples[PbrtCheckNSamples];
+        for (unsigned int i = 0; i < PbrtCheckNSamples; i++)
+            rhoSamples[i] = Point2f(rng.UniformFloat(), rng.UniformFloat());
+
+        const Spectrum pbrtAlbedo = bsdf->rho(wo, PbrtCheckNSamples, rhoSamples, BSDF_ALL);
+        pbrtAlbedo.ToRGB(result.pbrtAlbedoRGB);
+
+        if (std::abs(albedo - result.pbrtAlbedoRGB[0]) > PbrtCheckThreshold)
+            warnings << "Warning: calculated albedo " << albedo << " is significantly different from pbrt's rho (" << result.pbrtAlbedoRGB[0] << ")." << std::endl;
+    }
+
+#ifdef PBRT_STATISTICS_FULL_LOOKUPS
+    if (std::abs(result.lutFullAlbedoRGB[0] - result.lutAlbedoRGB[0]) > LutCheckThreshold ||
+        std::abs(result.lutFullAlbedoRGB[1] - result.lutAlbedoRGB[1]) > LutCheckThreshold ||
+        std::abs(result.lutFullAlbedoRGB[2] - result.lutAlbedoRGB[2]) > LutCheckThreshold) {
+        std::cerr << "Fatal: found a significant difference between reduced LUT and full LUT." << std::endl;
+        exit(1);
     }
+#endif
+
+    if (!settings.testLUT)
+        for (unsigned char i = 0; i < ind.nDims; i++) {
+            result.indexString += std::to_string(ind.GetFloat(i));
+            if (i < ind.nDims - 1)
+                result.indexString += " ";
+        }
+    result.warnings = warnings.str();
+
+    return result;
+}
+
+void PrintCellResult(const PrecomputeSettings &settings, const CellResult &result) {
+    const MyFloat albedo = result.sumF / result.nF;
+
+    std::cout << JsonInd2 << "{" << std::endl;
+    if (!settings.testLUT)
+        std::cout << JsonInd3 << "\"indices\": \"" << result.indexString << "\"," << std::endl;
+    std::cout << JsonInd3 << "\"albedo\":             " << albedo << "," << std::endl;
+    std::cout << JsonInd3 << "\"albedo (LUT)\":      \"" << result.lutAlbedoRGB[0]     << " " << result.lutAlbedoRGB[1]     << " " << result.lutAlbedoRGB[2]     << "\"," << std::endl;
+#ifdef PBRT_STATISTICS_FULL_LOOKUPS
+    std::cout << JsonInd3 << "\"albedo (full LUT)\": \"" << result.lutFullAlbedoRGB[0] << " " << result.lutFullAlbedoRGB[1] << " " << result.lutFullAlbedoRGB[2] << "\"," << std::endl;
+#endif
+    if (settings.compareToPBRT)
+        std::cout << JsonInd3 << "\"albedo (pbrt)\":     \"" << result.pbrtAlbedoRGB[0] << " " << result.pbrtAlbedoRGB[1] << " " << result.pbrtAlbedoRGB[2] << "\"," << std::endl;
+    std::cout << JsonInd3 << "\"sumF\": " << result.sumF << "," << std::endl;
+    std::cout << JsonInd3 << "\"nF\": " << result.nF << std::endl;
+    std::cout << JsonInd2 << "}";
+}
+
+bool WriteCheckpoint(const AlbedoCheckpoint &checkpoint, const std::string &filename) {
+    if (!checkpoint.Write(filename)) {
+        std::cerr << "Error: unable to write checkpoint \"" << filename << "\"." << std::endl;
+        return false;
+    }
+    return true;
 }
 
 
@@ -303,41 +594,62 @@ int main(int argc, char *argv[]) {
 
     std::cout << std::setprecision(OP_LDBL_DECIMAL_DIG); // Show enough digits for long double
 
-    std::string materialName = "MatteMaterial";
+    PrecomputeSettings settings;
+    settings.materialName  = "MatteMaterial";
+    settings.lutWidth      = DefaultLutWidth;
+    settings.sampler       = AlbedoSampler::Sobol;
+    settings.nSamples      = DefaultNSamplesPerCell;
+    settings.seedOffset    = 0;
+    settings.compareToPBRT = false;
+    settings.testLUT       = false;
     unsigned char nThreads = NumSystemCores();
-    MyCount nSamples = DefaultNSamplesPerThread;
-    MyCount seedOffset = 0;
-    bool compareToPBRT = false;
-    bool testLUT = false;
+    std::string checkpointFilename;
+    int checkpointInterval = DefaultCheckpointInterval;
     bool benchmark = false;
 
-    for (unsigned char i = 1; i < argc; ++i) {
+    for (int i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "--material"))
-            materialName = argv[++i];
+            settings.materialName = argv[++i];
         if (!strcmp(argv[i], "--nthreads"))
-            nThreads = atoi(argv[++i]);
+            nThreads = std::max(1, atoi(argv[++i]));
         if (!strcmp(argv[i], "--seedoffset"))
-            seedOffset = atoi(argv[++i]);
+            settings.seedOffset = atoll(argv[++i]);
+        if (!strcmp(argv[i], "--lutwidth")) // Number of LUT entries per dimension
+            settings.lutWidth = std::max(2, std::min(atoi(argv[++i]), 255));
+        if (!strcmp(argv[i], "--sampler")) { // "sobol" (randomized QMC; default) or "random"
+            const std::string sampler = argv[++i];
+            if (sampler == "random")
+                settings.sampler = AlbedoSampler::Random;
+            else if (sampler != "sobol")
+                std::cerr << "Sampler \"" << sampler << "\" not supported; using \"sobol\"." << std::endl;
+        }
+        if (!strcmp(argv[i], "--checkpoint")) // Resume from and periodically write the estimator state to the given file
+            checkpointFilename = argv[++i];
+        if (!strcmp(argv[i], "--checkpointinterval")) // In seconds
+            checkpointInterval = std::max(1, atoi(argv[++i]));
+        if (!strcmp(argv[i], "--lutdir")) // Use LUT files (as written by albedojson2dat) for --testlut and --benchmark
+            PbrtOptions.lutDir = argv[++i];
         if (!strcmp(argv[i], "--comparetopbrt")) // Compare calculated values to those from pbrt-v3's rho() function and emit warnings in case of significant differences
-            compareToPBRT = true;
+            settings.compareToPBRT = true;
         if (!strcmp(argv[i], "--testlut")) // Randomize material parameters and compare calculated values to those from the LUT and emit warnings in case of significant differences
-            testLUT = true;
+            settings.testLUT = true;
         if (!strcmp(argv[i], "--benchmark")) // Do NOT calculate albedos and test performance of LUT lookups vs. pbrt rho() calls instead
             benchmark = true;
     }
 
     if (benchmark)
-        nSamples = DefaultBenchmarkNSamples;
+        settings.nSamples = DefaultBenchmarkNSamples;
 
-    for (unsigned char i = 1; i < argc; ++i)
-        if (!strcmp(argv[i], "--nsamples"))
-            nSamples = atoi(argv[++i]);
+    for (int i = 1; i < argc; ++i)
+        if (!strcmp(argv[i], "--nsamples")) // Number of samples per LUT cell
+            settings.nSamples = std::max(1ll, atoll(argv[++i]));
 
     // Not implemented:
     // DisneyMaterial (too many parameters)
     // FourierMaterial (cannot be precomputed)
     // KdSubsurfaceMaterial (non-bounded parameter scale and mfp)
     // SubsurfaceMaterial (non-bounded parameter scale)
+    const std::string &materialName = settings.materialName;
     if (materialName == "DisneyMaterial" ||
         materialName == "FourierMaterial" ||
         materialName == "KdSubsurfaceMaterial" ||
@@ -353,254 +665,135 @@ int main(int argc, char *argv[]) {
         materialName != "SubstrateMaterial" &&
         materialName != "TranslucentMaterial" &&
         materialName != "UberMaterial")
-        materialName = "MatteMaterial";
-
-    // Dynamically nested loop (http://stackoverflow.com/questions/18732974/c-dynamic-number-of-nested-for-loops-without-recursion)
-    unsigned char nDims = 1;
-    if      (materialName == "GlassMaterial")       nDims = 6;
-    else if (materialName == "HairMaterial")        nDims = 4;
-    else if (materialName == "MatteMaterial")       nDims = 2;
-    else if (materialName == "MetalMaterial")       nDims = 5;
-    else if (materialName == "MirrorMaterial")      nDims = 2;
-    else if (materialName == "PlasticMaterial")     nDims = 4;
-    else if (materialName == "SubstrateMaterial")   nDims = 5;
-    else if (materialName == "TranslucentMaterial") nDims = 6;
-    else if (materialName == "UberMaterial")        nDims = 8;
-    Indexer ind(nDims, testLUT);
-
-    if (!benchmark) {
-        std::cout << "{" << std::endl;
-        std::cout << JsonInd1 << "\"materialName\": \"" << materialName << "\"," << std::endl;
-        std::cout << JsonInd1 << "\"nDims\": " << (unsigned short)ind.nDims << "," << std::endl;
-        std::cout << JsonInd1 << "\"lengths\": [" << std::endl;
-        for (unsigned char i = 0; i < ind.nDims; i++) {
-            std::cout << JsonInd2 << (unsigned short)ind.lengths[i];
-            if (i + 1 < ind.nDims)
-                std::cout << ",";
-            std::cout << std::endl;
-        }
-        std::cout << JsonInd1 << "]," << std::endl;
-        std::cout << JsonInd1 << "\"nThreads\": " << (unsigned short)nThreads << "," << std::endl;
-        std::cout << JsonInd1 << "\"seedOffset\": " << (unsigned short)seedOffset << "," << std::endl;
-        std::cout << JsonInd1 << "\"results\": [";
-        std::cout << std::endl;
-    }
+        settings.materialName = "MatteMaterial";
 
-    // Calculate total number of samples to report progress
-    MyCount nIterations = 1;
-    for (unsigned char i = 0; i < ind.nDims; i++)
-        nIterations *= ind.lengths[i];
-    const MyCount nSamplesTotal = nIterations * nSamples;
-    MyCount nSamplesTotalProgress = 0;
-    
-    const auto loopStartTime = std::chrono::high_resolution_clock::now();
-    while (true) {
-        const MyFloat woz = ind.GetFloat(0, CosEpsilon, 1.l);
-        Vector3f wo = Vector3f(std::sqrt(1.l - woz * woz), 0.l, woz); // We do not consider anisotropic materials
-        wo = Normalize(wo);
-
-        // Setup material
-        Material *material = nullptr;
-        if (materialName == "GlassMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kr      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Spectrum>> kt      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
-            const std::shared_ptr<Texture<Float>> uRoughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> vRoughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> index      = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (5, 1.l + Epsilon,      2.42l));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new GlassMaterial(kr, kt, uRoughness, vRoughness, index, bumpMap, remapRoughness);
-        } else if (materialName == "HairMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> sigmaA   = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1, Epsilon, 1.l));
-            const std::shared_ptr<Texture<Spectrum>> color    = nullptr;
-            const std::shared_ptr<Texture<Float>> eumelanin   = nullptr;
-            const std::shared_ptr<Texture<Float>> pheomelanin = nullptr;
-            const std::shared_ptr<Texture<Float>> eta         = std::make_shared<ConstantTexture<Float>>(1.55l);
-            const std::shared_ptr<Texture<Float>> betaM       = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(2, Epsilon, 1.l));
-            const std::shared_ptr<Texture<Float>> betaN       = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(3, Epsilon, 1.l));
-            const std::shared_ptr<Texture<Float>> alpha       = std::make_shared<ConstantTexture<Float>>(2.l);
-
-            material = new HairMaterial(sigmaA, color, eumelanin, pheomelanin, eta, betaM, betaN, alpha);
-        } else if (materialName == "MatteMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kd   = std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.l));
-            const std::shared_ptr<Texture<Float>> sigma   = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(1, 0.l, 90.l));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-
-            material = new MatteMaterial(kd, sigma, bumpMap);
-        } else if (materialName == "MetalMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> eta     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1, Epsilon, 7.14l));
-            const std::shared_ptr<Texture<Spectrum>> k       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2, Epsilon, 8.62l));
-            const std::shared_ptr<Texture<Float>> roughness  = nullptr;
-            const std::shared_ptr<Texture<Float>> uRoughness = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> vRoughness = std::make_shared<ConstantTexture<Float>>(ind.GetFloat(4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new MetalMaterial(eta, k, roughness, uRoughness, vRoughness, bumpMap, remapRoughness);
-        } else if (materialName == "MirrorMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kr = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-
-            material = new MirrorMaterial(kr, bumpMap);
-        } else if (materialName == "PlasticMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kd     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Spectrum>> ks     = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
-            const std::shared_ptr<Texture<Float>> roughness = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new PlasticMaterial(kd, ks, roughness, bumpMap, remapRoughness);
-        } else if (materialName == "SubstrateMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kd = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Spectrum>> ks = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
-            const std::shared_ptr<Texture<Float>> nu    = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> nv    = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (4, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new SubstrateMaterial(kd, ks, nu, nv, bumpMap, remapRoughness);
-        } else if (materialName == "TranslucentMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kd       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Spectrum>> ks       = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
-            const std::shared_ptr<Texture<Float>> roughness   = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat   (3, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Spectrum>> reflect  = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(4));
-            const std::shared_ptr<Texture<Spectrum>> transmit = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(5));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new TranslucentMaterial(kd, ks, roughness, reflect, transmit, bumpMap, remapRoughness);
-        } else if (materialName == "UberMaterial") {
-            const std::shared_ptr<Texture<Spectrum>> kd      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(1));
-            const std::shared_ptr<Texture<Spectrum>> ks      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(2));
-            const std::shared_ptr<Texture<Spectrum>> kr      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(3));
-            const std::shared_ptr<Texture<Spectrum>> kt      = std::make_shared<ConstantTexture<Spectrum>>(ind.GetSpectrum(4));
-            const std::shared_ptr<Texture<Float>> roughness  = nullptr;
-            const std::shared_ptr<Texture<Float>> roughnessu = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(5, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Float>> roughnessv = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(6, TrowbridgeAlphaMin, TrowbridgeAlphaMax));
-            const std::shared_ptr<Texture<Spectrum>> opacity = std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.l));
-            const std::shared_ptr<Texture<Float>> eta        = std::make_shared<ConstantTexture<Float>>   (ind.GetFloat(7, 1.l + Epsilon, 2.42l));
-            const std::shared_ptr<Texture<Float>> bumpMap = nullptr;
-            const bool remapRoughness = false;
-
-            material = new UberMaterial(kd, ks, kr, kt, roughness, roughnessu, roughnessv, opacity, eta, bumpMap, remapRoughness);
-        }
+    Indexer ind(GetNDims(materialName), settings.lutWidth, settings.testLUT);
 
-        // Setup BSDF
-        SurfaceInteraction isect(Point3f (0.l, 0.l, 0.l), // p
-                                 Vector3f(0.l, 0.l, 0.l), // pError
-                                 Point2f (0.l, 0.l),      // uv
-                                 wo,                      // wo
-                                 Vector3f(1.l, 0.l, 0.l), // dpdu
-                                 Vector3f(0.l, 1.l, 0.l), // dpdv
-                                 Normal3f(0.l, 0.l, 0.l), // dndu
-                                 Normal3f(0.l, 0.l, 0.l), // dndv
-                                 MyFloat (0.l),           // time
-                                 nullptr);                // shape
+    if (benchmark) {
+        ind.SetCell(0, CellSeed(settings.seedOffset, 0));
         MemoryArena arena;
-        material->ComputeScatteringFunctions(&isect, arena, TransportMode::Radiance, false);
-        const BSDF *bsdf = isect.bsdf;
-
-
-        if (benchmark) {
-            BenchmarkLUT(material, &isect, nSamples);
-            BenchmarkPBRT(bsdf, wo, nSamples);
-            delete material;
-        } else {
-            // Calculate albedo
-            std::thread *threads = new std::thread[nThreads];
-            MyFloat *sumFs = new MyFloat[nThreads];
-            MyFloat sumF = 0.l;
-            for (unsigned char i = 0; i < nThreads; i++)
-                threads[i] = std::thread(SampleAlbedo, seedOffset + i,
-                                         bsdf, wo,
-                                         nSamples,
-                                         &sumFs[i]);
-            for (unsigned char i = 0; i < nThreads; i++) {
-                threads[i].join();
-                sumF += sumFs[i];
-            }
-            delete[] threads;
-            delete[] sumFs;
+        SurfaceInteraction isect;
+        Vector3f wo;
+        Material *material = SetupCell(materialName, ind, arena, &isect, &wo);
 
-            const MyCount nF = nThreads * nSamples;
-            const MyFloat albedo = sumF / nF;
+        const double perChannelDuration = BenchmarkLUT(material, &isect, settings.nSamples, true);
+        const double duration           = BenchmarkLUT(material, &isect, settings.nSamples);
+        std::clog << "Speedup of RGB lookups over per-channel lookups: " << perChannelDuration / duration << "x" << std::endl;
+        BenchmarkPBRT(isect.bsdf, wo, settings.nSamples);
+        delete material;
 
+        return 0;
+    }
 
-            // Checks
-            if (albedo > 1.l)
-                std::cerr << "Warning: calculated albedo " << albedo << " is greater than 1." << std::endl;
+    // Setup checkpoint (random material parameters cannot be resumed)
+    const MyCount nCells = ind.NumCells();
+    AlbedoCheckpoint checkpoint;
+    checkpoint.materialName = materialName;
+    checkpoint.lengths.assign(ind.lengths.begin(), ind.lengths.end());
+    checkpoint.seedOffset = settings.seedOffset;
+    checkpoint.cells.resize(nCells);
+    if (settings.testLUT && !checkpointFilename.empty()) {
+        std::cerr << "Checkpoints are not supported with --testlut." << std::endl;
+        checkpointFilename.clear();
+    }
+    MyCount nResumedCells = 0;
+    if (!checkpointFilename.empty() && std::ifstream(checkpointFilename).good()) {
+        AlbedoCheckpoint previous;
+        if (!previous.Read(checkpointFilename) ||
+            previous.materialName != checkpoint.materialName ||
+            previous.lengths != checkpoint.lengths ||
+            previous.seedOffset != checkpoint.seedOffset) {
+            std::cerr << "Error: checkpoint \"" << checkpointFilename << "\" is invalid or does not match the material, LUT width, or seed offset." << std::endl;
+            return 1;
+        }
+        checkpoint = std::move(previous);
+        for (const AlbedoCheckpointCell &cell : checkpoint.cells)
+            if (cell.nF > 0)
+                nResumedCells++;
+        std::clog << "Resuming from checkpoint \"" << checkpointFilename << "\" (" << nResumedCells << " of " << nCells << " cells done)." << std::endl;
+    }
 
-            Float lutAlbedoRGB[3];
-            material->GetAlbedo(&isect).ToRGB(lutAlbedoRGB);
-#ifdef PBRT_STATISTICS_FULL_LOOKUPS
-            Float lutFullAlbedoRGB[3];
-            material->GetAlbedoFull(&isect).ToRGB(lutFullAlbedoRGB);
-#endif
-            delete material;
-            if (std::abs(albedo - lutAlbedoRGB[0]) > LutCheckThreshold)
-                std::cerr << "Warning: calculated albedo " << albedo << " is significantly different from LUT albedo (" << lutAlbedoRGB[0] << ")." << std::endl;
-
-            Float pbrtAlbedoRGB[3];
-            if (compareToPBRT) {
-                RNG rng(0);
-                Point2f rhoSamples[PbrtCheckNSamples];
-                for (unsigned int i = 0; i < PbrtCheckNSamples; i++)
-                    rhoSamples[i] = Point2f(rng.UniformFloat(), rng.UniformFloat());
-
-                const Spectrum pbrtAlbedo = bsdf->rho(wo, PbrtCheckNSamples, rhoSamples, BSDF_ALL);
-                pbrtAlbedo.ToRGB(pbrtAlbedoRGB);
-
-                if (std::abs(albedo - pbrtAlbedoRGB[0]) > PbrtCheckThreshold)
-                    std::cerr << "Warning: calculated albedo " << albedo << " is significantly different from pbrt's rho (" << pbrtAlbedoRGB[0] << ")." << std::endl;
+    std::cout << "{" << std::endl;
+    std::cout << JsonInd1 << "\"materialName\": \"" << materialName << "\"," << std::endl;
+    std::cout << JsonInd1 << "\"nDims\": " << (unsigned short)ind.nDims << "," << std::endl;
+    std::cout << JsonInd1 << "\"lengths\": [" << std::endl;
+    for (unsigned char i = 0; i < ind.nDims; i++) {
+        std::cout << JsonInd2 << (unsigned short)ind.lengths[i];
+        if (i + 1 < ind.nDims)
+            std::cout << ",";
+        std::cout << std::endl;
+    }
+    std::cout << JsonInd1 << "]," << std::endl;
+    std::cout << JsonInd1 << "\"nThreads\": " << (unsigned short)nThreads << "," << std::endl;
+    std::cout << JsonInd1 << "\"sampler\": \"" << (settings.sampler == AlbedoSampler::Sobol ? "sobol" : "random") << "\"," << std::endl;
+    std::cout << JsonInd1 << "\"seedOffset\": " << settings.seedOffset << "," << std::endl;
+    std::cout << JsonInd1 << "\"results\": [";
+    std::cout << std::endl;
+
+    // The workers take cells from a shared counter, so that threads that
+    // finish cheap cells early continue with the next ones instead of
+    // waiting for the slowest thread. Finished cells are passed to the main
+    // thread, which outputs them in order and writes the checkpoints. Only
+    // the main thread modifies checkpoint.cells; workers read the entries of
+    // the cells they have taken, which the main thread does not touch until
+    // these are finished.
+    std::atomic<MyCount> nextCell(0);
+    std::mutex resultsMutex;
+    std::condition_variable resultsCondition;
+    std::map<MyCount, CellResult> results;
+
+    std::vector<std::thread> threads;
+    for (unsigned char i = 0; i < nThreads; i++)
+        threads.emplace_back([&]() {
+            MyCount cell;
+            while ((cell = nextCell++) < nCells) {
+                CellResult result = ComputeCell(settings, cell, checkpoint.cells[cell]);
+                {
+                    std::lock_guard<std::mutex> lock(resultsMutex);
+                    results.emplace(cell, std::move(result));
+                }
+                resultsCondition.notify_one();
             }
+        });
 
-#ifdef PBRT_STATISTICS_FULL_LOOKUPS
-            if (std::abs(lutFullAlbedoRGB[0] - lutAlbedoRGB[0]) > LutCheckThreshold ||
-                std::abs(lutFullAlbedoRGB[1] - lutAlbedoRGB[1]) > LutCheckThreshold ||
-                std::abs(lutFullAlbedoRGB[2] - lutAlbedoRGB[2]) > LutCheckThreshold) {
-                std::cerr << "Fatal: found a significant difference between reduced LUT and full LUT." << std::endl;
-                exit(1);
-            }
-#endif
+    const auto loopStartTime = std::chrono::high_resolution_clock::now();
+    auto lastCheckpointTime = loopStartTime;
+    for (MyCount cell = 0; cell < nCells; cell++) {
+        CellResult result;
+        {
+            std::unique_lock<std::mutex> lock(resultsMutex);
+            resultsCondition.wait(lock, [&]() { return results.count(cell) > 0; });
+            auto iter = results.find(cell);
+            result = std::move(iter->second);
+            results.erase(iter);
+        }
 
+        checkpoint.cells[cell].sumF = result.sumF;
+        checkpoint.cells[cell].nF   = result.nF;
 
-            // Output
-            std::string indexString;
-            for (unsigned char i = 0; i < ind.nDims; i++) {
-                indexString += std::to_string(ind.GetFloat(i));
-                if (i < ind.nDims - 1)
-                    indexString += " ";
-            }
+        // Output
+        std::cerr << result.warnings;
+        PrintCellResult(settings, result);
+        if (cell + 1 < nCells)
+            std::cout << ",";
+        std::cout << std::endl;
 
-            std::cout << JsonInd2 << "{" << std::endl;
-            if (!testLUT)
-                std::cout << JsonInd3 << "\"indices\": \"" << indexString << "\"," << std::endl;
-            std::cout << JsonInd3 << "\"albedo\":             " << albedo << "," << std::endl;
-            std::cout << JsonInd3 << "\"albedo (LUT)\":      \"" << lutAlbedoRGB[0]     << " " << lutAlbedoRGB[1]     << " " << lutAlbedoRGB[2]     << "\"," << std::endl;
-#ifdef PBRT_STATISTICS_FULL_LOOKUPS
-            std::cout << JsonInd3 << "\"albedo (full LUT)\": \"" << lutFullAlbedoRGB[0] << " " << lutFullAlbedoRGB[1] << " " << lutFullAlbedoRGB[2] << "\"," << std::endl;
-#endif
-            if (compareToPBRT)
-                std::cout << JsonInd3 << "\"albedo (pbrt)\":     \"" << pbrtAlbedoRGB[0] << " " << pbrtAlbedoRGB[1] << " " << pbrtAlbedoRGB[2] << "\"," << std::endl;
-            std::cout << JsonInd3 << "\"sumF\": " << sumF << "," << std::endl;
-            std::cout << JsonInd3 << "\"nF\": " << nF << std::endl;
-            std::cout << JsonInd2 << "}";
-
-            nSamplesTotalProgress += nSamples;
-            const std::chrono::duration<double> duration = (std::chrono::high_resolution_clock::now() - loopStartTime);
-            PrintProgress(nSamplesTotal, nSamplesTotalProgress, duration.count());
-
-            if (!ind.Increment()) {
-                std::cout << std::endl;
-                goto breakAll;
-            }
+        const auto now = std::chrono::high_resolution_clock::now();
+        const std::chrono::duration<double> duration = now - loopStartTime;
+        PrintProgress(nCells, cell + 1, duration.count());
 
-            std::cout << "," << std::endl;
+        if (!checkpointFilename.empty() &&
+            std::chrono::duration<double>(now - lastCheckpointTime).count() > checkpointInterval) {
+            WriteCheckpoint(checkpoint, checkpointFilename);
+            lastCheckpointTime = now;
         }
     }
 
-    breakAll:
+    for (std::thread &thread : threads)
+        thread.join();
+
+    if (!checkpointFilename.empty() && !WriteCheckpoint(checkpoint, checkpointFilename))
+        return 1;
 
     std::cout << JsonInd1 << "]" << std::endl;
     std::cout << "}" << std::endl;
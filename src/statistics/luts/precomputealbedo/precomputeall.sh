@@ -3,16 +3,16 @@
 # © 2024-2025 Hiroyuki Sakai
 
 PBRT_BUILD_PATH="../../../../build/pbrt-v3/"
-N_SAMPLES=32768
+N_SAMPLES=1048576 # Per LUT cell
 
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material UberMaterial > uber.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material GlassMaterial > glass.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material HairMaterial > hair.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material MatteMaterial > matte.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material MetalMaterial > metal.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material PlasticMaterial > plastic.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material SubstrateMaterial > substrate.json
-${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material TranslucentMaterial > translucent.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material UberMaterial --checkpoint uber.ckpt > uber.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material GlassMaterial --checkpoint glass.ckpt > glass.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material HairMaterial --checkpoint hair.ckpt > hair.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material MatteMaterial --checkpoint matte.ckpt > matte.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material MetalMaterial --checkpoint metal.ckpt > metal.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material PlasticMaterial --checkpoint plastic.ckpt > plastic.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material SubstrateMaterial --checkpoint substrate.ckpt > substrate.json
+${PBRT_BUILD_PATH}/precomputealbedo --nsamples $N_SAMPLES --material TranslucentMaterial --checkpoint translucent.ckpt > translucent.json
 
 ./json2cpp.sh uber.json
 ./json2cpp.sh glass.json
@@ -0,0 +1,50 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// statistics/metrics.cpp*
+#include "statistics/metrics.h"
+#include "error.h"
+#include <cmath>
+#include <set>
+
+namespace pbrt {
+
+// MetricsFile Method Definitions
+MetricsFile::MetricsFile(const std::string &filename) {
+    static std::set<std::string> openedFilenames;
+    const bool truncate = openedFilenames.insert(filename).second;
+
+    file = fopen(filename.c_str(), truncate ? "w" : "a");
+    if (!file) {
+        Error("%s: unable to open metrics file", filename.c_str());
+        exit(1);
+    }
+    csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    writeHeader = csv && truncate;
+}
+
+MetricsFile::~MetricsFile() {
+    fclose(file);
+}
+
+void MetricsFile::Write(const Record &record) {
+    if (writeHeader) {
+        for (size_t i = 0; i < record.size(); i++)
+            fprintf(file, "%s%s", i > 0 ? "," : "", record[i].first);
+        fprintf(file, "\n");
+        writeHeader = false;
+    }
+
+    if (!csv) fprintf(file, "{");
+    for (size_t i = 0; i < record.size(); i++) {
+        if (i > 0) fprintf(file, ",");
+        if (!csv) fprintf(file, "\"%s\":", record[i].first);
+        if (std::isfinite(record[i].second))
+            fprintf(file, "%.17g", record[i].second);
+        else if (!csv)
+            fprintf(file, "null");
+    }
+    fprintf(file, csv ? "\n" : "}\n");
+    fflush(file); // Keep the records of finished iterations if pbrt is aborted
+}
+
+}  // namespace pbrt
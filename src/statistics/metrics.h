@@ -0,0 +1,42 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_STATISTICS_METRICS_H
+#define PBRT_STATISTICS_METRICS_H
+
+// statistics/metrics.h*
+#include "pbrt.h"
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pbrt {
+
+// Metrics Declarations
+// One record per line, as JSON Lines or, if _filename_ ends with ".csv",
+// as CSV with a header row. The file is truncated when it is first opened
+// by this process and appended to afterward (e.g., for the warm-up and the
+// main render), so the fields of all records written to one CSV file must
+// match.
+class MetricsFile {
+  public:
+    typedef std::vector<std::pair<const char *, double>> Record;
+
+    MetricsFile(const std::string &filename);
+    ~MetricsFile();
+    void Write(const Record &record);
+
+  private:
+    FILE *file;
+    bool csv;
+    bool writeHeader;
+};
+
+}  // namespace pbrt
+
+#endif  // PBRT_STATISTICS_METRICS_H
@@ -0,0 +1,545 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// Microbenchmarks of the statistics and LUT kernels. Each benchmark sets up
+// its working set once and then runs the kernel in batches: the batch size is
+// calibrated until a batch takes at least --mintime seconds, after which
+// --repetitions batches are timed. The median (and minimum) time per item
+// is reported. "warm" variants reuse a working set that fits into the caches,
+// "cold" variants cycle through one that exceeds the last-level cache.
+
+#include <algorithm>  // std::sort
+#include <chrono>     // std::chrono
+#include <cstdio>     // printf
+#include <cstring>    // strcmp
+#include <functional> // std::function
+#include <memory>     // std::shared_ptr
+#include <regex>      // std::regex
+#include <string>     // std::string
+#include <type_traits> // std::is_same
+#include <vector>     // std::vector
+
+#include "pbrt.h"
+#include "geometry.h"    // Bounds2i, ...
+#include "interaction.h" // SurfaceInteraction
+#include "material.h"
+#include "rng.h"         // RNG
+#include "texture.h"
+
+#include "materials/glass.h"
+#include "materials/hair.h"
+#include "materials/matte.h"
+#include "materials/metal.h"
+#include "materials/plastic.h"
+#include "materials/substrate.h"
+#include "materials/translucent.h"
+#include "materials/uber.h"
+#include "textures/constant.h" // ConstantTexture
+
+#include "statistics/buffer.h"
+#include "statistics/estimator.h"
+#include "statistics/lut.h"
+
+using namespace pbrt;
+
+typedef std::chrono::steady_clock Clock;
+
+static PBRT_CONSTEXPR double DefaultMinTime       = .1; // In seconds
+static PBRT_CONSTEXPR int    DefaultRepetitions   = 5;
+static PBRT_CONSTEXPR int    DefaultTileSize      = 32;
+static PBRT_CONSTEXPR size_t DefaultColdBytes     = size_t(256) << 20; // Exceeds the LLC of current CPUs
+static PBRT_CONSTEXPR int    WarmResolution       = 128;
+static PBRT_CONSTEXPR int    ColdResolutionX      = 1920;
+static PBRT_CONSTEXPR int    ColdResolutionY      = 1080;
+static PBRT_CONSTEXPR int    LUTWidth             = 8;    // Entries per dimension, as in statistics/luts/
+static PBRT_CONSTEXPR int    NInputs              = 4096; // Distinct inputs of the LUT and material benchmarks
+
+static int    tileSize  = DefaultTileSize;
+static size_t coldBytes = DefaultColdBytes;
+
+// Prevents the compiler from optimizing away the computation of _value_
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+class BenchmarkState {
+    public:
+        BenchmarkState(const double minTime, const int nRepetitions)
+          : minTime(minTime), nRepetitions(nRepetitions)
+        {}
+        // Usage: while (state.KeepRunning()) { <kernel> }
+        bool KeepRunning() {
+            if (remaining > 0) {
+                remaining--;
+                return true;
+            }
+            return NextBatch();
+        }
+        // Excludes setup work within the loop (e.g., cache flushes) from
+        // the measurement
+        void PauseTiming()  { pauseStart = Clock::now(); }
+        void ResumeTiming() { paused += Clock::now() - pauseStart; }
+        void SetItemsPerIteration(const int64_t n) { itemsPerIteration = n; }
+
+        int64_t batchSize = 1;
+        std::vector<double> nsPerItem; // Per timed batch
+
+    private:
+        bool NextBatch() {
+            if (started) {
+                const double seconds = std::chrono::duration<double>(Clock::now() - batchStart - paused).count();
+                if (calibrating && seconds < minTime) {
+                    // Grow the batch like Google Benchmark does
+                    const double factor = seconds > 0 ? 1.4 * minTime / seconds : 10;
+                    batchSize = (int64_t)(batchSize * std::max(2., std::min(factor, 10.)));
+                } else {
+                    calibrating = false;
+                    nsPerItem.push_back(seconds * 1e9 / (batchSize * itemsPerIteration));
+                    if (nsPerItem.size() >= (size_t)nRepetitions)
+                        return false;
+                }
+            }
+            started = true;
+            remaining = batchSize - 1;
+            paused = Clock::duration::zero();
+            batchStart = Clock::now();
+            return true;
+        }
+
+        const double minTime;
+        const int nRepetitions;
+        int64_t itemsPerIteration = 1;
+        int64_t remaining = 0;
+        bool started = false;
+        bool calibrating = true;
+        Clock::time_point batchStart, pauseStart;
+        Clock::duration paused;
+};
+
+struct Benchmark {
+    std::string name;
+    std::function<void(BenchmarkState &)> fn;
+};
+
+// Evicts the caches by writing to a buffer of --coldbytes bytes
+static void FlushCaches() {
+    static std::vector<char> buffer(coldBytes);
+    static char value = 0;
+    value++;
+    std::fill(buffer.begin(), buffer.end(), value);
+    DoNotOptimize(buffer[buffer.size() / 2]);
+}
+
+// Positive samples with a long tail, roughly like radiance
+static Float RandomSample(RNG &rng) {
+    const Float u = rng.UniformFloat();
+    return u * u * u * 4.f + .01f;
+}
+template <typename T>
+static std::vector<T> RandomSamples(const size_t n);
+template <>
+std::vector<Float> RandomSamples(const size_t n) {
+    RNG rng;
+    std::vector<Float> samples(n);
+    for (Float &s : samples)
+        s = RandomSample(rng);
+    return samples;
+}
+template <>
+std::vector<Vec3> RandomSamples(const size_t n) {
+    RNG rng;
+    std::vector<Vec3> samples(n);
+    for (Vec3 &s : samples)
+        s = Vec3(RandomSample(rng), RandomSample(rng), RandomSample(rng));
+    return samples;
+}
+
+// StatTile::AddSample*() and AddTransformSample*(); one item is one sample,
+// one iteration adds a sample to every pixel of a tile.
+template <typename T, typename P>
+static void BenchmarkAddSample(
+    BenchmarkState &state,
+    void (StatTile<T, P>::*add)(const Point2i p, const T sample),
+    const bool cold
+) {
+    const Bounds2i bounds(Point2i(0, 0), Point2i(tileSize, tileSize));
+    const size_t nTiles = cold ? std::max<size_t>(1, coldBytes / (bounds.Area() * sizeof(P))) : 1;
+    std::vector<StatTile<T, P>> tiles(nTiles, StatTile<T, P>(bounds));
+    const std::vector<T> samples = RandomSamples<T>(bounds.Area());
+
+    size_t t = 0;
+    state.SetItemsPerIteration(bounds.Area());
+    while (state.KeepRunning()) {
+        StatTile<T, P> &tile = tiles[t];
+        t = t + 1 == nTiles ? 0 : t + 1;
+        const T *sample = &samples[0];
+        for (const Point2i p : bounds)
+            (tile.*add)(p, *sample++);
+        DoNotOptimize(tile.GetPixel(bounds.pMin));
+    }
+}
+
+template <typename T>
+static void BenchmarkBoxCox(BenchmarkState &state) {
+    const std::vector<T> samples = RandomSamples<T>(NInputs);
+
+    state.SetItemsPerIteration(NInputs);
+    while (state.KeepRunning())
+        for (const T &sample : samples) {
+            const T transformed = boxCox(sample, .5f);
+            DoNotOptimize(transformed);
+        }
+}
+
+// Estimator with a single radiance statistic type as configured for
+// denoising (transformed samples up to the third moment) and optionally
+// variance estimation (see CreateStatPathIntegrator())
+struct EstimatorFixture {
+    EstimatorFixture(const int width, const int height, const bool rgb)
+      : film("film", Mat3(height, width)),
+        reg(film),
+        estimator(film, Configs(rgb), 1.f, 1, false, false, false, 1, reg,
+                  Bounds2i(Point2i(0, 0), Point2i(width, height)), nullptr)
+    {
+        estimator.AllocateBuffers(reg);
+    }
+    static StatTypeConfigs Configs(const bool rgb) {
+        StatTypeConfigs cfgs;
+        StatTypeConfig cfg;
+        cfg.type = 0;
+        cfg.index = cfgs.nEnabled++;
+        cfg.enable = true;
+        cfg.bounceStart = 0;
+        cfg.bounceEnd = 1;
+        cfg.nBounces = 1;
+        cfg.nChannels = rgb ? 3 : 1;
+        cfg.transform = true;
+        cfg.maxMoment = 3;
+        cfg.cudaGroups = {CalculateMeanVarianceGroup};
+        cfgs.configs = {cfg};
+        return cfgs;
+    }
+    const StatTypeConfig &Config() const { return estimator.statTypeConfigs[0]; }
+
+    Buffer film;
+    BufferRegistry reg;
+    Estimator estimator;
+};
+
+// Estimator::MergeTiles() and MergeTransformTiles(); one item is one pixel.
+// The warm variant repeatedly merges a single tile into an image of the same
+// size; the cold variant merges the tiles of a full-HD image in scanline
+// order.
+template <typename T, typename P>
+static void BenchmarkMerge(
+    BenchmarkState &state,
+    void (Estimator::*merge)(const std::vector<StatTile<T, P>> &tiles, const StatTypeConfig &cfg) const,
+    const bool cold
+) {
+    const Point2i resolution = cold ? Point2i(ColdResolutionX, ColdResolutionY) : Point2i(tileSize, tileSize);
+    EstimatorFixture f(resolution.x, resolution.y, std::is_same<T, Vec3>::value);
+
+    std::vector<std::vector<StatTile<T, P>>> tiles;
+    int64_t nPixels = 0;
+    for (int y = 0; y < resolution.y; y += tileSize)
+        for (int x = 0; x < resolution.x; x += tileSize) {
+            const Bounds2i bounds(Point2i(x, y), Point2i(std::min(x + tileSize, resolution.x),
+                                                         std::min(y + tileSize, resolution.y)));
+            tiles.push_back(f.estimator.GetTiles<T, P>(bounds, 1));
+            nPixels += bounds.Area();
+        }
+
+    state.SetItemsPerIteration(nPixels);
+    while (state.KeepRunning())
+        for (const std::vector<StatTile<T, P>> &tile : tiles)
+            (f.estimator.*merge)(tile, f.Config());
+}
+
+// Estimator::CalculateMeanVars(); one item is one pixel. The caches are
+// flushed before each iteration of the cold variant.
+template <typename T>
+static void BenchmarkCalculateMeanVars(BenchmarkState &state, const bool cold) {
+    const Point2i resolution = cold ? Point2i(ColdResolutionX, ColdResolutionY) : Point2i(WarmResolution, WarmResolution);
+    EstimatorFixture f(resolution.x, resolution.y, std::is_same<T, Vec3>::value);
+
+    state.SetItemsPerIteration((int64_t)resolution.x * resolution.y);
+    while (state.KeepRunning()) {
+        if (cold) {
+            state.PauseTiming();
+            FlushCaches();
+            state.ResumeTiming();
+        }
+        f.estimator.CalculateMeanVars();
+    }
+}
+
+// LookupTable() on a synthetic LUT with LUTWidth entries per dimension; one
+// item is one lookup. The warm variant only accesses the first hypercube of
+// the LUT, the cold variant the whole LUT (64 MB for 8 dimensions).
+static void BenchmarkLookupTable(BenchmarkState &state, const unsigned char nDims, const bool cold) {
+    unsigned int nValues = 1;
+    for (unsigned char i = 0; i < nDims; i++)
+        nValues *= LUTWidth;
+
+    RNG rng;
+    std::vector<Float> values(nValues);
+    for (Float &v : values)
+        v = rng.UniformFloat();
+    const std::vector<unsigned char> maxIndices(nDims, LUTWidth - 1);
+    std::vector<unsigned int> offsets(1u << nDims);
+    for (unsigned int i = 0; i < offsets.size(); i++) {
+        unsigned int offset = 0, increment = 1;
+        for (unsigned char j = 0; j < nDims; j++) {
+            if ((i >> j) & 1)
+                offset += increment;
+            increment *= LUTWidth;
+        }
+        offsets[i] = offset;
+    }
+
+    const Float range = cold ? 1.f : 1.f / (LUTWidth - 1);
+    std::vector<Float> indices(NInputs * nDims);
+    for (Float &index : indices)
+        index = rng.UniformFloat() * range;
+
+    state.SetItemsPerIteration(NInputs);
+    while (state.KeepRunning())
+        for (int i = 0; i < NInputs; i++) {
+            const Float value = LookupTable(&values[0], nDims, &maxIndices[0], &offsets[0], &indices[i * nDims]);
+            DoNotOptimize(value);
+        }
+}
+
+// Texture that varies with u (with a different frequency per texture), so
+// that the material's LUT cannot be reduced
+template <typename T>
+class FrequencyTexture : public Texture<T> {
+    public:
+        FrequencyTexture(const T &v0, const T &v1, const Float frequency)
+          : v0(v0), v1(v1), frequency(frequency)
+        {}
+        T Evaluate(const SurfaceInteraction &si) const {
+            Float t = si.uv[0] * frequency;
+            t -= std::floor(t);
+            return (1 - t) * v0 + t * v1;
+        }
+        T Evaluate() const {
+            LOG(FATAL) << "FrequencyTexture::Evaluate() method called; not implemented";
+            return v0;
+        }
+
+    private:
+        const T v0, v1;
+        const Float frequency;
+};
+
+// Creates the parameter textures of a material, either constant (the mean
+// of the parameter range) or varying over the parameter range
+class ParameterFactory {
+    public:
+        ParameterFactory(const bool textured) : textured(textured) {}
+        std::shared_ptr<Texture<Float>> FloatParam(const Float v0, const Float v1) {
+            if (!textured)
+                return std::make_shared<ConstantTexture<Float>>((v0 + v1) / 2);
+            return std::make_shared<FrequencyTexture<Float>>(v0, v1, NextFrequency());
+        }
+        std::shared_ptr<Texture<Spectrum>> SpectrumParam(const Float v0, const Float v1) {
+            if (!textured)
+                return std::make_shared<ConstantTexture<Spectrum>>(Spectrum((v0 + v1) / 2));
+            return std::make_shared<FrequencyTexture<Spectrum>>(Spectrum(v0), Spectrum(v1), NextFrequency());
+        }
+
+    private:
+        Float NextFrequency() {
+            static const Float primes[] = {1, 3, 7, 13, 29, 53, 97, 193};
+            return primes[nTextures++ % 8];
+        }
+
+        const bool textured;
+        unsigned int nTextures = 0;
+};
+
+static const std::vector<std::string> LUTMaterials = {
+    "glass", "hair", "matte", "metal", "plastic", "substrate", "translucent", "uber"
+};
+
+// The parameter ranges correspond to those of precomputealbedo
+static Material *CreateLUTMaterial(const std::string &name, const bool textured) {
+    ParameterFactory p(textured);
+    const Float aMin = TrowbridgeAlphaMin, aMax = TrowbridgeAlphaMax;
+    if (name == "glass")
+        return new GlassMaterial(p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.FloatParam(aMin, aMax), p.FloatParam(aMin, aMax),
+                                 p.FloatParam(1 + Epsilon, 2.42f), nullptr, false);
+    if (name == "hair")
+        return new HairMaterial(p.SpectrumParam(Epsilon, 1), nullptr, nullptr, nullptr,
+                                std::make_shared<ConstantTexture<Float>>(1.55f), p.FloatParam(Epsilon, 1),
+                                p.FloatParam(Epsilon, 1), std::make_shared<ConstantTexture<Float>>(2.f));
+    if (name == "matte")
+        return new MatteMaterial(std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.f)), p.FloatParam(0, 90), nullptr);
+    if (name == "metal")
+        return new MetalMaterial(p.SpectrumParam(Epsilon, 7.14f), p.SpectrumParam(Epsilon, 8.62f), nullptr,
+                                 p.FloatParam(aMin, aMax), p.FloatParam(aMin, aMax), nullptr, false);
+    if (name == "plastic")
+        return new PlasticMaterial(p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.FloatParam(aMin, aMax), nullptr, false);
+    if (name == "substrate")
+        return new SubstrateMaterial(p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.FloatParam(aMin, aMax), p.FloatParam(aMin, aMax),
+                                     nullptr, false);
+    if (name == "translucent")
+        return new TranslucentMaterial(p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.FloatParam(aMin, aMax),
+                                       p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), nullptr, false);
+    return new UberMaterial(p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), p.SpectrumParam(0, 1), nullptr,
+                            p.FloatParam(aMin, aMax), p.FloatParam(aMin, aMax),
+                            std::make_shared<ConstantTexture<Spectrum>>(Spectrum(1.f)),
+                            p.FloatParam(1 + Epsilon, 2.42f), nullptr, false);
+}
+
+static SurfaceInteraction CreateInteraction(const Float cosTheta, const Float u) {
+    const Vector3f wo = Normalize(Vector3f(std::sqrt(1 - cosTheta * cosTheta), 0, cosTheta));
+    return SurfaceInteraction(Point3f(0, 0, 0), Vector3f(0, 0, 0), Point2f(u, 0), wo,
+                              Vector3f(1, 0, 0), Vector3f(0, 1, 0), Normal3f(0, 0, 0), Normal3f(0, 0, 0),
+                              0, nullptr);
+}
+
+// Material::GetAlbedo(); one item is one lookup. "reduced" uses constant
+// parameters (i.e., a LUT reduced to the wo dimension) and a fixed wo;
+// "warm" and "cold" use textured parameters (i.e., the full LUT) with fixed
+// and random inputs, respectively.
+static void BenchmarkGetAlbedo(BenchmarkState &state, const std::string &material, const std::string &variant) {
+    std::unique_ptr<Material> m(CreateLUTMaterial(material, variant != "reduced"));
+
+    RNG rng;
+    std::vector<SurfaceInteraction> isects;
+    for (int i = 0; i < NInputs; i++)
+        isects.push_back(variant == "cold" ? CreateInteraction(Lerp(rng.UniformFloat(), CosEpsilon, 1.f), rng.UniformFloat())
+                                           : CreateInteraction(.7f, .3f));
+
+    state.SetItemsPerIteration(NInputs);
+    while (state.KeepRunning())
+        for (SurfaceInteraction &isect : isects) {
+            const RGBSpectrum albedo = m->GetAlbedo(&isect);
+            DoNotOptimize(albedo);
+        }
+}
+
+static std::vector<Benchmark> GetBenchmarks() {
+    std::vector<Benchmark> b;
+    for (const bool cold : {false, true}) {
+        const std::string suffix = cold ? "/cold" : "/warm";
+#define ADD_SAMPLE_BENCHMARKS(T, P, name) \
+        b.push_back({"AddSampleM1<" name ">" + suffix,          [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddSampleM1,          cold); }}); \
+        b.push_back({"AddSampleM2<" name ">" + suffix,          [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddSampleM2,          cold); }}); \
+        b.push_back({"AddSampleM3<" name ">" + suffix,          [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddSampleM3,          cold); }}); \
+        b.push_back({"AddTransformSampleM1<" name ">" + suffix, [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddTransformSampleM1, cold); }}); \
+        b.push_back({"AddTransformSampleM2<" name ">" + suffix, [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddTransformSampleM2, cold); }}); \
+        b.push_back({"AddTransformSampleM3<" name ">" + suffix, [=](BenchmarkState &s) { BenchmarkAddSample<T, P>(s, &StatTile<T, P>::AddTransformSampleM3, cold); }});
+        ADD_SAMPLE_BENCHMARKS(Float, StatTilePixel<Float>,     "Float")
+        ADD_SAMPLE_BENCHMARKS(Vec3,  StatTilePixel<Vec3>,      "Vec3")
+        ADD_SAMPLE_BENCHMARKS(Float, FilmStatTilePixel<Float>, "Float,Film")
+        ADD_SAMPLE_BENCHMARKS(Vec3,  FilmStatTilePixel<Vec3>,  "Vec3,Film")
+#undef ADD_SAMPLE_BENCHMARKS
+    }
+    b.push_back({"boxCox<Float>", BenchmarkBoxCox<Float>});
+    b.push_back({"boxCox<Vec3>",  BenchmarkBoxCox<Vec3>});
+    for (const bool cold : {false, true}) {
+        const std::string suffix = cold ? "/cold" : "/warm";
+#define MERGE_BENCHMARK(name, T, P, fn) \
+        b.push_back({name + suffix, [=](BenchmarkState &s) { BenchmarkMerge<T, P>(s, fn, cold); }});
+        MERGE_BENCHMARK("MergeTiles<Float>",               Float, StatTilePixel<Float>,     &Estimator::MergeTiles<Float>)
+        MERGE_BENCHMARK("MergeTiles<Vec3>",                Vec3,  StatTilePixel<Vec3>,      &Estimator::MergeTiles<Vec3>)
+        MERGE_BENCHMARK("MergeTransformTiles<Float>",      Float, StatTilePixel<Float>,     (&Estimator::MergeTransformTiles<Float, StatTilePixel<Float>>))
+        MERGE_BENCHMARK("MergeTransformTiles<Vec3>",       Vec3,  StatTilePixel<Vec3>,      (&Estimator::MergeTransformTiles<Vec3,  StatTilePixel<Vec3>>))
+        MERGE_BENCHMARK("MergeTransformTiles<Float,Film>", Float, FilmStatTilePixel<Float>, (&Estimator::MergeTransformTiles<Float, FilmStatTilePixel<Float>>))
+        MERGE_BENCHMARK("MergeTransformTiles<Vec3,Film>",  Vec3,  FilmStatTilePixel<Vec3>,  (&Estimator::MergeTransformTiles<Vec3,  FilmStatTilePixel<Vec3>>))
+#undef MERGE_BENCHMARK
+    }
+    for (const bool cold : {false, true}) {
+        const std::string suffix = cold ? "/cold" : "/warm";
+        b.push_back({"CalculateMeanVars<Float>" + suffix, [=](BenchmarkState &s) { BenchmarkCalculateMeanVars<Float>(s, cold); }});
+        b.push_back({"CalculateMeanVars<Vec3>" + suffix,  [=](BenchmarkState &s) { BenchmarkCalculateMeanVars<Vec3> (s, cold); }});
+    }
+    for (const bool cold : {false, true})
+        for (unsigned char nDims = 2; nDims <= LUTMaxDims; nDims++)
+            b.push_back({"LookupTable/" + std::to_string(nDims) + "D" + (cold ? "/cold" : "/warm"),
+                         [=](BenchmarkState &s) { BenchmarkLookupTable(s, nDims, cold); }});
+    for (const std::string &material : LUTMaterials)
+        for (const std::string variant : {"reduced", "warm", "cold"})
+            b.push_back({"GetAlbedo/" + material + "/" + variant,
+                         [=](BenchmarkState &s) { BenchmarkGetAlbedo(s, material, variant); }});
+    return b;
+}
+
+static void usage(const char *msg = nullptr) {
+    if (msg)
+        fprintf(stderr, "pbrt_microbench: %s\n\n", msg);
+    fprintf(stderr, R"(usage: pbrt_microbench [<options>]
+Runs microbenchmarks of the statistics kernels (StatTile sample accumulation,
+Box-Cox transform, tile merging, mean variance calculation) and the LUT
+kernels (LookupTable(), Material::GetAlbedo()).
+
+Options:
+  --filter <regex>       Only run benchmarks whose names match the regex.
+  --list                 List the benchmarks and exit.
+  --mintime <seconds>    Minimum duration of a timed batch. Default: %.2f
+  --repetitions <num>    Number of timed batches. Default: %d
+  --tilesize <num>       Tile width and height. Default: %d
+  --coldbytes <num>      Size of the working sets of the cold variants.
+                         Default: %zu
+)", DefaultMinTime, DefaultRepetitions, DefaultTileSize, DefaultColdBytes);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = 1; // Warning and above.
+
+    std::string filter;
+    bool list = false;
+    double minTime = DefaultMinTime;
+    int nRepetitions = DefaultRepetitions;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--list"))
+            list = true;
+        else if (i + 1 == argc && strcmp(argv[i], "--help"))
+            usage("missing value after option");
+        else if (!strcmp(argv[i], "--filter"))
+            filter = argv[++i];
+        else if (!strcmp(argv[i], "--mintime"))
+            minTime = std::max(1e-3, atof(argv[++i]));
+        else if (!strcmp(argv[i], "--repetitions"))
+            nRepetitions = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--tilesize"))
+            tileSize = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--coldbytes"))
+            coldBytes = std::max(1ll, atoll(argv[++i]));
+        else
+            usage();
+    }
+
+    const std::regex regex(filter);
+    if (!list)
+        printf("%-40s %12s %12s %12s\n", "Benchmark", "ns/item", "min ns/item", "Iterations");
+    for (const Benchmark &benchmark : GetBenchmarks()) {
+        if (!filter.empty() && !std::regex_search(benchmark.name, regex))
+            continue;
+        if (list) {
+            printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+
+        BenchmarkState state(minTime, nRepetitions);
+        benchmark.fn(state);
+        std::vector<double> times = state.nsPerItem;
+        std::sort(times.begin(), times.end());
+        printf("%-40s %12.3f %12.3f %12lld\n", benchmark.name.c_str(), times[times.size() / 2], times[0],
+               (long long)state.batchSize);
+        fflush(stdout);
+    }
+
+    return 0;
+}
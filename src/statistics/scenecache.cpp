@@ -0,0 +1,228 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// statistics/scenecache.cpp*
+#include "statistics/scenecache.h"
+#include "fileutil.h"
+#include "parallel.h"
+#include "stats.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef PBRT_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+#ifdef PBRT_IS_WINDOWS
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <fstream>
+
+namespace pbrt {
+
+STAT_COUNTER("Scene cache/Entries read", sceneCacheReads);
+STAT_COUNTER("Scene cache/Entries written", sceneCacheWrites);
+
+static std::string SceneCacheFilename(const char *kind, uint64_t key) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s-%016llx.bin", kind,
+             (unsigned long long)key);
+    return PbrtOptions.sceneCacheDir + "/" + name;
+}
+
+static size_t SectionsOffset(size_t nSections) {
+    const size_t end =
+        sizeof(SceneCacheHeader) + nSections * sizeof(SceneCacheSection);
+    return (end + 63) & ~(size_t)63;
+}
+
+// SceneCacheKey Method Definitions
+SceneCacheKey::SceneCacheKey(const char *kind) : hash(0x9e3779b97f4a7c15ull) {
+    Add(std::string(kind));
+    Add(SceneCacheVersion);
+    Add(sizeof(Float));
+}
+
+void SceneCacheKey::Add(const void *data, size_t size) {
+    // Word-wise multiply-rotate hashing (as in the MurmurHash3 body); the
+    // final mixing is done in Get()
+    const char *bytes = (const char *)data;
+    auto mix = [this](uint64_t v) {
+        v *= 0x87c37b91114253d5ull;
+        v = (v << 31) | (v >> 33);
+        hash ^= v * 0x4cf5ad432745937full;
+        hash = ((hash << 27) | (hash >> 37)) * 5 + 0x52dce729;
+    };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, bytes + i, 8);
+        mix(v);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    mix(tail ^ ((uint64_t)size << 56));
+}
+
+void SceneCacheKey::Add(const std::string &s) {
+    Add(s.size());
+    Add(s.data(), s.size());
+}
+
+bool SceneCacheKey::AddFile(const std::string &filename) {
+    struct stat fileStat;
+    if (stat(filename.c_str(), &fileStat) != 0) return false;
+    Add(AbsolutePath(filename));
+    Add((int64_t)fileStat.st_size);
+    Add((int64_t)fileStat.st_mtime);
+    return true;
+}
+
+uint64_t SceneCacheKey::Get() const {
+    uint64_t v = hash;
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdull;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ull;
+    v ^= v >> 33;
+    return v;
+}
+
+// SceneCacheEntry Method Definitions
+std::unique_ptr<SceneCacheEntry> SceneCacheEntry::Read(const char *kind,
+                                                       uint64_t key) {
+    const std::string filename = SceneCacheFilename(kind, key);
+    std::unique_ptr<SceneCacheEntry> entry(new SceneCacheEntry());
+    size_t length;
+
+#ifdef PBRT_HAVE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;  // Not cached yet
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 ||
+        (size_t)fileStat.st_size < sizeof(SceneCacheHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    length = fileStat.st_size;
+    void *ptr = mmap(0, length, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        Warning("%s: %s", filename.c_str(), strerror(errno));
+        return nullptr;
+    }
+    entry->mapping       = ptr;
+    entry->mappingLength = length;
+    entry->data          = (const char *)ptr;
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return nullptr;  // Not cached yet
+    in.seekg(0, std::ios::end);
+    length = in.tellg();
+    in.seekg(0, std::ios::beg);
+    // Over-allocate so that the sections can be 64-byte aligned in memory
+    entry->buffer.resize(length + 64);
+    char *start = &entry->buffer[0] + (64 - (uintptr_t)&entry->buffer[0] % 64) % 64;
+    if (!in.read(start, length)) {
+        Warning("%s: unable to read scene cache entry", filename.c_str());
+        return nullptr;
+    }
+    entry->data = start;
+#endif
+
+    // Validate header and section table
+    SceneCacheHeader header;
+    memcpy(&header, entry->data, sizeof(header));
+    if (memcmp(header.magic, SceneCacheMagic, sizeof(SceneCacheMagic)) != 0 ||
+        header.version != SceneCacheVersion || header.key != key ||
+        strncmp(header.kind, kind, sizeof(header.kind)) != 0 ||
+        length < SectionsOffset(header.nSections)) {
+        Warning("%s: invalid scene cache entry; ignoring it", filename.c_str());
+        return nullptr;
+    }
+    entry->sections.resize(header.nSections);
+    memcpy(&entry->sections[0], entry->data + sizeof(header),
+           header.nSections * sizeof(SceneCacheSection));
+    for (const SceneCacheSection &section : entry->sections)
+        if (section.offset % 64 != 0 || section.offset > length ||
+            section.elementSize == 0 ||
+            section.count > (length - section.offset) / section.elementSize) {
+            Warning("%s: truncated scene cache entry; ignoring it",
+                    filename.c_str());
+            return nullptr;
+        }
+
+    ++sceneCacheReads;
+    LOG(INFO) << "Using scene cache entry " << filename;
+    return entry;
+}
+
+SceneCacheEntry::~SceneCacheEntry() {
+#ifdef PBRT_HAVE_MMAP
+    if (mapping && mappingLength > 0)
+        if (munmap(mapping, mappingLength) != 0)
+            Error("munmap: %s", strerror(errno));
+#endif
+}
+
+// SceneCacheWriter Method Definitions
+bool SceneCacheWriter::Write(const char *kind, uint64_t key) const {
+    const std::string &dir = PbrtOptions.sceneCacheDir;
+#ifdef PBRT_IS_WINDOWS
+    _mkdir(dir.c_str());
+    const int pid = _getpid();
+#else
+    mkdir(dir.c_str(), 0755);
+    const int pid = getpid();
+#endif
+    const std::string filename = SceneCacheFilename(kind, key);
+    // Entries may be written concurrently by asynchronous loads
+    const std::string tmpFilename = filename + ".tmp" + std::to_string(pid) +
+                                    "-" + std::to_string(ThreadIndex);
+
+    // Lay out sections
+    SceneCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SceneCacheMagic, sizeof(SceneCacheMagic));
+    header.version   = SceneCacheVersion;
+    header.nSections = sections.size();
+    header.key       = key;
+    strncpy(header.kind, kind, sizeof(header.kind));
+    std::vector<SceneCacheSection> table(sections.size());
+    uint64_t offset = SectionsOffset(sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        table[i] = {offset, sections[i].count, sections[i].elementSize};
+        offset += (sections[i].count * sections[i].elementSize + 63) & ~(uint64_t)63;
+    }
+
+    // Write header, section table and sections (padded to 64 bytes)
+    std::ofstream out(tmpFilename, std::ios::binary);
+    const char padding[64] = {};
+    auto pad = [&]() {
+        out.write(padding, (64 - (uint64_t)out.tellp() % 64) % 64);
+    };
+    out.write((const char *)&header, sizeof(header));
+    if (!table.empty())
+        out.write((const char *)&table[0], table.size() * sizeof(table[0]));
+    pad();
+    for (const Section &section : sections) {
+        out.write(section.data, section.count * section.elementSize);
+        pad();
+    }
+    out.close();
+    if (!out || rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        Warning("%s: unable to write scene cache entry", filename.c_str());
+        remove(tmpFilename.c_str());
+        return false;
+    }
+
+    ++sceneCacheWrites;
+    LOG(INFO) << "Wrote scene cache entry " << filename;
+    return true;
+}
+
+}  // namespace pbrt
@@ -0,0 +1,123 @@
+// © 2024-2025 Hiroyuki Sakai
+
+#if defined(_MSC_VER)
+#define NOMINMAX
+#pragma once
+#endif
+
+#ifndef PBRT_STATISTICS_SCENECACHE_H
+#define PBRT_STATISTICS_SCENECACHE_H
+
+// statistics/scenecache.h*
+#include "pbrt.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace pbrt {
+
+// Scene Cache Declarations
+// With --scenecache <dir>, the results of the expensive steps of scene setup
+// (parsed PLY meshes, MIP map pyramids and BVHs) are stored in
+// "<dir>/<kind>-<key>.bin" and reused by later runs. The key is a hash of all
+// inputs of the cached data (e.g., the file's path, size and modification
+// time, or the primitive bounds of a BVH), so entries never have to be
+// invalidated and changing only the integrator or sampler of a scene reuses
+// all of them.
+//
+// An entry consists of a SceneCacheHeader, a table of SceneCacheSections and
+// the sections' data, each section aligned to 64 bytes. The version has to be
+// incremented whenever the layout of an entry or section changes.
+static PBRT_CONSTEXPR char     SceneCacheMagic[8] = {'P', 'B', 'R', 'T', 'S', 'C', 'C', '\0'};
+static PBRT_CONSTEXPR uint32_t SceneCacheVersion  = 1;
+
+struct SceneCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nSections;
+    uint64_t key;
+    char     kind[8];
+};
+static_assert(sizeof(SceneCacheHeader) == 32, "Unexpected SceneCacheHeader size");
+
+struct SceneCacheSection {
+    uint64_t offset;       // Byte offset of the data from the file start
+    uint64_t count;        // Number of elements
+    uint64_t elementSize;  // Size of an element in bytes
+};
+
+// Accumulates the inputs of a cache entry into a 64-bit key
+class SceneCacheKey {
+  public:
+    SceneCacheKey(const char *kind);
+    void Add(const void *data, size_t size);
+    // Values are hashed bytewise, so they must not contain padding or
+    // pointers
+    template <typename T>
+    void Add(const T &value) {
+        Add(&value, sizeof(T));
+    }
+    void Add(const std::string &s);
+    // Adds the absolute path, size and modification time of the file; returns
+    // false if the file does not exist
+    bool AddFile(const std::string &filename);
+    uint64_t Get() const;
+
+  private:
+    uint64_t hash;
+};
+
+// Read-only entry of the scene cache (memory-mapped if possible)
+class SceneCacheEntry {
+  public:
+    // Returns nullptr if there is no valid entry of _kind_ for _key_
+    static std::unique_ptr<SceneCacheEntry> Read(const char *kind, uint64_t key);
+    ~SceneCacheEntry();
+    int NumSections() const { return sections.size(); }
+    // Returns the data of section _i_ and sets _count_, or returns nullptr if
+    // the section does not consist of elements of type _T_
+    template <typename T>
+    const T *Section(int i, size_t *count) const {
+        if (i >= NumSections() || sections[i].elementSize != sizeof(T))
+            return nullptr;
+        *count = sections[i].count;
+        return (const T *)(data + sections[i].offset);
+    }
+
+  private:
+    SceneCacheEntry() {}
+
+    void                          *mapping       = nullptr;
+    size_t                         mappingLength = 0;
+    std::vector<char>              buffer; // Used if the file cannot be mapped
+    const char                    *data = nullptr;
+    std::vector<SceneCacheSection> sections;
+};
+
+// Collects the sections of a new entry and writes it
+class SceneCacheWriter {
+  public:
+    // Values are stored bytewise, so they must not contain pointers
+    template <typename T>
+    void AddSection(const T *values, size_t count) {
+        sections.push_back({(const char *)values, count, sizeof(T)});
+    }
+    // The data of the sections has to be valid until the entry is written.
+    // The entry is written to a temporary file that is then renamed, so that
+    // concurrent runs and threads never read partial entries.
+    bool Write(const char *kind, uint64_t key) const;
+
+  private:
+    struct Section {
+        const char *data;
+        size_t      count;
+        size_t      elementSize;
+    };
+    std::vector<Section> sections;
+};
+
+inline bool SceneCacheEnabled() { return !PbrtOptions.sceneCacheDir.empty(); }
+
+}  // namespace pbrt
+
+#endif  // PBRT_STATISTICS_SCENECACHE_H
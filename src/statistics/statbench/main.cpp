@@ -0,0 +1,395 @@
+// © 2024-2025 Hiroyuki Sakai
+
+// End-to-end benchmark of StatPathIntegrator. Small procedural scenes are
+// rendered in-process with fixed seeds in each integrator configuration;
+// the per-iteration metrics (see --metricsfile) of the non-warm-up
+// iterations are summarized and optionally compared to a baseline.
+
+#include <cmath>      // std::abs
+#include <cstdio>     // printf
+#include <cstring>    // strcmp
+#include <filesystem> // std::filesystem
+#include <fstream>    // std::ifstream
+#include <map>        // std::map
+#include <sstream>    // std::ostringstream
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+#include "pbrt.h"
+#include "api.h"      // pbrtInit(), pbrtParseString(), ...
+#include "parallel.h" // MaxThreadIndex()
+#include "stats.h"    // ClearStats()
+
+#include "rapidjson/document.h"
+#include "rapidjson/filereadstream.h"
+
+using namespace pbrt;
+
+static PBRT_CONSTEXPR int    DefaultResolution = 128;
+static PBRT_CONSTEXPR int    DefaultSPP        = 4;
+static PBRT_CONSTEXPR int    DefaultIterations = 2;
+static PBRT_CONSTEXPR double DefaultTolerance  = .1; // Relative change that is reported as a regression
+static PBRT_CONSTEXPR int    BaseSeed          = 1;
+
+struct BenchScene {
+    std::string name;
+    std::string camera; // LookAt and Camera directives
+    std::string world;  // Contents of the world block
+};
+
+struct BenchConfig {
+    std::string name;
+    std::string params; // Additional StatPathIntegrator parameters
+};
+
+// Summary of the non-warm-up iterations of a run
+struct BenchResult {
+    double samplesPerSecond = 0;
+    double nsPerSample = 0;           // Render thread time per sample
+    double statsNsPerSample = 0;      // nsPerSample minus that of "plain" with the same multichannelstats setting
+    double mergeTimeNs = 0;           // Summed over threads
+    double denoiseTimeNs = 0;         // Upload, denoising, and download
+    double peakRSSBytes = 0;          // Process-wide, i.e., includes earlier runs
+    double bufferBytes = 0;
+};
+
+// Metrics that are compared to the baseline, and whether larger is better
+static const std::vector<std::pair<std::string, bool>> ComparedMetrics = {
+    {"samplesPerSecond", true},
+    {"statsNsPerSample", false},
+    {"mergeTimeNs",      false},
+    {"denoiseTimeNs",    false},
+    {"bufferBytes",      false}
+};
+
+static double GetMetric(const BenchResult &r, const std::string &name) {
+    if (name == "samplesPerSecond") return r.samplesPerSecond;
+    if (name == "nsPerSample")      return r.nsPerSample;
+    if (name == "statsNsPerSample") return r.statsNsPerSample;
+    if (name == "mergeTimeNs")      return r.mergeTimeNs;
+    if (name == "denoiseTimeNs")    return r.denoiseTimeNs;
+    if (name == "peakRSSBytes")     return r.peakRSSBytes;
+    if (name == "bufferBytes")      return r.bufferBytes;
+    return 0;
+}
+
+static std::string QuadShape(const char *material, const Point3f &p0, const Point3f &p1, const Point3f &p2, const Point3f &p3) {
+    std::ostringstream s;
+    s << "AttributeBegin\n" << material << "\n"
+      << "Shape \"trianglemesh\" \"integer indices\" [0 1 2 0 2 3] \"point P\" ["
+      << p0.x << " " << p0.y << " " << p0.z << " " << p1.x << " " << p1.y << " " << p1.z << " "
+      << p2.x << " " << p2.y << " " << p2.z << " " << p3.x << " " << p3.y << " " << p3.z << "]\n"
+      << "AttributeEnd\n";
+    return s.str();
+}
+
+static std::string SphereShape(const char *material, const Point3f &center, const Float radius, const std::string &emission = "") {
+    std::ostringstream s;
+    s << "AttributeBegin\n" << emission << material << "\n"
+      << "Translate " << center.x << " " << center.y << " " << center.z << "\n"
+      << "Shape \"sphere\" \"float radius\" [" << radius << "]\n"
+      << "AttributeEnd\n";
+    return s.str();
+}
+
+static std::vector<BenchScene> GetScenes() {
+    const char *white = "Material \"matte\" \"rgb Kd\" [.7 .7 .7]";
+    const char *red   = "Material \"matte\" \"rgb Kd\" [.6 .05 .05]";
+    const char *green = "Material \"matte\" \"rgb Kd\" [.1 .5 .1]";
+    const char *glass = "Material \"glass\" \"float index\" [1.5]";
+    std::vector<BenchScene> scenes;
+
+    // Diffuse interreflections with a small area light
+    {
+        BenchScene scene;
+        scene.name = "cornell";
+        scene.camera = "LookAt 0 1 3.4  0 1 0  0 1 0\nCamera \"perspective\" \"float fov\" [40]\n";
+        scene.world =
+            QuadShape(white, {-1, 0, -1}, { 1, 0, -1}, { 1, 0,  1}, {-1, 0,  1}) + // Floor
+            QuadShape(white, {-1, 2, -1}, {-1, 2,  1}, { 1, 2,  1}, { 1, 2, -1}) + // Ceiling
+            QuadShape(white, {-1, 0, -1}, {-1, 2, -1}, { 1, 2, -1}, { 1, 0, -1}) + // Back wall
+            QuadShape(red,   {-1, 0, -1}, {-1, 0,  1}, {-1, 2,  1}, {-1, 2, -1}) +
+            QuadShape(green, { 1, 0, -1}, { 1, 2, -1}, { 1, 2,  1}, { 1, 0,  1}) +
+            QuadShape("AreaLightSource \"diffuse\" \"rgb L\" [17 12 4] \"bool twosided\" \"true\"\nMaterial \"matte\" \"rgb Kd\" [0 0 0]",
+                 {-.25f, 1.99f, -.25f}, {.25f, 1.99f, -.25f}, {.25f, 1.99f, .25f}, {-.25f, 1.99f, .25f}) +
+            SphereShape(white, {-.4f, .35f, -.3f}, .35f) +
+            SphereShape("Material \"plastic\" \"rgb Kd\" [.2 .2 .6] \"rgb Ks\" [.3 .3 .3] \"float roughness\" [.05]", {.45f, .3f, .3f}, .3f);
+        scenes.push_back(scene);
+    }
+
+    // Caustics from a glass sphere and a small, bright light
+    {
+        BenchScene scene;
+        scene.name = "caustics";
+        scene.camera = "LookAt 0 2 4  0 .4 0  0 1 0\nCamera \"perspective\" \"float fov\" [35]\n";
+        scene.world =
+            QuadShape(white, {-4, 0, -4}, { 4, 0, -4}, { 4, 0,  4}, {-4, 0,  4}) +
+            SphereShape(glass, {0, .6f, 0}, .6f) +
+            SphereShape(glass, {-1.1f, .3f, .5f}, .3f) +
+            SphereShape("Material \"matte\" \"rgb Kd\" [0 0 0]", {1.5f, 3, 1}, .05f,
+                   "AreaLightSource \"diffuse\" \"rgb L\" [800 800 800]\n");
+        scenes.push_back(scene);
+    }
+
+    // Many small lights, which stresses the light sampling
+    {
+        BenchScene scene;
+        scene.name = "manylights";
+        scene.camera = "LookAt 0 3 5  0 0 0  0 1 0\nCamera \"perspective\" \"float fov\" [45]\n";
+        scene.world =
+            QuadShape(white, {-4, 0, -4}, { 4, 0, -4}, { 4, 0,  4}, {-4, 0,  4}) +
+            QuadShape(white, {-4, 0, -2}, {-4, 3, -2}, { 4, 3, -2}, { 4, 0, -2});
+        const int nLights = 8;
+        for (int y = 0; y < nLights; y++)
+            for (int x = 0; x < nLights; x++) {
+                std::ostringstream emission;
+                emission << "AreaLightSource \"diffuse\" \"rgb L\" ["
+                         << 2 + 6 * (x % 3) << " " << 2 + 6 * (y % 3) << " " << 2 + 3 * ((x + y) % 4) << "]\n";
+                scene.world += SphereShape("Material \"matte\" \"rgb Kd\" [0 0 0]",
+                                      {-3.5f + x, .1f, -1.5f + y * .5f}, .05f, emission.str());
+            }
+        scene.world += SphereShape(white, {0, .5f, 0}, .5f);
+        scenes.push_back(scene);
+    }
+
+    return scenes;
+}
+
+static std::vector<BenchConfig> GetConfigs() {
+    return {
+        {"plain",           ""},
+        {"denoiseimage",    "\"bool denoiseimage\" \"true\""},
+        {"acrr",            "\"bool acrr\" \"true\""},
+        {"smis",            "\"bool smis\" \"true\""},
+        {"calcprodenstats", "\"bool calcprodenstats\" \"true\""}
+    };
+}
+
+// Renders _scene_ with _config_ and summarizes the metrics written by the
+// integrator
+static BenchResult Run(
+    const BenchScene   &scene,
+    const BenchConfig  &config,
+    const bool          multiChannelStats,
+    const int           nThreads,
+    const int           resolution,
+    const int           spp,
+    const int           nIterations,
+    const std::string  &metricsFilename
+) {
+    Options options;
+    options.nThreads = nThreads;
+    options.quiet = true;
+    options.warmUp = true;
+    options.baseSeed = BaseSeed;
+    options.metricsFile = metricsFilename;
+
+    std::ostringstream s;
+    s << scene.camera
+      << "Film \"image\" \"integer xresolution\" [" << resolution << "] \"integer yresolution\" [" << resolution << "]"
+      << " \"string filename\" \"statbench.exr\"\n"
+      << "Sampler \"random\" \"integer pixelsamples\" [" << spp << "]\n"
+      << "Integrator \"statpath\" \"integer maxdepth\" [5] \"integer iterations\" [" << nIterations << "]"
+      << " \"bool expiterations\" \"false\" \"bool multichannelstats\" \"" << (multiChannelStats ? "true" : "false") << "\" "
+      << config.params << "\n"
+      << "WorldBegin\n" << scene.world << "WorldEnd\n";
+
+    pbrtInit(options);
+    pbrtParseString(s.str());
+    pbrtCleanup();
+    ClearStats();
+
+    BenchResult result;
+    std::ifstream file(metricsFilename);
+    std::string line;
+    int nRecords = 0;
+    double renderTimeNs = 0, nSamples = 0;
+    while (std::getline(file, line)) {
+        rapidjson::Document record;
+        record.Parse(line.c_str());
+        if (record.HasParseError() || !record.IsObject() || record["warmUp"].GetDouble() != 0)
+            continue;
+        const double iterationRenderTimeNs = record["renderTimeNs"].GetDouble();
+        renderTimeNs           += iterationRenderTimeNs;
+        nSamples               += record["samplesPerSecond"].GetDouble() * iterationRenderTimeNs * 1e-9;
+        result.mergeTimeNs     += record["mergeTimeNs"].GetDouble();
+        result.denoiseTimeNs   += record["cudaTimeNs"].GetDouble();
+        result.peakRSSBytes     = std::max(result.peakRSSBytes, record["peakRSSBytes"].GetDouble());
+        result.bufferBytes      = std::max(result.bufferBytes,  record["bufferBytes"].GetDouble());
+        nRecords++;
+    }
+    if (nRecords == 0 || nSamples == 0) {
+        Error("%s: no metrics were written", metricsFilename.c_str());
+        exit(1);
+    }
+    result.samplesPerSecond = nSamples / (renderTimeNs * 1e-9);
+    result.nsPerSample = renderTimeNs * MaxThreadIndex() / nSamples;
+    return result;
+}
+
+static std::map<std::string, std::map<std::string, double>> ReadBaseline(const std::string &filename) {
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (!fp) {
+        Error("%s: unable to open baseline file", filename.c_str());
+        exit(1);
+    }
+    char buffer[65536];
+    rapidjson::FileReadStream stream(fp, buffer, sizeof(buffer));
+    rapidjson::Document document;
+    document.ParseStream(stream);
+    fclose(fp);
+    if (document.HasParseError() || !document.IsObject() || !document.HasMember("results")) {
+        Error("%s: invalid baseline file", filename.c_str());
+        exit(1);
+    }
+
+    std::map<std::string, std::map<std::string, double>> baseline;
+    for (auto &run : document["results"].GetObject())
+        for (auto &metric : run.value.GetObject())
+            baseline[run.name.GetString()][metric.name.GetString()] = metric.value.GetDouble();
+    return baseline;
+}
+
+static void WriteBaseline(const std::string &filename, const std::vector<std::pair<std::string, BenchResult>> &results) {
+    FILE *fp = fopen(filename.c_str(), "w");
+    if (!fp) {
+        Error("%s: unable to open baseline file", filename.c_str());
+        exit(1);
+    }
+    fprintf(fp, "{\n  \"results\": {");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(fp, "%s\n    \"%s\": {", i > 0 ? "," : "", results[i].first.c_str());
+        for (size_t j = 0; j < ComparedMetrics.size(); j++)
+            fprintf(fp, "%s\"%s\": %.17g", j > 0 ? ", " : "", ComparedMetrics[j].first.c_str(),
+                    GetMetric(results[i].second, ComparedMetrics[j].first));
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  }\n}\n");
+    fclose(fp);
+}
+
+static void usage(const char *msg = nullptr) {
+    if (msg)
+        fprintf(stderr, "statbench: %s\n\n", msg);
+    fprintf(stderr, R"(usage: statbench [<options>]
+Renders small procedural scenes (cornell, caustics, manylights) with
+StatPathIntegrator in the configurations plain, denoiseimage, acrr, smis, and
+calcprodenstats, each with multichannelstats on and off.
+
+Options:
+  --baseline <file>      Compare the results to the given baseline and exit
+                         with status 1 if any metric regressed.
+  --writebaseline <file> Write the results as a baseline to the given file.
+  --tolerance <frac>     Relative change that is reported as a regression.
+                         Default: %.2f
+  --nthreads <num>       Use specified number of threads for rendering.
+  --resolution <num>     Image width and height. Default: %d
+  --spp <num>            Samples per pixel per iteration. Default: %d
+  --iterations <num>     Number of iterations (after a warm-up iteration).
+                         Default: %d
+  --scene <name>         Only render the given scene.
+  --config <name>        Only use the given configuration.
+)", DefaultTolerance, DefaultResolution, DefaultSPP, DefaultIterations);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = 1; // Warning and above.
+
+    std::string baselineFilename, writeBaselineFilename, sceneFilter, configFilter;
+    double tolerance = DefaultTolerance;
+    int nThreads = 0;
+    int resolution = DefaultResolution;
+    int spp = DefaultSPP;
+    int nIterations = DefaultIterations;
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 == argc && strcmp(argv[i], "--help"))
+            usage("missing value after option");
+        if (!strcmp(argv[i], "--baseline"))
+            baselineFilename = argv[++i];
+        else if (!strcmp(argv[i], "--writebaseline"))
+            writeBaselineFilename = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance"))
+            tolerance = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--nthreads"))
+            nThreads = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--resolution"))
+            resolution = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--spp"))
+            spp = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--iterations"))
+            nIterations = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--scene"))
+            sceneFilter = argv[++i];
+        else if (!strcmp(argv[i], "--config"))
+            configFilter = argv[++i];
+        else
+            usage();
+    }
+
+    const std::filesystem::path metricsDir = std::filesystem::temp_directory_path();
+    std::vector<std::pair<std::string, BenchResult>> results;
+    for (const BenchScene &scene : GetScenes()) {
+        if (!sceneFilter.empty() && scene.name != sceneFilter)
+            continue;
+        for (const bool multiChannelStats : {false, true}) {
+            double plainNsPerSample = -1;
+            for (const BenchConfig &config : GetConfigs()) {
+                // "plain" is always run, as it is the reference for statsNsPerSample
+                if (!configFilter.empty() && config.name != configFilter && config.name != "plain")
+                    continue;
+                const std::string name = scene.name + "/" + config.name + (multiChannelStats ? "/mc" : "/sc");
+                const std::string metricsFilename =
+                    (metricsDir / ("statbench-" + std::to_string(results.size()) + ".jsonl")).string();
+
+                BenchResult result = Run(scene, config, multiChannelStats, nThreads, resolution, spp, nIterations, metricsFilename);
+                std::filesystem::remove(metricsFilename);
+                if (config.name == "plain")
+                    plainNsPerSample = result.nsPerSample;
+                result.statsNsPerSample = std::max(0., result.nsPerSample - plainNsPerSample);
+                if (configFilter.empty() || config.name == configFilter)
+                    results.push_back({name, result});
+            }
+        }
+    }
+
+    printf("\n%-34s %12s %10s %10s %12s %12s %10s %10s\n", "Run", "Samples/s", "ns/sample",
+           "Stats ns", "Merge [ms]", "Denoise [ms]", "Peak [MB]", "Bufs [MB]");
+    for (const auto &r : results)
+        printf("%-34s %12.4g %10.1f %10.1f %12.2f %12.2f %10.1f %10.1f\n", r.first.c_str(),
+               r.second.samplesPerSecond, r.second.nsPerSample, r.second.statsNsPerSample,
+               r.second.mergeTimeNs * 1e-6, r.second.denoiseTimeNs * 1e-6,
+               r.second.peakRSSBytes / (1 << 20), r.second.bufferBytes / (1 << 20));
+
+    if (!writeBaselineFilename.empty())
+        WriteBaseline(writeBaselineFilename, results);
+
+    int nRegressions = 0;
+    if (!baselineFilename.empty()) {
+        const std::map<std::string, std::map<std::string, double>> baseline = ReadBaseline(baselineFilename);
+        printf("\nComparison to %s (tolerance %.0f%%):\n", baselineFilename.c_str(), tolerance * 100);
+        for (const auto &r : results) {
+            auto run = baseline.find(r.first);
+            if (run == baseline.end()) {
+                printf("%-34s not in baseline\n", r.first.c_str());
+                continue;
+            }
+            for (const auto &metric : ComparedMetrics) {
+                auto value = run->second.find(metric.first);
+                if (value == run->second.end() || value->second == 0)
+                    continue;
+                const double change = GetMetric(r.second, metric.first) / value->second - 1;
+                const bool regressed = metric.second ? change < -tolerance : change > tolerance;
+                if (regressed || std::abs(change) > tolerance)
+                    printf("%-34s %-18s %+7.1f%% %s\n", r.first.c_str(), metric.first.c_str(),
+                           change * 100, regressed ? "REGRESSION" : "improvement");
+                nRegressions += regressed;
+            }
+        }
+        printf("%d regression(s)\n", nRegressions);
+    }
+
+    return nRegressions > 0 ? 1 : 0;
+}
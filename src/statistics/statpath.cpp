@@ -4,8 +4,12 @@
 #include "progressreporter.h"
 #include "camera.h"
 #include "scene.h"
+#include "stats.h"
+#include "statistics/metrics.h"
 
 #include <filesystem>
+#include <numeric>
+#include <unordered_set>
 
 #include "materials/disney.h"
 #include "materials/fourier.h"
@@ -30,6 +34,62 @@ STAT_COUNTER("Integrator/Camera rays traced", nCameraRays);
 STAT_PERCENT("Integrator/Zero-radiance paths", zeroRadiancePaths, totalPaths);
 STAT_INT_DISTRIBUTION("Integrator/Path length", pathLength);
 
+// Tile size selection in auto mode (tilesize 0): the initial size yields about
+// AutoTilesPerThread tiles per thread for load balancing. After a RenderLoop()
+// call, tiles are enlarged if their overhead (sampler cloning, tile
+// allocation, and merging) exceeds AutoMaxOverhead of the tile time, as long
+// as there are at least AutoMinTilesPerThread tiles per thread, and shrunk if
+// the overhead is negligible and there are too few tiles.
+static PBRT_CONSTEXPR int    AutoTileSizeMin       = 8;
+static PBRT_CONSTEXPR int    AutoTileSizeMax       = 128;
+static PBRT_CONSTEXPR int    AutoTilesPerThread    = 16;
+static PBRT_CONSTEXPR int    AutoMinTilesPerThread = 4;
+static PBRT_CONSTEXPR double AutoMaxOverhead       = .05;
+static PBRT_CONSTEXPR double AutoMinOverhead       = .01;
+
+static double TilesPerThread(const Vector2i &extent, const int tileSize, const int nThreads) {
+    return (double)((extent.x + tileSize - 1) / tileSize) * ((extent.y + tileSize - 1) / tileSize) / nThreads;
+}
+
+static int AutoTileSize(const Vector2i &extent, const int nThreads) {
+    const double size = std::sqrt((double)extent.x * extent.y / (nThreads * AutoTilesPerThread));
+    // Round to a multiple of AutoTileSizeMin
+    const int tileSize = (int)std::round(size / AutoTileSizeMin) * AutoTileSizeMin;
+    return Clamp(tileSize, AutoTileSizeMin, AutoTileSizeMax);
+}
+
+static int AdaptTileSize(const int tileSize, const double overhead, const Vector2i &extent, const int nThreads) {
+    LOG(INFO) << "Tile overhead: " << overhead * 100. << " %";
+    if (overhead > AutoMaxOverhead && 2 * tileSize <= AutoTileSizeMax &&
+        TilesPerThread(extent, 2 * tileSize, nThreads) >= AutoMinTilesPerThread)
+        return 2 * tileSize;
+    if (overhead < AutoMinOverhead && tileSize / 2 >= AutoTileSizeMin &&
+        TilesPerThread(extent, tileSize, nThreads) < AutoTilesPerThread)
+        return tileSize / 2;
+    return tileSize;
+}
+
+// Host memory of all registered buffers (some of which share their data)
+static size_t BufferBytes(const BufferRegistry &reg) {
+    size_t bytes = 0;
+    std::unordered_set<const void *> counted;
+    for (const Buffer &b : reg.buffers)
+        for (const Mat *mat : {&b.mat, &b.outMat})
+            if (!mat->empty() && counted.insert(mat->data).second)
+                bytes += mat->total() * mat->elemSize();
+    return bytes;
+}
+
+// Returns the number of camera rays and of all rays (regular and shadow)
+// traced so far; the worker threads' counters are merged first
+static std::pair<int64_t, int64_t> RayCounts() {
+    MergeWorkerThreadStats();
+    ReportThreadStats();
+    return {GetStatsCounter("Integrator/Camera rays traced"),
+            GetStatsCounter("Intersections/Regular ray intersection tests") +
+            GetStatsCounter("Intersections/Shadow ray intersection tests")};
+}
+
 StatPathIntegrator::StatPathIntegrator(
     const unsigned int maxDepth,
     std::shared_ptr<const Camera> camera,
@@ -47,8 +107,10 @@ StatPathIntegrator::StatPathIntegrator(
     GBufferConfigs floatGBufferConfigs,
     GBufferConfigs rgbGBufferConfigs,
     StatTypeConfigs statTypeConfigs,
+    const int tileSize,
     const Float rrThreshold,
     const std::string &lightSampleStrategy,
+    const bool precomputeLightDistribution,
     const std::string &outputRegex
 ) : SamplerIntegrator(camera, sampler, pixelBounds),
     floatGBufferConfigs(floatGBufferConfigs),
@@ -75,16 +137,27 @@ StatPathIntegrator::StatPathIntegrator(
     denoiseImage(denoiseImage),
     enableSMIS(enableSMIS),
     calculateItStats(calculateItStats),
+    requestedTileSize(tileSize),
     maxDepth(maxDepth),
     rrThreshold(rrThreshold),
     lightSampleStrategy(lightSampleStrategy),
+    precomputeLightDistribution(precomputeLightDistribution),
     outputRegex(outputRegex)
 {
     estimator.AllocateBuffers(bufferReg);
 }
 
 void StatPathIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
+    TraceScope t("Light distribution construction");
+    if (lightSampleStrategy == "bvh") {
+        lightBVH.reset(new LightBVH(scene.lights));
+        return;
+    }
     lightDistribution = CreateLightSampleDistribution(lightSampleStrategy, scene);
+    if (precomputeLightDistribution)
+        if (SpatialLightDistribution *spatial =
+                dynamic_cast<SpatialLightDistribution *>(lightDistribution.get()))
+            spatial->Precompute();
 }
 
 void StatPathIntegrator::Render(const Scene &scene) {
@@ -94,22 +167,22 @@ void StatPathIntegrator::Render(const Scene &scene) {
         Render<Float>(scene);
 }
 
-template <typename T>
-inline StatPathIntegrator::AddSampleFn<T> StatPathIntegrator::GetAddSampleFn(const StatTypeConfig &cfg) {
+template <typename T, typename P>
+inline StatPathIntegrator::AddSampleFn<T, P> StatPathIntegrator::GetAddSampleFn(const StatTypeConfig &cfg) {
     if (cfg.transform) {
         if (cfg.maxMoment == 3)
-            return &StatTile<T>::AddTransformSampleM3;
+            return &StatTile<T, P>::AddTransformSampleM3;
         else if (cfg.maxMoment == 2)
-            return &StatTile<T>::AddTransformSampleM2;
+            return &StatTile<T, P>::AddTransformSampleM2;
         else if (cfg.maxMoment == 1)
-            return &StatTile<T>::AddTransformSampleM1;
+            return &StatTile<T, P>::AddTransformSampleM1;
     } else {
         if (cfg.maxMoment == 3)
-            return &StatTile<T>::AddSampleM3;
+            return &StatTile<T, P>::AddSampleM3;
         else if (cfg.maxMoment == 2)
-            return &StatTile<T>::AddSampleM2;
+            return &StatTile<T, P>::AddSampleM2;
         else if (cfg.maxMoment == 1)
-            return &StatTile<T>::AddSampleM1;
+            return &StatTile<T, P>::AddSampleM1;
     }
 
     return nullptr;
@@ -126,15 +199,13 @@ void StatPathIntegrator::Render(const Scene &scene) {
 
     // Render image tiles in parallel
 
-    // Compute number of tiles, _nTiles_, to use for parallel rendering
+    // The number of tiles, _nTiles_, to use for parallel rendering is set by
+    // SetTileSize() below
     const Bounds2i sampleBounds = camera->film->GetSampleBounds();
     const Vector2i sampleExtent = sampleBounds.Diagonal();
-    const unsigned char tileSize = 16;
-    const Point2i nTiles(
-        (sampleExtent.x + tileSize - 1) / tileSize,
-        (sampleExtent.y + tileSize - 1) / tileSize
-    );
-    const unsigned short nTilesTotal = nTiles.x * nTiles.y;
+    int tileSize = 0;
+    Point2i nTiles;
+    unsigned int nTilesTotal = 0;
 
     const unsigned char nFloatBuffers = floatGBufferConfigs.nEnabled;
     const unsigned char nRGBBuffers   = rgbGBufferConfigs.nEnabled;
@@ -143,19 +214,115 @@ void StatPathIntegrator::Render(const Scene &scene) {
 
     const unsigned char nLs = std::max((int)sCfgs[Radiance].bounceEnd, 1); // We need at least one item for the film
 
-    // Declare per-tile samplers
-    vector<unique_ptr<Sampler>> tileSamplers(nTilesTotal);
+    // If the pixel filter does not exceed a pixel (e.g., a box filter with
+    // radius .5), film samples are accumulated in the radiance statistics
+    // tiles (see FilmStatTilePixel) in the same pass
+    using LPixel = FilmStatTilePixel<T>;
+    const Vector2f &filterRadius = camera->film->filter->radius;
+    const bool fuseFilm = filterRadius.x <= .5f && filterRadius.y <= .5f && sCfgs[Radiance].bounceEnd > 0;
+
+    // Per-thread render resources, indexed by _ThreadIndex_; they are reused
+    // across tiles and iterations (each thread renders one tile at a time),
+    // so that arenas stay warm, scratch buffers are not reallocated, and only
+    // one sampler per thread is needed, which is reseeded for every tile
+    struct alignas(PBRT_L1_CACHE_LINE_SIZE) ThreadResources {
+        unique_ptr<Sampler>     sampler;
+        MemoryArena             arena;
+        Features                features;
+        vector<Float>           avgLs;
+        vector<MISWinRate>      misWinRates;
+        vector<Spectrum>        Ls;
+        vector<MISTally>        misTallies;
+    };
+    const unique_ptr<ThreadResources[]> threadResources(new ThreadResources[MaxThreadIndex()]);
+    for (int t = 0; t < MaxThreadIndex(); t++) {
+        ThreadResources &res = threadResources[t];
+        res.sampler = sampler->Clone(0);
+        res.features.floats   .resize(nFloatBuffers);
+        res.features.spectrums.resize(nRGBBuffers);
+        res.avgLs      .resize(sCfgs[Radiance].bounceEnd);
+        res.misWinRates.resize(sCfgs[MISBSDFWinRate].bounceEnd);
+        res.Ls         .resize(nLs);
+        res.misTallies .resize(sCfgs[MISBSDFWinRate].bounceEnd);
+    }
 
     // Declare tiles
-    vector<std::shared_ptr<FilmTile>>       filmTiles        (nTilesTotal);
-    vector<vector<StatTile<T>>>             lTiles           (nTilesTotal);
-    vector<vector<StatTile<Vec3>>>          itLTiles         (nTilesTotal);
-    vector<vector<vector<StatTile<Float>>>> misTallyTiles    (nTilesTotal);
-    vector<vector<vector<StatTile<Float>>>> floatFeatureTiles(nTilesTotal);
-    vector<vector<vector<StatTile<Vec3>>>>  rgbFeatureTiles  (nTilesTotal);
+    vector<std::shared_ptr<FilmTile>>       filmTiles;
+    vector<vector<StatTile<T, LPixel>>>     lTiles;
+    vector<vector<StatTile<Vec3>>>          itLTiles;
+    vector<vector<vector<StatTile<Float>>>> misTallyTiles;
+    vector<vector<vector<StatTile<Float>>>> floatFeatureTiles;
+    vector<vector<vector<StatTile<Vec3>>>>  rgbFeatureTiles;
+
+    // Render times of the tiles in the previous iteration; tiles are started
+    // in order of decreasing time so that expensive tiles do not finish last
+    vector<double>  tileTimes;
+    vector<int64_t> tileOrder;
+    vector<double>  tileMergeTimes; // For --metricsfile
+
+    // With --firsttouch, tiles are dealt to the thread that placed the rows
+    // of their buffers (see FirstTouchThread())
+    vector<int> tileHomes;
+
+    // Per-tile overhead (setup and merging) and total time of a RenderLoop()
+    // call, used to adapt the tile size in auto mode
+    vector<double> tileOverheads;
+    vector<double> tileTotalTimes;
+
+    auto SetTileSize = [&](const int size) {
+        if (size == tileSize)
+            return;
+        tileSize = size;
+        nTiles = Point2i(
+            (sampleExtent.x + tileSize - 1) / tileSize,
+            (sampleExtent.y + tileSize - 1) / tileSize
+        );
+        nTilesTotal = nTiles.x * nTiles.y;
+        LOG(INFO) << "Tile size: " << tileSize << " (" << nTilesTotal << " tiles)";
+
+        filmTiles        .clear(); filmTiles        .resize(nTilesTotal);
+        lTiles           .clear(); lTiles           .resize(nTilesTotal);
+        itLTiles         .clear(); itLTiles         .resize(nTilesTotal);
+        misTallyTiles    .clear(); misTallyTiles    .resize(nTilesTotal);
+        floatFeatureTiles.clear(); floatFeatureTiles.resize(nTilesTotal);
+        rgbFeatureTiles  .clear(); rgbFeatureTiles  .resize(nTilesTotal);
+        tileTimes.assign(nTilesTotal, 0.);
+        tileMergeTimes.assign(nTilesTotal, 0.);
+        tileOrder.resize(nTilesTotal);
+    };
+
+    // Compute sample bounds for tile (the tile index is wide, since small
+    // tiles on large images can exceed 65535 tiles)
+    auto GetTileBounds = [&](const int64_t tileIndex) {
+        const int x0 = sampleBounds.pMin.x + (int)(tileIndex % nTiles.x) * tileSize;
+        const int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        const int y0 = sampleBounds.pMin.y + (int)(tileIndex / nTiles.x) * tileSize;
+        const int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        return Bounds2i(Point2i(x0, y0), Point2i(x1, y1));
+    };
+
+    // Place the film and statistics buffers on the NUMA nodes of the threads
+    // that render the corresponding rows
+    if (PbrtOptions.firstTouch || PbrtOptions.hugePages) {
+        std::unordered_set<const void *> placed;
+        auto Place = [&](const Mat &mat) {
+            if (!mat.empty() && mat.isContinuous() && placed.insert(mat.data).second)
+                ParallelFirstTouch(mat.data, mat.cols * mat.elemSize(), mat.rows, PbrtOptions.hugePages);
+        };
+        for (const Buffer &b : bufferReg.buffers) {
+            Place(b.mat);
+            Place(b.outMat);
+        }
+        camera->film->FirstTouch(PbrtOptions.hugePages);
+    }
 
     OutputBufferSelection outBufSel(bufferReg, std::regex(outputRegex), camera->film->filename);
 
+    std::unique_ptr<MetricsFile> metricsFile;
+    if (!PbrtOptions.metricsFile.empty())
+        metricsFile.reset(new MetricsFile(PbrtOptions.metricsFile));
+    bool warmingUp = false;
+
     const std::vector<StatTypeConfig> featureCfgs = {sCfgs[StatMaterialID], sCfgs[StatDepth], sCfgs[StatNormal], sCfgs[StatAlbedo]};
     std::vector<StatTypeConfig> enabledFloatFeatureCfgs;
     std::vector<StatTypeConfig> enabledRGBFeatureCfgs;
@@ -163,50 +330,50 @@ void StatPathIntegrator::Render(const Scene &scene) {
     std::copy_if(featureCfgs.begin(), featureCfgs.end(), std::back_inserter(enabledRGBFeatureCfgs),   [](auto &item) {return item.enable && item.nChannels == 3;});
 
     // Prepare functions pointers for adding samples
-    void (StatTile<T>::*AddLSampleFn)(const Point2i p, const T sample)                    = GetAddSampleFn<T>    (sCfgs[Radiance]);
+    void (StatTile<T, LPixel>::*AddLSampleFn)(const Point2i p, const T sample)            = GetAddSampleFn<T, LPixel>(sCfgs[Radiance]);
     void (StatTile<Float>::*AddMISWinRateSampleFn)(const Point2i p, const Float sample)   = GetAddSampleFn<Float>(sCfgs[MISBSDFWinRate]);
     void (StatTile<Float>::*AddFloatGBufferSampleFn)(const Point2i p, const Float sample) = GetAddSampleFn<Float>(sCfgs[StatMaterialID]);
     void (StatTile<Vec3>::*AddRGBGBufferSampleFn)(const Point2i p, const Vec3 sample)     = GetAddSampleFn<Vec3> (sCfgs[StatNormal]);
     void (StatTile<Vec3>::*AddItLSampleFn)(const Point2i p, const Vec3 sample)            = GetAddSampleFn<Vec3> (sCfgs[ItRadiance]);
 
     auto RenderLoop = [&](const int nIterations) {
-        ParallelFor2D([&](Point2i tile) {
-            // Compute sample bounds for tile
-            const unsigned short x0 = sampleBounds.pMin.x + tile.x * tileSize;
-            const unsigned short x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
-            const unsigned short y0 = sampleBounds.pMin.y + tile.y * tileSize;
-            const unsigned short y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
-            const Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        if (requestedTileSize > 0)
+            SetTileSize(requestedTileSize);
+        else if (tileSize == 0)
+            SetTileSize(AutoTileSize(sampleExtent, MaxThreadIndex()));
+        tileOverheads .assign(nTilesTotal, 0.);
+        tileTotalTimes.assign(nTilesTotal, 0.);
+        if (PbrtOptions.firstTouch) {
+            tileHomes.resize(nTilesTotal);
+            for (unsigned int tileIndex = 0; tileIndex < nTilesTotal; tileIndex++) {
+                const Bounds2i actualTileBounds = camera->film->GetActualTileBounds(GetTileBounds(tileIndex));
+                tileHomes[tileIndex] = FirstTouchThread((actualTileBounds.pMin.y + actualTileBounds.pMax.y) / 2, camera->film->height);
+            }
+        }
 
-            const unsigned int tileIndex = tile.y * nTiles.x + tile.x;
+        ParallelFor([&](const int64_t tileIndex) {
+            TraceScope t("Allocate tile", tileIndex);
+            const std::chrono::steady_clock::time_point tileBegin = std::chrono::steady_clock::now();
+            const Bounds2i tileBounds = GetTileBounds(tileIndex);
 
             filmTiles        [tileIndex] = camera->film->GetFilmTile(tileBounds);
-            tileSamplers     [tileIndex] = sampler->Clone(tileIndex);
-            lTiles           [tileIndex] = estimator.GetTiles<T>    (camera->film->GetActualTileBounds(tileBounds), sCfgs[Radiance].bounceEnd);
+            lTiles           [tileIndex] = estimator.GetTiles<T, LPixel>(camera->film->GetActualTileBounds(tileBounds), sCfgs[Radiance].bounceEnd);
             misTallyTiles    [tileIndex] = estimator.GetTiles<Float>(camera->film->GetActualTileBounds(tileBounds), sCfgs[MISBSDFWinRate].bounceEnd, 2);
             floatFeatureTiles[tileIndex] = estimator.GetTiles<Float>(camera->film->GetActualTileBounds(tileBounds), 1, nFloatBuffers);
             rgbFeatureTiles  [tileIndex] = estimator.GetTiles<Vec3> (camera->film->GetActualTileBounds(tileBounds), 1, nRGBBuffers);
+            if (calculateItStats)
+                itLTiles     [tileIndex] = estimator.GetTiles<Vec3> (camera->film->GetActualTileBounds(tileBounds), sCfgs[ItRadiance].bounceEnd);
 
-        }, nTiles);
-
-        for (unsigned int i = 1; i <= nIterations; i++) {
-            // Iteration tiles are resetted every iteration; don't worry about performance, this is only run if for non-performance critical runs
-            if (calculateItStats) {
-                ParallelFor2D([&](Point2i tile) {
-                    // Compute sample bounds for tile
-                    const unsigned short x0 = sampleBounds.pMin.x + tile.x * tileSize;
-                    const unsigned short x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
-                    const unsigned short y0 = sampleBounds.pMin.y + tile.y * tileSize;
-                    const unsigned short y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
-                    const Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
-
-                    const unsigned int tileIndex = tile.y * nTiles.x + tile.x;
-
-                    itLTiles[tileIndex] = estimator.GetTiles<Vec3> (camera->film->GetActualTileBounds(tileBounds), sCfgs[ItRadiance].bounceEnd);
-                }, nTiles);
-            }
+            const double setupTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - tileBegin).count();
+            tileOverheads [tileIndex] += setupTime;
+            tileTotalTimes[tileIndex] += setupTime;
+        }, nTilesTotal);
 
+        std::pair<int64_t, int64_t> rayCounts;
+        if (metricsFile)
+            rayCounts = RayCounts();
 
+        for (unsigned int i = 1; i <= nIterations; i++) {
             std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
 
             ProgressReporter reporter(nTilesTotal, "Rendering");
@@ -215,41 +382,56 @@ void StatPathIntegrator::Render(const Scene &scene) {
 
                 camera->film->Clear();
 
-                ParallelFor2D([&](Point2i tile) {
-                    // Render section of image corresponding to _tile_
+                std::iota(tileOrder.begin(), tileOrder.end(), 0);
+                std::stable_sort(tileOrder.begin(), tileOrder.end(), [&](const int64_t a, const int64_t b) {
+                    return tileTimes[a] > tileTimes[b];
+                });
 
-                    // Allocate _MemoryArena_ for tile
-                    MemoryArena arena;
+                ParallelForOrdered([&](const int64_t tileIndex) {
+                    // Render section of image corresponding to _tile_
+                    TraceScope t("Render tile", tileIndex);
+                    const std::chrono::steady_clock::time_point tileBegin = std::chrono::steady_clock::now();
+
+                    // Get the resources of this thread and reseed its sampler;
+                    // the seed of the first iteration corresponds to that of
+                    // _Clone(tileIndex)_, and later iterations continue with
+                    // different sequences
+                    ThreadResources &res = threadResources[ThreadIndex];
+                    MemoryArena &arena = res.arena;
+                    const unique_ptr<Sampler> &tileSampler = res.sampler;
+                    tileSampler->Reseed((i - 1) * nTilesTotal + tileIndex);
+                    tileSampler->SetSPP(spp);
 
                     // Compute sample bounds for tile
-                    const unsigned short x0 = sampleBounds.pMin.x + tile.x * tileSize;
-                    const unsigned short x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
-                    const unsigned short y0 = sampleBounds.pMin.y + tile.y * tileSize;
-                    const unsigned short y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
-                    const Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+                    const Bounds2i tileBounds = GetTileBounds(tileIndex);
                     const Bounds2i actualTileBounds = camera->film->GetActualTileBounds(tileBounds);
                     LOG(INFO) << "Starting image tile " << tileBounds;
 
-                    const unsigned int tileIndex = tile.y * nTiles.x + tile.x;
-
-                    const unique_ptr<Sampler>       &tileSampler       = tileSamplers     [tileIndex];
                     const shared_ptr<FilmTile>      &tileFilm          = filmTiles        [tileIndex];
-                    vector<StatTile<T>>             &tileLs            = lTiles           [tileIndex];
+                    vector<StatTile<T, LPixel>>     &tileLs            = lTiles           [tileIndex];
                     vector<StatTile<Vec3>>          &tileItLs          = itLTiles         [tileIndex];
                     vector<vector<StatTile<Float>>> &tileMISTallies    = misTallyTiles    [tileIndex];
                     vector<vector<StatTile<Float>>> &tileFloatFeatures = floatFeatureTiles[tileIndex];
                     vector<vector<StatTile<Vec3>>>  &tileRGBFeatures   = rgbFeatureTiles  [tileIndex];
 
-                    Features features;
-                    features.floats    = std::vector<Float>   (nFloatBuffers);
-                    features.spectrums = std::vector<Spectrum>(nRGBBuffers);
-
-                    std::vector<Float> avgLs(sCfgs[Radiance].bounceEnd);
-                    std::vector<MISWinRate> misWinRates(sCfgs[MISBSDFWinRate].bounceEnd);
-
-                    std::vector<Spectrum> Ls(nLs);
-                    Spectrum &L = Ls[0];
-                    std::vector<MISTally> misTallies(sCfgs[MISBSDFWinRate].bounceEnd);
+                    // Iteration tiles are reset in place every iteration by the
+                    // thread that renders them, while they are cache-resident
+                    if (i > 1)
+                        for (StatTile<Vec3> &tileItL : tileItLs)
+                            tileItL.Reset();
+
+                    Features                &features    = res.features;
+                    std::vector<Float>      &avgLs       = res.avgLs;
+                    std::vector<MISWinRate> &misWinRates = res.misWinRates;
+                    std::vector<Spectrum>   &Ls          = res.Ls;
+                    Spectrum                &L           = Ls[0];
+                    std::vector<MISTally>   &misTallies  = res.misTallies;
+
+                    // Filtered estimates only exist from the second iteration on
+                    if (i == 1) {
+                        std::fill(avgLs.begin(), avgLs.end(), 0.f);
+                        std::fill(misWinRates.begin(), misWinRates.end(), MISWinRate());
+                    }
 
                     // Loop over pixels in tile to render them
                     for (const Point2i pixel : tileBounds) {
@@ -351,8 +533,19 @@ void StatPathIntegrator::Render(const Scene &scene) {
                             }
                             VLOG(1) << "Camera sample: " << cameraSample << " -> ray: " << ray << " -> L = " << L;
 
-                            // Add camera ray's contribution to tiles
-                            tileFilm->AddSample(cameraSample.pFilm, L, rayWeight);
+                            // Add camera ray's contribution to tiles; if possible,
+                            // the film contribution is accumulated in the radiance
+                            // statistics tile, which is updated for the same pixel
+                            // below
+                            Spectrum filmL = L;
+                            Point2i filmPixel;
+                            Float filterWeight;
+                            if (fuseFilm &&
+                                tileFilm->GetSinglePixelSample(cameraSample.pFilm, &filmL, rayWeight, &filmPixel, &filterWeight) &&
+                                filmPixel == pixel)
+                                tileLs[0].AddFilmSample(actualPixel, filmL, filterWeight);
+                            else
+                                tileFilm->AddSample(cameraSample.pFilm, L, rayWeight);
 
                             for (unsigned char j = sCfgs[Radiance].bounceStart; j < sCfgs[Radiance].bounceEnd; j++)
                                 (tileLs[j].*AddLSampleFn)(actualPixel, GetStatSample<T>(Ls[j]));
@@ -377,18 +570,30 @@ void StatPathIntegrator::Render(const Scene &scene) {
                     LOG(INFO) << "Finished image tile " << tileBounds;
 
                     // Merge tiles into buffers
+                    const std::chrono::steady_clock::time_point mergeBegin = std::chrono::steady_clock::now();
+                    if (fuseFilm)
+                        tileLs[0].FlushFilmSamples(*tileFilm, Vector2i(camera->film->croppedPixelBounds.pMin));
                     camera->film->MergeFilmTile(tileFilm);
-                    if (sCfgs[Radiance].enable)
-                        estimator.MergeTransformTiles(tileLs, sCfgs[Radiance]);
-                    if (sCfgs[ItRadiance].enable)
-                        estimator.MergeTiles(tileItLs, sCfgs[ItRadiance]);
-                    if (sCfgs[MISBSDFWinRate].enable && sCfgs[MISLightWinRate].enable)
-                        estimator.MergeTiles(tileMISTallies, {sCfgs[MISBSDFWinRate], sCfgs[MISLightWinRate]});
-                    estimator.MergeTiles(tileFloatFeatures, enabledFloatFeatureCfgs);
-                    estimator.MergeTiles(tileRGBFeatures,   enabledRGBFeatureCfgs);
+                    {
+                        TraceScope t("MergeTile", tileIndex);
+                        if (sCfgs[Radiance].enable)
+                            estimator.MergeTransformTiles(tileLs, sCfgs[Radiance]);
+                        if (sCfgs[ItRadiance].enable)
+                            estimator.MergeTiles(tileItLs, sCfgs[ItRadiance]);
+                        if (sCfgs[MISBSDFWinRate].enable && sCfgs[MISLightWinRate].enable)
+                            estimator.MergeTiles(tileMISTallies, {sCfgs[MISBSDFWinRate], sCfgs[MISLightWinRate]});
+                        estimator.MergeTiles(tileFloatFeatures, enabledFloatFeatureCfgs);
+                        estimator.MergeTiles(tileRGBFeatures,   enabledRGBFeatureCfgs);
+                    }
+
+                    const std::chrono::steady_clock::time_point tileEnd = std::chrono::steady_clock::now();
+                    tileTimes     [tileIndex]  = std::chrono::duration<double>(tileEnd - tileBegin).count();
+                    tileMergeTimes[tileIndex]  = std::chrono::duration<double>(tileEnd - mergeBegin).count();
+                    tileOverheads [tileIndex] += tileMergeTimes[tileIndex];
+                    tileTotalTimes[tileIndex] += tileTimes[tileIndex];
 
                     reporter.Update();
-                }, nTiles);
+                }, tileOrder, PbrtOptions.firstTouch ? &tileHomes : nullptr);
 
                 reporter.Done();
             }
@@ -403,6 +608,7 @@ void StatPathIntegrator::Render(const Scene &scene) {
             std::cout << "SPP: " << (expIterations ? spp << std::max((int)i - 2, 0) : spp) << std::endl;
             std::cout << "Rendering time [ns]: " << renderTime << std::endl;
 
+            int64_t cudaTime = 0;
             if (!estimator.runCUDA)
                 std::cout << "CUDA time [ns]: " << 0 << std::endl;
             else {
@@ -413,7 +619,7 @@ void StatPathIntegrator::Render(const Scene &scene) {
                 estimator.Synchronize();
 
                 end = std::chrono::steady_clock::now();
-                auto cudaTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+                cudaTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
                 std::cout << "CUDA time [ns]: " << cudaTime << std::endl;
             }
 
@@ -426,13 +632,47 @@ void StatPathIntegrator::Render(const Scene &scene) {
                     outBufSel.Display(std::to_string(expIterations ? spp << (i - 1) : i * spp));
             }
             end = std::chrono::steady_clock::now();
-            std::cout << "Output time [ns]: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() << std::endl;
+            auto outputTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+            std::cout << "Output time [ns]: " << outputTime << std::endl;
+
+            if (metricsFile) {
+                const std::pair<int64_t, int64_t> prevRayCounts = rayCounts;
+                rayCounts = RayCounts();
+                const double renderSeconds = renderTime * 1e-9;
+                metricsFile->Write({
+                    {"warmUp",                warmingUp},
+                    {"iteration",             i},
+                    {"spp",                   expIterations ? spp << (i - 1) : i * spp},
+                    {"iterationSPP",          expIterations ? spp << std::max((int)i - 2, 0) : spp},
+                    {"renderTimeNs",          renderTime},
+                    {"cudaTimeNs",            cudaTime},
+                    {"outputTimeNs",          outputTime},
+                    {"mergeTimeNs",           std::accumulate(tileMergeTimes.begin(), tileMergeTimes.end(), 0.) * 1e9},
+                    {"samplesPerSecond",      (rayCounts.first  - prevRayCounts.first)  / renderSeconds},
+                    {"raysPerSecond",         (rayCounts.second - prevRayCounts.second) / renderSeconds},
+                    {"peakRSSBytes",          PeakResidentMemory()},
+                    {"bufferBytes",           BufferBytes(bufferReg)},
+                    {"relativeStandardError", estimator.RelativeStandardError(sCfgs[Radiance])}
+                });
+            }
+        }
+
+        // In auto mode, adapt the tile size for the next call (i.e., after
+        // the warm-up) to the measured overhead. The tile size must not
+        // change within a call, as the tile samplers are seeded per tile.
+        if (requestedTileSize == 0) {
+            const double overhead  = std::accumulate(tileOverheads .begin(), tileOverheads .end(), 0.);
+            const double totalTime = std::accumulate(tileTotalTimes.begin(), tileTotalTimes.end(), 0.);
+            if (totalTime > 0.)
+                SetTileSize(AdaptTileSize(tileSize, overhead / totalTime, sampleExtent, MaxThreadIndex()));
         }
     };
 
     if (PbrtOptions.warmUp) {
         std::cout << "==== Warm-Up Start ====" << std::endl;
+        warmingUp = true;
         RenderLoop(1);
+        warmingUp = false;
         std::cout << "==== Warm-Up End ====" << std::endl;
     }
 
@@ -447,6 +687,7 @@ void StatPathIntegrator::Denoise(const Scene &scene) {
 }
 
 inline void StatPathIntegrator::ReadFile(const std::string &filename, Buffer &buffer) {
+    TraceScope t("Read image");
     cv::imread(filename, cv::IMREAD_UNCHANGED).convertTo(buffer.mat, buffer.mat.type());
     if (buffer.mat.channels() == 3)
         cv::cvtColor(buffer.mat, buffer.mat, cv::COLOR_BGR2RGB);
@@ -466,6 +707,11 @@ void StatPathIntegrator::Denoise(const Scene &scene) {
     const StatTypeConfigs &sCfgs = statTypeConfigs;
     OutputBufferSelection outBufSel(bufferReg, std::regex(outputRegex), camera->film->filename);
 
+    std::unique_ptr<MetricsFile> metricsFile;
+    if (!PbrtOptions.metricsFile.empty())
+        metricsFile.reset(new MetricsFile(PbrtOptions.metricsFile));
+    bool warmingUp = false;
+
     auto DenoiseLoop = [&](const int nIterations) {
         for (unsigned int i = 1; i <= nIterations; i++) {
             std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
@@ -516,6 +762,7 @@ void StatPathIntegrator::Denoise(const Scene &scene) {
             std::cout << "Iteration: " << i << std::endl;
             std::cout << "I/O time [ns]: " << renderTime << std::endl;
 
+            int64_t cudaTime;
             {
                 begin = std::chrono::steady_clock::now();
                 estimator.Upload();
@@ -523,7 +770,7 @@ void StatPathIntegrator::Denoise(const Scene &scene) {
                 estimator.Download();
                 estimator.Synchronize();
                 end = std::chrono::steady_clock::now();
-                auto cudaTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+                cudaTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
                 std::cout << "CUDA time [ns]: " << cudaTime << std::endl;
             }
 
@@ -536,13 +783,29 @@ void StatPathIntegrator::Denoise(const Scene &scene) {
                     outBufSel.Display(std::to_string(currentSPP));
             }
             end = std::chrono::steady_clock::now();
-            std::cout << "Output time [ns]: " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() << std::endl;
+            auto outputTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+            std::cout << "Output time [ns]: " << outputTime << std::endl;
+
+            if (metricsFile)
+                metricsFile->Write({
+                    {"warmUp",                warmingUp},
+                    {"iteration",             i},
+                    {"spp",                   currentSPP},
+                    {"ioTimeNs",              renderTime},
+                    {"cudaTimeNs",            cudaTime},
+                    {"outputTimeNs",          outputTime},
+                    {"peakRSSBytes",          PeakResidentMemory()},
+                    {"bufferBytes",           BufferBytes(bufferReg)},
+                    {"relativeStandardError", estimator.RelativeStandardError(sCfgs[Radiance])}
+                });
         }
     };
 
     if (PbrtOptions.warmUp) {
         std::cout << "==== Warm-Up Start ====" << std::endl;
+        warmingUp = true;
         DenoiseLoop(1);
+        warmingUp = false;
         std::cout << "==== Warm-Up End ====" << std::endl;
     }
 
@@ -729,33 +992,39 @@ Spectrum EstimateDirectSMIS(const Interaction &it, const Point2f &uScattering,
     return Ld;
 }
 
-Spectrum UniformSampleOneLightSMIS(const Interaction &it, const Scene &scene,
-                                   MemoryArena &arena, Sampler &sampler,
-                                   MISWinRate &misWinRate,
-                                   MISTally &misTally,
-                                   bool handleMedia, const Distribution1D *lightDistrib) {
+Spectrum StatPathIntegrator::SampleOneLight(const Interaction &it,
+                                            const Scene &scene,
+                                            MemoryArena &arena,
+                                            Sampler &sampler,
+                                            MISWinRate *misWinRate,
+                                            MISTally *misTally) const {
     ProfilePhase p(Prof::DirectLighting);
-    // Randomly choose a single light to sample, _light_
+    // Choose a single light to sample, _light_, with the light BVH or the
+    // light distribution at _it_
     int nLights = int(scene.lights.size());
     if (nLights == 0) return Spectrum(0.f);
     int lightNum;
     Float lightPdf;
-    if (lightDistrib) {
+    if (lightBVH) {
+        lightNum = lightBVH->Sample(it, sampler.Get1D(), &lightPdf);
+        if (lightNum < 0) return Spectrum(0.f);
+    } else {
+        const Distribution1D *lightDistrib = lightDistribution->Lookup(it.p);
         lightNum = lightDistrib->SampleDiscrete(sampler.Get1D(), &lightPdf);
         if (lightPdf == 0) return Spectrum(0.f);
-    } else {
-        lightNum = std::min((int)(sampler.Get1D() * nLights), nLights - 1);
-        lightPdf = Float(1) / nLights;
     }
     const std::shared_ptr<Light> &light = scene.lights[lightNum];
     Point2f uLight = sampler.Get2D();
     Point2f uScattering = sampler.Get2D();
-    return EstimateDirectSMIS(it, uScattering, *light, uLight,
-                              scene, sampler, arena,
-                              misWinRate,
-                              misTally,
-                              handleMedia,
-                              false) / lightPdf;
+    if (misWinRate && misTally)
+        return EstimateDirectSMIS(it, uScattering, *light, uLight,
+                                  scene, sampler, arena,
+                                  *misWinRate,
+                                  *misTally,
+                                  false,
+                                  false) / lightPdf;
+    return EstimateDirect(it, uScattering, *light, uLight,
+                          scene, sampler, arena, false) / lightPdf;
 }
 
 Spectrum StatPathIntegrator::Li(
@@ -793,7 +1062,6 @@ Spectrum StatPathIntegrator::Li(
 
         // Intersect _ray_ with scene and store intersection in _isect_
         SurfaceInteraction isect;
-        const Distribution1D *distrib;
 
         bool foundIntersection = scene.Intersect(ray, &isect);
 
@@ -834,23 +1102,14 @@ Spectrum StatPathIntegrator::Li(
             if (rgbCfgs[Albedo    ].enable) features.spectrums[rgbCfgs[Albedo    ].index] = isect.primitive->GetMaterial()->GetAlbedo(&isect);
         }
 
-        distrib = lightDistribution->Lookup(isect.p);
-
         // Sample illumination from lights to find path contribution.
         // (But skip this for perfectly specular BSDFs.)
+        const bool smis = enableSMIS && bounces < statTypeConfigs[MISBSDFWinRate].bounceEnd;
         if (isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) {
             ++totalPaths;
-            Spectrum Ld;
-            if (enableSMIS && bounces < statTypeConfigs[MISBSDFWinRate].bounceEnd) {
-                Ld = UniformSampleOneLightSMIS(isect, scene, arena,
-                                               sampler,
-                                               misWinRates[bounces],
-                                               misTallies[bounces],
-                                               false, distrib);
-            }
-            else
-                Ld = UniformSampleOneLight(isect, scene, arena,
-                                           sampler, false, distrib);
+            Spectrum Ld = SampleOneLight(isect, scene, arena, sampler,
+                                         smis ? &misWinRates[bounces] : nullptr,
+                                         smis ? &misTallies[bounces] : nullptr);
             for (unsigned char i = 0; i < nLs; i++) {
                 const Spectrum betaLd = betas[i] * Ld;
                 if (i == 0) {
@@ -900,16 +1159,9 @@ Spectrum StatPathIntegrator::Li(
                 betas[i] *= S / pdf; // HSTODO: test caching
 
             // Account for the direct subsurface scattering component
-            Spectrum Ld;
-            if (enableSMIS && bounces < statTypeConfigs[MISBSDFWinRate].bounceEnd) {
-                Ld = UniformSampleOneLightSMIS(pi, scene, arena, sampler,
-                                               misWinRates[bounces],
-                                               misTallies[bounces],
-                                               false, lightDistribution->Lookup(pi.p));
-            }
-            else
-                Ld = UniformSampleOneLight(pi, scene, arena, sampler,
-                                           false, lightDistribution->Lookup(pi.p));
+            Spectrum Ld = SampleOneLight(pi, scene, arena, sampler,
+                                         smis ? &misWinRates[bounces] : nullptr,
+                                         smis ? &misTallies[bounces] : nullptr);
             for (unsigned char i = 0; i < nLs; i++)
                 Ls[i] += betas[i] * Ld;
 
@@ -980,6 +1232,7 @@ StatPathIntegrator *CreateStatPathIntegrator(
     }
     Float rrThreshold = params.FindOneFloat("rrthreshold", 1.);
     std::string lightStrategy = params.FindOneString("lightsamplestrategy", "spatial");
+    const bool precomputeLightDistribution = params.FindOneBool("precomputelightdistribution", false);
 
     // Continue here with looking for parameters to be able to be overridenn
 
@@ -1000,6 +1253,15 @@ StatPathIntegrator *CreateStatPathIntegrator(
     const float filterSD = params.FindOneFloat("filtersd", 10.f);
     const unsigned char filterRadius = params.FindOneInt("filterradius", 20);
 
+    // Auto mode (0) is opt-in: its tile size depends on the number of
+    // threads (and, with --warmup, on timings), and the tile samplers are
+    // seeded per tile, so its images depend on them as well
+    const int tileSize = params.FindOneInt("tilesize", 16); // 0: auto
+    if (tileSize < 0) {
+        Error("\"tilesize\" must not be negative.");
+        exit(1);
+    }
+
     // The sequence of the configs must correspond to the indices given by BufferIndex in statintegrator.h
     GBufferConfigs floatGBufferCfgs({
         GBufferConfig("materialid"),
@@ -1188,7 +1450,9 @@ StatPathIntegrator *CreateStatPathIntegrator(
         floatGBufferCfgs,
         rgbGBufferCfgs,
         statTypeCfgs,
+        tileSize,
         rrThreshold, lightStrategy,
+        precomputeLightDistribution,
         outputRegex
     );
 }
@@ -11,6 +11,7 @@
 #include "pbrt.h"
 #include "integrator.h"
 #include "lightdistrib.h"
+#include "statistics/lightbvh.h"
 #include "statistics/statpbrt.h"
 #include "statistics/estimator.h"
 
@@ -70,17 +71,19 @@ class StatPathIntegrator : public SamplerIntegrator {
             GBufferConfigs floatGBufferConfigs,
             GBufferConfigs rgbGBufferConfigs,
             StatTypeConfigs statTypeConfigs,
+            const int tileSize = 16, // 0: choose automatically
             const Float rrThreshold = 1.f,
             const std::string &lightSampleStrategy = "spatial",
+            const bool precomputeLightDistribution = false,
             const std::string &outputRegex = "film.*"
         );
         void Preprocess(const Scene &scene, Sampler &sampler);
         void WarmUp();
         // Templated function pointer typedef
-        template <typename T>
-        using AddSampleFn = void (StatTile<T>::*)(const Point2i p, const T sample);
-        template <typename T>
-        inline AddSampleFn<T> GetAddSampleFn(const StatTypeConfig &cfg);
+        template <typename T, typename P = StatTilePixel<T>>
+        using AddSampleFn = void (StatTile<T, P>::*)(const Point2i p, const T sample);
+        template <typename T, typename P = StatTilePixel<T>>
+        inline AddSampleFn<T, P> GetAddSampleFn(const StatTypeConfig &cfg);
         void Render(const Scene &scene);
         template <typename T>
         void Render(const Scene &scene);
@@ -117,11 +120,20 @@ class StatPathIntegrator : public SamplerIntegrator {
         }
         template <typename T>
         inline T GetStatSample(const Spectrum &spectrum) const;
+        // Samples direct lighting at _it_ from a single light that is chosen
+        // according to the light sampling strategy (with SMIS if
+        // _misWinRate_ and _misTally_ are given)
+        Spectrum SampleOneLight(const Interaction &it, const Scene &scene,
+                                MemoryArena &arena, Sampler &sampler,
+                                MISWinRate *misWinRate,
+                                MISTally *misTally) const;
 
         const int maxDepth;
         const Float rrThreshold;
         const std::string lightSampleStrategy;
+        const bool precomputeLightDistribution;
         std::unique_ptr<LightDistribution> lightDistribution;
+        std::unique_ptr<LightBVH> lightBVH; // "bvh" strategy
 
         const uint64_t nIterations;
         const bool expIterations;
@@ -130,6 +142,7 @@ class StatPathIntegrator : public SamplerIntegrator {
         const bool enableACRR;
         const bool enableSMIS;
         const bool calculateItStats;
+        const int requestedTileSize; // 0: auto
 
         unsigned char nFloatBuffers = 0;
         unsigned char nRGBBuffers = 0;
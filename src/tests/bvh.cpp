@@ -0,0 +1,72 @@
+
+#include "tests/gtest/gtest.h"
+#include "pbrt.h"
+#include "rng.h"
+#include "interaction.h"
+#include "primitive.h"
+#include "accelerators/bvh.h"
+#include "shapes/triangle.h"
+
+using namespace pbrt;
+
+TEST(BVH, WideMatchesBinary) {
+    RNG rng;
+
+    // Random triangles, some of them stacked at the same location to get
+    // ties between intersections
+    int nTriangles = 5000;
+    std::vector<int> indices;
+    std::vector<Point3f> p;
+    for (int i = 0; i < nTriangles; ++i) {
+        Point3f c(10 * rng.UniformFloat(), 10 * rng.UniformFloat(),
+                  10 * rng.UniformFloat());
+        if (i % 50 == 0) c = Point3f(5, 5, 5);
+        for (int v = 0; v < 3; ++v) {
+            p.push_back(c + Vector3f(rng.UniformFloat() - .5f,
+                                     rng.UniformFloat() - .5f,
+                                     rng.UniformFloat() - .5f));
+            indices.push_back(3 * i + v);
+        }
+    }
+    Transform identity;
+    std::vector<std::shared_ptr<Shape>> tris = CreateTriangleMesh(
+        &identity, &identity, false, nTriangles, indices.data(), p.size(),
+        p.data(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    std::vector<std::shared_ptr<Primitive>> prims;
+    for (const auto &tri : tris)
+        prims.push_back(std::make_shared<GeometricPrimitive>(
+            tri, nullptr, nullptr, MediumInterface()));
+
+    BVHAccel binary(prims, 4, BVHAccel::SplitMethod::SAH, 2);
+    BVHAccel wide4(prims, 4, BVHAccel::SplitMethod::SAH, 4);
+    BVHAccel wide8(prims, 4, BVHAccel::SplitMethod::SAH, 8);
+    EXPECT_EQ(binary.WorldBound(), wide4.WorldBound());
+    EXPECT_EQ(binary.WorldBound(), wide8.WorldBound());
+
+    // The wide BVHs must find exactly the same intersections
+    for (int i = 0; i < 20000; ++i) {
+        Point3f o(14 * rng.UniformFloat() - 2, 14 * rng.UniformFloat() - 2,
+                  14 * rng.UniformFloat() - 2);
+        Vector3f d(rng.UniformFloat() - .5f, rng.UniformFloat() - .5f,
+                   rng.UniformFloat() - .5f);
+        if (i % 7 == 0) d = Vector3f(0, 0, 1);
+        Float tMax = (i % 3) ? Infinity : 5 * rng.UniformFloat();
+
+        Ray ray(o, d, tMax), ray4(o, d, tMax), ray8(o, d, tMax);
+        SurfaceInteraction isect, isect4, isect8;
+        bool hit = binary.Intersect(ray, &isect);
+        EXPECT_EQ(hit, wide4.Intersect(ray4, &isect4));
+        EXPECT_EQ(hit, wide8.Intersect(ray8, &isect8));
+        EXPECT_EQ(ray.tMax, ray4.tMax);
+        EXPECT_EQ(ray.tMax, ray8.tMax);
+        if (hit) {
+            EXPECT_EQ(isect.shape, isect4.shape);
+            EXPECT_EQ(isect.shape, isect8.shape);
+        }
+
+        Ray rayP(o, d, tMax);
+        bool hitP = binary.IntersectP(rayP);
+        EXPECT_EQ(hitP, wide4.IntersectP(rayP));
+        EXPECT_EQ(hitP, wide8.IntersectP(rayP));
+    }
+}
@@ -0,0 +1,86 @@
+
+#include "tests/gtest/gtest.h"
+#include "pbrt.h"
+#include "rng.h"
+#include "light.h"
+#include "lights/diffuse.h"
+#include "lights/point.h"
+#include "lights/spot.h"
+#include "shapes/triangle.h"
+#include "statistics/lightbvh.h"
+
+using namespace pbrt;
+
+static Float DirectContrib(const Light &light, const SurfaceInteraction &it,
+                           const Point2f &u) {
+    Vector3f wi;
+    Float pdf;
+    VisibilityTester vis;
+    Spectrum Li = light.Sample_Li(it, u, &wi, &pdf, &vis);
+    if (pdf == 0 || Li.IsBlack()) return 0;
+    return Li.y() * AbsDot(wi, it.shading.n) / pdf;
+}
+
+TEST(LightBVH, Unbiased) {
+    RNG rng;
+    Transform identity;
+
+    // Point, spot, and (one- and two-sided) triangle area lights
+    std::vector<std::shared_ptr<Light>> lights;
+    for (int i = 0; i < 60; ++i) {
+        Vector3f c(10 * rng.UniformFloat(), 10 * rng.UniformFloat(),
+                   3 * rng.UniformFloat());
+        if (i % 3 == 0)
+            lights.push_back(std::make_shared<PointLight>(
+                Translate(c), MediumInterface(), Spectrum(1 + i % 5)));
+        else if (i % 3 == 1)
+            lights.push_back(std::make_shared<SpotLight>(
+                Translate(c) * RotateX(360 * rng.UniformFloat()),
+                MediumInterface(), Spectrum(3), 30, 20));
+        else {
+            int indices[3] = {0, 1, 2};
+            Point3f p[3] = {Point3f(c.x, c.y, c.z),
+                            Point3f(c.x + .5f, c.y + .2f, c.z),
+                            Point3f(c.x, c.y + .3f, c.z + .4f)};
+            std::vector<std::shared_ptr<Shape>> tri = CreateTriangleMesh(
+                &identity, &identity, i % 4 == 0, 1, indices, 3, p, nullptr,
+                nullptr, nullptr, nullptr, nullptr, nullptr);
+            lights.push_back(std::make_shared<DiffuseAreaLight>(
+                identity, MediumInterface(), Spectrum(5), 1, tri[0],
+                i % 5 == 0));
+        }
+    }
+    LightBVH lightBVH(lights);
+
+    for (int q = 0; q < 5; ++q) {
+        SurfaceInteraction it;
+        it.p = Point3f(10 * rng.UniformFloat(), 10 * rng.UniformFloat(),
+                       3 * rng.UniformFloat());
+        it.n = it.shading.n = Normal3f(
+            Normalize(Vector3f(rng.UniformFloat() - .5f, rng.UniformFloat() - .5f,
+                               rng.UniformFloat() - .5f)));
+
+        // Sum of the contributions of all lights
+        double expected = 0;
+        for (const auto &light : lights)
+            for (int s = 0; s < 64; ++s)
+                expected += DirectContrib(*light, it,
+                                          Point2f((s % 8 + .5f) / 8,
+                                                  (s / 8 + .5f) / 8)) / 64;
+
+        // Estimate from lights selected with the light BVH
+        const int nSamples = 100000;
+        double estimate = 0;
+        for (int s = 0; s < nSamples; ++s) {
+            Point2f u(rng.UniformFloat(), rng.UniformFloat());
+            Float pmf;
+            int light = lightBVH.Sample(it, rng.UniformFloat(), &pmf);
+            if (light < 0) continue;
+            ASSERT_GT(pmf, 0);
+            estimate += DirectContrib(*lights[light], it, u) / pmf;
+        }
+        estimate /= nSamples;
+        EXPECT_LT(std::abs(estimate - expected), .02 * expected)
+            << "expected " << expected << ", estimate " << estimate;
+    }
+}
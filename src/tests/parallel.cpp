@@ -2,7 +2,9 @@
 #include "tests/gtest/gtest.h"
 #include "pbrt.h"
 #include "parallel.h"
+#include <pbrt/util/parallel.h>
 #include <atomic>
+#include <vector>
 
 using namespace pbrt;
 
@@ -37,3 +39,44 @@ TEST(Parallel, DoNothing) {
 
     ParallelCleanup();
 }
+
+TEST(Parallel, Ordered) {
+    ParallelInit();
+
+    // Every index is run exactly once, including with nested loops
+    std::vector<int64_t> order(1000);
+    for (int i = 0; i < 1000; ++i) order[i] = 999 - i;
+    std::vector<std::atomic<int>> counts(1000);
+    std::atomic<int> nestedCounter{0};
+    ParallelForOrdered([&](int64_t i) {
+        ++counts[i];
+        if (i % 100 == 0)
+            ParallelFor([&](int64_t) { ++nestedCounter; }, 10);
+    }, order);
+    for (int i = 0; i < 1000; ++i) EXPECT_EQ(1, counts[i]);
+    EXPECT_EQ(100, nestedCounter);
+
+    std::atomic<int> counter{0};
+    ParallelForOrdered([&](int64_t) { ++counter; }, std::vector<int64_t>());
+    EXPECT_EQ(0, counter);
+
+    ParallelCleanup();
+}
+
+TEST(Parallel, SharedWithV4) {
+    ParallelInit();
+
+    // pbrt-v4's loops run on pbrt-v3's threads if no v4 pool was created
+    EXPECT_EQ(MaxThreadIndex(), pbrtv4::RunningThreads());
+
+    std::atomic<int> counter{0};
+    pbrtv4::ParallelFor(3, 1000, [&](int64_t i) { counter += (i >= 3 && i < 1000); });
+    EXPECT_EQ(997, counter);
+
+    counter = 0;
+    pbrtv4::ParallelFor2D(pbrtv4::Bounds2i({-5, 2}, {70, 41}),
+                          [&](pbrtv4::Point2i) { ++counter; });
+    EXPECT_EQ(75 * 39, counter);
+
+    ParallelCleanup();
+}
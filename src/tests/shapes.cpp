@@ -328,6 +328,21 @@ static Float mcSolidAngle(const Point3f &p, const Shape &shape, int nSamples) {
     return nHits / (UniformSpherePdf() * nSamples);
 }
 
+TEST(Triangle, OctahedralNormals) {
+    RNG rng;
+    for (int i = 0; i < 100000; ++i) {
+        Vector3f v = UniformSampleSphere(
+            Point2f(rng.UniformFloat(), rng.UniformFloat()));
+        // Include the axes and the folds of the octahedron
+        if (i < 6) v = Vector3f(0, 0, 0), v[i / 2] = (i & 1) ? -1 : 1;
+        if (i % 100 == 1) v.z = 0, v = Normalize(v);
+        Vector3f d = DecodeOctahedral(EncodeOctahedral(v));
+        EXPECT_LT(std::abs(d.Length() - 1), 1e-5);
+        // The chord length approximates the angle (in float precision)
+        EXPECT_LT((d - v).Length(), Radians(.01f)) << v << " -> " << d;
+    }
+}
+
 TEST(Sphere, SolidAngle) {
     Transform tr = Translate(Vector3f(1, .5, -.8)) * RotateX(30);
     Transform trInv = Inverse(tr);
@@ -33,6 +33,7 @@
 
 // textures/imagemap.cpp*
 #include "textures/imagemap.h"
+#include "statistics/scenecache.h"
 #include "imageio.h"
 #include "stats.h"
 
@@ -45,23 +46,69 @@ ImageTexture<Tmemory, Treturn>::ImageTexture(
     bool doTrilinear, Float maxAniso, ImageWrap wrapMode, Float scale,
     bool gamma)
     : mapping(std::move(mapping)) {
-    mipmap =
+    pendingMipmap =
         GetTexture(filename, doTrilinear, maxAniso, wrapMode, scale, gamma);
+    pending.insert(this);
 }
 
 template <typename Tmemory, typename Treturn>
-MIPMap<Tmemory> *ImageTexture<Tmemory, Treturn>::GetTexture(
-    const std::string &filename, bool doTrilinear, Float maxAniso,
-    ImageWrap wrap, Float scale, bool gamma) {
+std::shared_future<std::shared_ptr<MIPMap<Tmemory>>>
+ImageTexture<Tmemory, Treturn>::GetTexture(const std::string &filename,
+                                           bool doTrilinear, Float maxAniso,
+                                           ImageWrap wrap, Float scale,
+                                           bool gamma) {
     // Return _MIPMap_ from texture cache if present
     TexInfo texInfo(filename, doTrilinear, maxAniso, wrap, scale, gamma);
     if (textures.find(texInfo) != textures.end())
-        return textures[texInfo].get();
+        return textures[texInfo];
+
+    // Start loading _MIPMap_ for _filename_
+    std::shared_future<std::shared_ptr<MIPMap<Tmemory>>> mipmap =
+        ParallelAsync([=]() {
+            return LoadTexture(filename, doTrilinear, maxAniso, wrap, scale,
+                               gamma);
+        });
+    textures[texInfo] = mipmap;
+    return mipmap;
+}
 
+template <typename Tmemory, typename Treturn>
+std::shared_ptr<MIPMap<Tmemory>> ImageTexture<Tmemory, Treturn>::LoadTexture(
+    const std::string &filename, bool doTrilinear, Float maxAniso,
+    ImageWrap wrap, Float scale, bool gamma) {
     // Create _MIPMap_ for _filename_
     ProfilePhase _(Prof::TextureLoading);
+
+    // Use pyramid from scene cache if present
+    SceneCacheKey cacheKey("mipmap");
+    const bool cacheKeyValid = SceneCacheEnabled() && cacheKey.AddFile(filename);
+    if (cacheKeyValid) {
+        cacheKey.Add(doTrilinear);
+        cacheKey.Add(maxAniso);
+        cacheKey.Add(wrap);
+        cacheKey.Add(scale);
+        cacheKey.Add(gamma);
+        cacheKey.Add(sizeof(Tmemory));
+        std::unique_ptr<SceneCacheEntry> cached =
+            SceneCacheEntry::Read("mipmap", cacheKey.Get());
+        size_t nLevels = 0, nTexels = 0;
+        const Point2i *levelRes =
+            cached ? cached->Section<Point2i>(0, &nLevels) : nullptr;
+        const Tmemory *levelData =
+            levelRes ? cached->Section<Tmemory>(1, &nTexels) : nullptr;
+        size_t nLevelTexels = 0;
+        for (size_t i = 0; levelData && i < nLevels; ++i)
+            nLevelTexels += (size_t)levelRes[i].x * levelRes[i].y;
+        if (levelData && nLevels > 0 && nLevelTexels == nTexels) {
+            return std::make_shared<MIPMap<Tmemory>>(
+                std::vector<Point2i>(levelRes, levelRes + nLevels), levelData,
+                doTrilinear, maxAniso, wrap);
+        }
+    }
+
     Point2i resolution;
     std::unique_ptr<RGBSpectrum[]> texels = ReadImage(filename, &resolution);
+    const bool imageRead = (bool)texels;
     if (!texels) {
         Warning("Creating a constant grey texture to replace \"%s\".",
                 filename.c_str());
@@ -80,27 +127,38 @@ MIPMap<Tmemory> *ImageTexture<Tmemory, Treturn>::GetTexture(
             std::swap(texels[o1], texels[o2]);
         }
 
-    MIPMap<Tmemory> *mipmap = nullptr;
+    std::shared_ptr<MIPMap<Tmemory>> mipmap;
     if (texels) {
         // Convert texels to type _Tmemory_ and create _MIPMap_
         std::unique_ptr<Tmemory[]> convertedTexels(
             new Tmemory[resolution.x * resolution.y]);
         for (int i = 0; i < resolution.x * resolution.y; ++i)
             convertIn(texels[i], &convertedTexels[i], scale, gamma);
-        mipmap = new MIPMap<Tmemory>(resolution, convertedTexels.get(),
-                                     doTrilinear, maxAniso, wrap);
+        mipmap.reset(new MIPMap<Tmemory>(resolution, convertedTexels.get(),
+                                         doTrilinear, maxAniso, wrap));
     } else {
         // Create one-valued _MIPMap_
         Tmemory oneVal = scale;
-        mipmap = new MIPMap<Tmemory>(Point2i(1, 1), &oneVal);
+        mipmap.reset(new MIPMap<Tmemory>(Point2i(1, 1), &oneVal));
+    }
+
+    // Store pyramid in scene cache
+    if (cacheKeyValid && imageRead) {
+        std::vector<Tmemory> levelData;
+        std::vector<Point2i> levelRes = mipmap->GetLevels(&levelData);
+        SceneCacheWriter writer;
+        writer.AddSection(&levelRes[0], levelRes.size());
+        writer.AddSection(&levelData[0], levelData.size());
+        writer.Write("mipmap", cacheKey.Get());
     }
-    textures[texInfo].reset(mipmap);
     return mipmap;
 }
 
 template <typename Tmemory, typename Treturn>
-std::map<TexInfo, std::unique_ptr<MIPMap<Tmemory>>>
+std::map<TexInfo, std::shared_future<std::shared_ptr<MIPMap<Tmemory>>>>
     ImageTexture<Tmemory, Treturn>::textures;
+template <typename Tmemory, typename Treturn>
+std::set<ImageTexture<Tmemory, Treturn> *> ImageTexture<Tmemory, Treturn>::pending;
 ImageTexture<Float, Float> *CreateImageFloatTexture(const Transform &tex2world,
                                                     const TextureParams &tp) {
     // Initialize 2D texture mapping _map_ from _tp_
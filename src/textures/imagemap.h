@@ -53,7 +53,10 @@
 #include "texture.h"
 #include "mipmap.h"
 #include "paramset.h"
+#include "parallel.h"
+#include <future>
 #include <map>
+#include <set>
 
 namespace pbrt {
 
@@ -91,9 +94,21 @@ class ImageTexture : public Texture<Treturn> {
     ImageTexture(std::unique_ptr<TextureMapping2D> m,
                  const std::string &filename, bool doTri, Float maxAniso,
                  ImageWrap wm, Float scale, bool gamma);
+    ~ImageTexture() { pending.erase(this); }
+    // MIP maps that are still used by textures (e.g., of scenes kept resident
+    // by the render server) stay alive after clearing the cache
     static void ClearCache() {
         textures.erase(textures.begin(), textures.end());
     }
+    // MIP maps are loaded asynchronously; this waits for the loads and has
+    // to be called before the textures created so far are evaluated
+    static void ResolvePending() {
+        for (ImageTexture *texture : pending) {
+            texture->mipmap = ParallelWait(texture->pendingMipmap);
+            texture->pendingMipmap = std::shared_future<std::shared_ptr<MIPMap<Tmemory>>>();
+        }
+        pending.clear();
+    }
     Treturn Evaluate(const SurfaceInteraction &si) const {
         Vector2f dstdx, dstdy;
         Point2f st = mapping->Map(si, &dstdx, &dstdy);
@@ -109,9 +124,12 @@ class ImageTexture : public Texture<Treturn> {
 
   private:
     // ImageTexture Private Methods
-    static MIPMap<Tmemory> *GetTexture(const std::string &filename,
-                                       bool doTrilinear, Float maxAniso,
-                                       ImageWrap wm, Float scale, bool gamma);
+    static std::shared_future<std::shared_ptr<MIPMap<Tmemory>>> GetTexture(
+        const std::string &filename, bool doTrilinear, Float maxAniso,
+        ImageWrap wm, Float scale, bool gamma);
+    static std::shared_ptr<MIPMap<Tmemory>> LoadTexture(
+        const std::string &filename, bool doTrilinear, Float maxAniso,
+        ImageWrap wm, Float scale, bool gamma);
     static void convertIn(const RGBSpectrum &from, RGBSpectrum *to, Float scale,
                           bool gamma) {
         for (int i = 0; i < RGBSpectrum::nSamples; ++i)
@@ -130,8 +148,11 @@ class ImageTexture : public Texture<Treturn> {
 
     // ImageTexture Private Data
     std::unique_ptr<TextureMapping2D> mapping;
-    MIPMap<Tmemory> *mipmap;
-    static std::map<TexInfo, std::unique_ptr<MIPMap<Tmemory>>> textures;
+    std::shared_ptr<MIPMap<Tmemory>> mipmap;
+    std::shared_future<std::shared_ptr<MIPMap<Tmemory>>> pendingMipmap;
+    static std::map<TexInfo, std::shared_future<std::shared_ptr<MIPMap<Tmemory>>>>
+        textures;
+    static std::set<ImageTexture *> pending;
 };
 
 extern template class ImageTexture<Float, Float>;